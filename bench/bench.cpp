@@ -0,0 +1,310 @@
+// MacMemory benchmark driver
+// Starts the synthetic target, runs a first scan and a rescan for every value
+// type and comparison against it, and prints the throughput of each as JSON.
+
+#include "../scanner.h"
+
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+// Marker values of bench/target.cpp
+const char* const BENCH_STRING = "MacMemoryBench";
+
+struct BenchType {
+    ValueType type;
+    const char* name;
+    std::string marker;
+};
+
+struct BenchOptions {
+    std::string targetPath;
+    std::string heapSizes;
+    std::string distribution;
+    size_t intervalMs;
+    size_t threads;
+    uint32_t include;
+    
+    BenchOptions() : targetPath("bench/bench-target"), heapSizes("64,8,1"), distribution("sparse"),
+                     intervalMs(100), threads(0), include(TAG_MALLOC) {}
+};
+
+// One measured scan
+struct BenchResult {
+    std::string type;
+    std::string comparison;
+    std::string phase;
+    double seconds;
+    uint64_t bytes;
+    size_t hits;
+    uint64_t readCalls;
+    uint64_t readBytes;
+    uint64_t remapCalls;
+    uint64_t peakRss;
+};
+
+// Peak resident set size of this process in bytes
+uint64_t peakRss() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return static_cast<uint64_t>(usage.ru_maxrss);
+#else
+    return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+}
+
+void printResult(std::ostream& out, const BenchResult& result) {
+    double gigabytes = static_cast<double>(result.bytes) / (1024.0 * 1024 * 1024);
+    out << "    {\"type\": " << jsonQuote(result.type)
+        << ", \"comparison\": " << jsonQuote(result.comparison)
+        << ", \"phase\": " << jsonQuote(result.phase)
+        << std::fixed << std::setprecision(6) << ", \"seconds\": " << result.seconds
+        << ", \"bytes\": " << result.bytes
+        << std::setprecision(3) << ", \"gb_per_second\": " << (result.seconds > 0 ? gigabytes / result.seconds : 0.0)
+        << ", \"hits\": " << result.hits
+        << std::setprecision(0) << ", \"hits_per_second\": " << (result.seconds > 0 ? result.hits / result.seconds : 0.0)
+        << ", \"read_calls\": " << result.readCalls
+        << ", \"read_bytes\": " << result.readBytes
+        << ", \"remap_calls\": " << result.remapCalls
+        << ", \"peak_rss_bytes\": " << result.peakRss << "}";
+}
+
+// Start the target with its stdin and stdout on pipes. It exits once stdin closes.
+bool startTarget(const BenchOptions& options, pid_t& pid, int& control, std::string& ready) {
+    int input[2];
+    int output[2];
+    if (pipe(input) != 0 || pipe(output) != 0) {
+        return false;
+    }
+    
+    std::string interval = std::to_string(options.intervalMs);
+    pid = fork();
+    if (pid < 0) {
+        return false;
+    }
+    if (pid == 0) {
+        dup2(input[0], STDIN_FILENO);
+        dup2(output[1], STDOUT_FILENO);
+        close(input[0]);
+        close(input[1]);
+        close(output[0]);
+        close(output[1]);
+        execl(options.targetPath.c_str(), options.targetPath.c_str(),
+              "--heap", options.heapSizes.c_str(), "--distribution", options.distribution.c_str(),
+              "--interval", interval.c_str(), static_cast<char*>(nullptr));
+        _exit(127);
+    }
+    
+    close(input[0]);
+    close(output[1]);
+    control = input[1];
+    
+    // Wait for "ready <bytes> <records>"
+    char c;
+    while (read(output[0], &c, 1) == 1 && c != '\n') {
+        ready += c;
+    }
+    close(output[0]);
+    return ready.compare(0, 6, "ready ") == 0;
+}
+
+// Swallows the scanner's terminal output
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return c; }
+};
+
+class Bench {
+private:
+    MemoryScanner& scanner;
+    const BenchOptions& options;
+    RegionFilter filter;
+    std::vector<BenchResult> results;
+    
+    // Time one scan and record what it cost
+    void measure(const BenchType& type, const char* comparison, const char* phase, const std::function<void()>& scan) {
+        auto start = std::chrono::steady_clock::now();
+        scanner.startJob(phase, false, scan);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        
+        BenchResult result;
+        result.type = type.name;
+        result.comparison = comparison;
+        result.phase = phase;
+        result.seconds = seconds;
+        result.bytes = scanner.getScanBytes();
+        result.hits = scanner.getResultCount();
+        result.readCalls = scanStats.total(STAT_READ_CALLS);
+        result.readBytes = scanStats.total(STAT_READ_BYTES);
+        result.remapCalls = scanStats.total(STAT_REMAP_CALLS);
+        result.peakRss = peakRss();
+        results.push_back(result);
+    }
+    
+    // Give the target time to change the counting half of its markers
+    void waitForTick() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(options.intervalMs * 2));
+    }
+
+public:
+    Bench(MemoryScanner& memoryScanner, const BenchOptions& benchOptions)
+        : scanner(memoryScanner), options(benchOptions) {
+        filter.include = options.include;
+    }
+    
+    // A first scan with the given operand, then a rescan with the same one
+    void runValue(const BenchType& type, Comparison comparison, const char* name, const std::string& operand) {
+        measure(type, name, "first", [&]() { scanner.firstScan(type.type, operand, comparison, filter); });
+        waitForTick();
+        measure(type, name, "next", [&]() { scanner.nextScan(type.type, operand, comparison); });
+    }
+    
+    // An unknown initial value scan, then a rescan against the snapshot
+    void runPrevious(const BenchType& type, Comparison comparison, const char* name) {
+        measure(type, name, "first", [&]() { scanner.firstScanUnknown(type.type, filter); });
+        waitForTick();
+        measure(type, name, "next", [&]() { scanner.nextScan(type.type, "", comparison); });
+    }
+    
+    void run() {
+        const BenchType numericTypes[] = {
+            { ValueType::BYTE, "byte", "165" },
+            { ValueType::INT16, "short", "31337" },
+            { ValueType::INT32, "int", "123456789" },
+            { ValueType::INT64, "long", "1234567890123" },
+            { ValueType::FLOAT, "float", "1234.5" },
+            { ValueType::DOUBLE, "double", "98765.4321" },
+            { ValueType::ANY, "any", "123456789" }
+        };
+        const std::pair<Comparison, const char*> previousComparisons[] = {
+            { COMPARE_CHANGED, "changed" },
+            { COMPARE_UNCHANGED, "unchanged" },
+            { COMPARE_INCREASED, "increased" },
+            { COMPARE_DECREASED, "decreased" }
+        };
+        
+        for (const BenchType& type : numericTypes) {
+            // Operands around the marker: in zeroed memory only the markers match,
+            // while random memory also hits about half its slots on greater and less
+            bool floating = type.type == ValueType::FLOAT || type.type == ValueType::DOUBLE;
+            std::string lower = floating ? std::to_string(std::stod(type.marker) - 1) : std::to_string(std::stoll(type.marker) - 1);
+            std::string upper = floating ? std::to_string(std::stod(type.marker) + 1) : std::to_string(std::stoll(type.marker) + 1);
+            runValue(type, COMPARE_EXACT, "exact", type.marker);
+            runValue(type, COMPARE_GREATER, "greater", lower);
+            runValue(type, COMPARE_LESS, "less", "0");
+            runValue(type, COMPARE_BETWEEN, "between", lower + " " + upper);
+            runValue(type, COMPARE_APPROX, "approx", type.marker + " 0.5");
+            
+            if (type.type == ValueType::ANY) {
+                continue;
+            }
+            for (const auto& comparison : previousComparisons) {
+                runPrevious(type, comparison.first, comparison.second);
+            }
+        }
+        
+        const BenchType stringTypes[] = {
+            { ValueType::STRING, "string", BENCH_STRING },
+            { ValueType::STRING16, "string16", BENCH_STRING }
+        };
+        for (const BenchType& type : stringTypes) {
+            runValue(type, COMPARE_EXACT, "exact", type.marker);
+            runValue(type, COMPARE_NOCASE, "nocase", "macmemorybench");
+        }
+    }
+    
+    void print(std::ostream& out, const std::string& ready) const {
+        std::istringstream fields(ready.substr(6));
+        uint64_t targetBytes = 0;
+        uint64_t records = 0;
+        fields >> targetBytes >> records;
+        
+        out << "{" << std::endl;
+        out << "  \"target\": {\"heaps_mb\": [" << options.heapSizes << "], \"distribution\": " << jsonQuote(options.distribution)
+            << ", \"interval_ms\": " << options.intervalMs << ", \"bytes\": " << targetBytes << ", \"records\": " << records << "}," << std::endl;
+        out << "  \"settings\": {\"threads\": " << scanner.getThreadCount() << ", \"simd\": " << (scanner.getSimd() ? "true" : "false")
+            << ", \"zero_copy\": " << (scanner.getZeroCopy() ? "true" : "false")
+            << ", \"pipeline\": " << (scanner.getPipelined() ? "true" : "false")
+            << ", \"include\": " << jsonQuote(formatRegionTags(options.include)) << "}," << std::endl;
+        out << "  \"results\": [" << std::endl;
+        for (size_t i = 0; i < results.size(); i++) {
+            printResult(out, results[i]);
+            out << (i + 1 < results.size() ? "," : "") << std::endl;
+        }
+        out << "  ]," << std::endl;
+        out << "  \"peak_rss_bytes\": " << peakRss() << std::endl;
+        out << "}" << std::endl;
+    }
+};
+
+int main(int argc, char* argv[]) {
+    initValueTypeNames();
+    
+    BenchOptions options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--target" && i + 1 < argc) {
+            options.targetPath = argv[++i];
+        } else if (arg == "--heap" && i + 1 < argc) {
+            options.heapSizes = argv[++i];
+        } else if (arg == "--distribution" && i + 1 < argc) {
+            options.distribution = argv[++i];
+        } else if (arg == "--interval" && i + 1 < argc) {
+            options.intervalMs = std::max<size_t>(1, strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--threads" && i + 1 < argc) {
+            options.threads = strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--include" && i + 1 < argc) {
+            std::string tags = argv[++i];
+            if (tags == "all") {
+                options.include = 0;
+            } else if (!parseRegionTags(tags, options.include)) {
+                std::cerr << "Tags: " << formatRegionTags(~0u) << ", or all" << std::endl;
+                return 1;
+            }
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--target path] [--heap MB,...] [--distribution sparse|dense|random]"
+                      << " [--interval ms] [--threads N] [--include tags|all]" << std::endl;
+            return 1;
+        }
+    }
+    
+    pid_t pid = 0;
+    int control = -1;
+    std::string ready;
+    if (!startTarget(options, pid, control, ready)) {
+        std::cerr << "Failed to start " << options.targetPath << std::endl;
+        if (pid > 0) {
+            kill(pid, SIGTERM);
+            waitpid(pid, nullptr, 0);
+        }
+        return 1;
+    }
+    
+    // The scanner talks to std::cout; keep stdout for the JSON report
+    std::ostream report(std::cout.rdbuf());
+    NullBuffer discard;
+    std::cout.rdbuf(&discard);
+    
+    int status = 0;
+    {
+        MemoryScanner scanner;
+        if (options.threads > 0) {
+            scanner.setThreadCount(options.threads);
+        }
+        if (!scanner.attachProcess(pid)) {
+            status = 1;
+        } else {
+            Bench bench(scanner, options);
+            bench.run();
+            bench.print(report, ready);
+        }
+    }
+    std::cout.rdbuf(report.rdbuf());
+    
+    close(control);
+    waitpid(pid, nullptr, 0);
+    return status;
+}
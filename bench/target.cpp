@@ -0,0 +1,175 @@
+// MacMemory benchmark target - a synthetic process for the scan benchmark
+// Allocates heaps filled with a known value distribution and changes part of
+// them on a fixed schedule, so scans and rescans have predictable work to do.
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <unistd.h>
+
+// Marker values the benchmark driver scans for
+const uint8_t MARK_BYTE = 165;
+const int16_t MARK_SHORT = 31337;
+const int32_t MARK_INT = 123456789;
+const int64_t MARK_LONG = 1234567890123LL;
+const float MARK_FLOAT = 1234.5f;
+const double MARK_DOUBLE = 98765.4321;
+const char MARK_STRING[] = "MacMemoryBench";
+
+// One record of markers, every field at its natural alignment
+struct MarkerRecord {
+    int64_t longValue;
+    double doubleValue;
+    int32_t intValue;
+    float floatValue;
+    int16_t shortValue;
+    uint8_t byteValue;
+    uint8_t padding;
+    char text[16];
+    char16_t text16[16];
+};
+
+struct Options {
+    std::vector<size_t> heapSizes;
+    std::string distribution;
+    size_t intervalMs;
+    
+    Options() : distribution("sparse"), intervalMs(100) {}
+};
+
+bool parseHeapSizes(const std::string& text, std::vector<size_t>& sizes) {
+    std::stringstream list(text);
+    std::string item;
+    sizes.clear();
+    while (std::getline(list, item, ',')) {
+        char* end = nullptr;
+        unsigned long megabytes = strtoul(item.c_str(), &end, 10);
+        if (item.empty() || *end != '\0' || megabytes == 0) {
+            return false;
+        }
+        sizes.push_back(static_cast<size_t>(megabytes) * 1024 * 1024);
+    }
+    return !sizes.empty();
+}
+
+void fillRecord(MarkerRecord& record) {
+    memset(&record, 0, sizeof(record));
+    record.longValue = MARK_LONG;
+    record.doubleValue = MARK_DOUBLE;
+    record.intValue = MARK_INT;
+    record.floatValue = MARK_FLOAT;
+    record.shortValue = MARK_SHORT;
+    record.byteValue = MARK_BYTE;
+    memcpy(record.text, MARK_STRING, sizeof(MARK_STRING));
+    for (size_t i = 0; i + 1 < sizeof(MARK_STRING); i++) {
+        record.text16[i] = static_cast<char16_t>(MARK_STRING[i]);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    options.heapSizes = { 64 * 1024 * 1024, 8 * 1024 * 1024, 1024 * 1024 };
+    
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--heap" && i + 1 < argc && parseHeapSizes(argv[i + 1], options.heapSizes)) {
+            i++;
+        } else if (arg == "--distribution" && i + 1 < argc) {
+            options.distribution = argv[++i];
+        } else if (arg == "--interval" && i + 1 < argc) {
+            options.intervalMs = strtoul(argv[++i], nullptr, 10);
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--heap MB,...] [--distribution sparse|dense|random] [--interval ms]" << std::endl;
+            return 1;
+        }
+    }
+    
+    // sparse: zeroed memory with a marker record every 64 KB
+    // dense: zeroed memory with a marker record every 1 KB
+    // random: pseudo-random memory with a marker record every 64 KB
+    size_t spacing = 0;
+    bool random = false;
+    if (options.distribution == "sparse") {
+        spacing = 64 * 1024;
+    } else if (options.distribution == "dense") {
+        spacing = 1024;
+    } else if (options.distribution == "random") {
+        spacing = 64 * 1024;
+        random = true;
+    } else {
+        std::cerr << "Unknown distribution '" << options.distribution << "'" << std::endl;
+        return 1;
+    }
+    
+    std::vector<uint8_t*> heaps;
+    std::vector<MarkerRecord*> records;
+    size_t totalBytes = 0;
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+    for (size_t size : options.heapSizes) {
+        uint8_t* heap = static_cast<uint8_t*>(malloc(size));
+        if (!heap) {
+            std::cerr << "Failed to allocate " << size << " bytes" << std::endl;
+            return 1;
+        }
+        
+        if (random) {
+            for (size_t offset = 0; offset + sizeof(uint64_t) <= size; offset += sizeof(uint64_t)) {
+                // xorshift64
+                state ^= state << 13;
+                state ^= state >> 7;
+                state ^= state << 17;
+                memcpy(heap + offset, &state, sizeof(state));
+            }
+        } else {
+            memset(heap, 0, size);
+        }
+        
+        for (size_t offset = 0; offset + sizeof(MarkerRecord) <= size; offset += spacing) {
+            MarkerRecord* record = reinterpret_cast<MarkerRecord*>(heap + offset);
+            fillRecord(*record);
+            records.push_back(record);
+        }
+        heaps.push_back(heap);
+        totalBytes += size;
+    }
+    
+    // The driver waits for this line before it attaches
+    std::cout << "ready " << totalBytes << " " << records.size() << std::endl;
+    
+    // Run until stdin closes, so the target goes away with the driver
+    std::atomic<bool> stop(false);
+    std::thread watcher([&stop]() {
+        char buffer[64];
+        while (read(STDIN_FILENO, buffer, sizeof(buffer)) > 0) {
+        }
+        stop = true;
+    });
+    
+    // Every tick, every other record counts up; the rest never change
+    while (!stop) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(options.intervalMs));
+        for (size_t i = 0; i < records.size(); i += 2) {
+            // Nothing here reads the heaps back, so keep the stores from being optimized out
+            volatile MarkerRecord* record = records[i];
+            record->longValue = record->longValue + 1;
+            record->doubleValue = record->doubleValue + 1.0;
+            record->intValue = record->intValue + 1;
+            record->floatValue = record->floatValue + 1.0f;
+            record->shortValue = static_cast<int16_t>(record->shortValue + 1);
+            record->byteValue = static_cast<uint8_t>(record->byteValue + 1);
+        }
+    }
+    
+    watcher.join();
+    for (uint8_t* heap : heaps) {
+        free(heap);
+    }
+    return 0;
+}
@@ -0,0 +1,246 @@
+// libmacmemory - the MacMemory scan engine as a library
+// Scanner forwards to a MemoryScanner whose messages go to a buffer instead of
+// the terminal, and hands out its result columns without copying them.
+
+#include "scanner.h"
+#include "libmacmemory.h"
+
+namespace macmemory {
+
+// The public enums follow the order of the engine's, so they convert with a cast
+static_assert(static_cast<int>(Type::Any) == ValueType::ANY, "Type must match ValueType");
+static_assert(static_cast<int>(Type::String16) == ValueType::STRING16, "Type must match ValueType");
+static_assert(static_cast<int>(Compare::Approx) == COMPARE_APPROX, "Compare must match Comparison");
+static_assert(static_cast<int>(Compare::NoCase) == COMPARE_NOCASE, "Compare must match Comparison");
+static_assert(sizeof(mach_vm_address_t) == sizeof(uint64_t), "Addresses are handed out as uint64_t");
+
+static ValueType engineType(Type type) { return static_cast<ValueType>(type); }
+static Comparison engineComparison(Compare compare) { return static_cast<Comparison>(compare); }
+
+struct Scanner::Impl {
+    MemoryScanner scanner;
+    std::ostringstream log;
+    
+    Impl() {
+        initValueTypeNames();
+        scanner.setOutput(log, log);
+        scanner.setProgress(false);
+    }
+    
+    // Every call starts with an empty message buffer
+    void begin() {
+        log.str("");
+        log.clear();
+    }
+    
+    bool parseFilter(const ScanOptions& options, RegionFilter& filter) {
+        if (!options.include.empty() && !parseRegionTags(options.include, filter.include)) {
+            log << "Unknown region tags '" << options.include << "'" << std::endl;
+            return false;
+        }
+        if (!options.exclude.empty() && !parseRegionTags(options.exclude, filter.exclude)) {
+            log << "Unknown region tags '" << options.exclude << "'" << std::endl;
+            return false;
+        }
+        return true;
+    }
+    
+    // Run a scan in the calling thread; bad operands throw from the value parsers
+    size_t run(const std::string& description, const std::function<void()>& fn) {
+        try {
+            scanner.startJob(description, false, fn);
+        } catch (const std::exception& e) {
+            log << "Scan failed: " << e.what() << std::endl;
+            return 0;
+        }
+        return scanner.getResultCount();
+    }
+};
+
+Scanner::Scanner() : impl(new Impl()) {}
+
+Scanner::~Scanner() = default;
+
+std::vector<Process> Scanner::processes() {
+    std::vector<Process> processes;
+    for (const ProcessInfo& info : MemoryScanner::listProcesses()) {
+        processes.push_back({ info.pid, info.name });
+    }
+    return processes;
+}
+
+bool Scanner::attach(pid_t pid) {
+    impl->begin();
+    if (impl->scanner.isProcessAttached()) {
+        impl->scanner.detachProcess();
+    }
+    return impl->scanner.attachProcess(pid);
+}
+
+void Scanner::detach() {
+    impl->begin();
+    impl->scanner.detachProcess();
+}
+
+bool Scanner::attached() const {
+    return impl->scanner.isProcessAttached();
+}
+
+size_t Scanner::scan(Type type, const std::string& value, Compare compare, const ScanOptions& options) {
+    impl->begin();
+    RegionFilter filter;
+    if (!impl->parseFilter(options, filter)) {
+        return 0;
+    }
+    MemoryScanner& scanner = impl->scanner;
+    return impl->run("scan", [&]() { scanner.firstScan(engineType(type), value, engineComparison(compare), filter); });
+}
+
+size_t Scanner::scanUnknown(Type type, const ScanOptions& options) {
+    impl->begin();
+    RegionFilter filter;
+    if (!impl->parseFilter(options, filter)) {
+        return 0;
+    }
+    MemoryScanner& scanner = impl->scanner;
+    return impl->run("scan unknown", [&]() { scanner.firstScanUnknown(engineType(type), filter); });
+}
+
+size_t Scanner::scanGroup(const std::vector<GroupValue>& values, const ScanOptions& options) {
+    impl->begin();
+    RegionFilter filter;
+    if (!impl->parseFilter(options, filter)) {
+        return 0;
+    }
+    std::vector<GroupMember> members;
+    for (const GroupValue& value : values) {
+        members.push_back({ engineType(value.type), engineComparison(value.compare), value.value, members.empty() ? 0 : value.within });
+    }
+    MemoryScanner& scanner = impl->scanner;
+    return impl->run("scan group", [&]() { scanner.firstScanGroup(members, filter); });
+}
+
+size_t Scanner::next(Type type, const std::string& value, Compare compare) {
+    impl->begin();
+    MemoryScanner& scanner = impl->scanner;
+    return impl->run("next", [&]() { scanner.nextScan(engineType(type), value, engineComparison(compare)); });
+}
+
+// Any keeps the type of the results
+size_t Scanner::next(Compare compare) {
+    return next(Type::Any, "", compare);
+}
+
+bool Scanner::undo() {
+    impl->begin();
+    return impl->scanner.undoScan();
+}
+
+void Scanner::clear() {
+    impl->begin();
+    impl->scanner.clearResults();
+}
+
+void Scanner::cancel() {
+    impl->scanner.requestCancel();
+}
+
+ResultView Scanner::results() const {
+    const ResultStore& store = impl->scanner.getResults();
+    if (impl->scanner.hasCandidateBitmap() || store.empty()) {
+        return ResultView();
+    }
+    return ResultView(reinterpret_cast<const uint64_t*>(store.addresses.data()), store.values.data(),
+                      store.types.empty() ? nullptr : store.types.data(), store.size(), store.valueSize,
+                      static_cast<Type>(store.type));
+}
+
+size_t Scanner::candidateCount() const {
+    return impl->scanner.getResultCount();
+}
+
+void Scanner::forEachCandidate(const std::function<bool(uint64_t address, const uint8_t* value)>& visit) const {
+    if (!impl->scanner.hasCandidateBitmap()) {
+        ResultView view = results();
+        for (size_t i = 0; i < view.size(); i++) {
+            if (!visit(view.address(i), view.value(i))) {
+                return;
+            }
+        }
+        return;
+    }
+    impl->scanner.forEachCandidate([&](mach_vm_address_t address, const uint8_t* value) {
+        return visit(address, value);
+    });
+}
+
+uint32_t Scanner::watch(uint64_t address, Type type, double intervalMs) {
+    impl->begin();
+    return impl->scanner.addWatch(address, engineType(type), intervalMs);
+}
+
+bool Scanner::unwatch(uint32_t id) {
+    impl->begin();
+    return impl->scanner.removeWatch(id);
+}
+
+size_t Scanner::pollWatchChanges(const std::function<void(const WatchChange&)>& change) {
+    WatchEvent event;
+    size_t count = 0;
+    while (impl->scanner.pollWatchEvent(event)) {
+        WatchChange watchChange = { event.id, event.address, static_cast<Type>(event.type), event.size,
+                                    event.oldValue, event.newValue, event.readable };
+        change(watchChange);
+        count++;
+    }
+    return count;
+}
+
+bool Scanner::read(uint64_t address, void* buffer, size_t size) {
+    return impl->scanner.isProcessAttached() && impl->scanner.readMemoryBlock(address, buffer, size);
+}
+
+bool Scanner::write(uint64_t address, const void* data, size_t size) {
+    return impl->scanner.isProcessAttached() && impl->scanner.writeMemoryBlock(address, data, size);
+}
+
+void Scanner::setThreads(size_t threads) {
+    impl->scanner.setThreadCount(threads);
+}
+
+void Scanner::setAlignment(size_t bytes) {
+    impl->scanner.setAlignment(bytes);
+}
+
+void Scanner::setProgressCallback(const ProgressCallback& callback) {
+    if (!callback) {
+        impl->scanner.setProgressCallback(nullptr);
+        return;
+    }
+    impl->scanner.setProgressCallback([callback](uint64_t bytesDone, uint64_t bytesTotal, uint64_t hits) {
+        callback(Progress{ bytesDone, bytesTotal, hits });
+    });
+}
+
+// Completion lines start with a carriage return over the progress line, and the
+// engine colors its messages for the terminal; drop both here rather than turn
+// colors off for the whole host process.
+std::string Scanner::messages() const {
+    const std::string log = impl->log.str();
+    std::string text;
+    text.reserve(log.size());
+    for (size_t i = 0; i < log.size(); i++) {
+        if (log[i] == '\033' && i + 1 < log.size() && log[i + 1] == '[') {
+            // Skip a control sequence up to its final byte ("\033[31m", "\033[K")
+            i += 2;
+            while (i < log.size() && (log[i] < 0x40 || log[i] > 0x7e)) {
+                i++;
+            }
+        } else if (log[i] != '\r') {
+            text += log[i];
+        }
+    }
+    return text;
+}
+
+} // namespace macmemory
@@ -0,0 +1,182 @@
+// libmacmemory - the MacMemory scan engine as a library
+// Scans, filters, watches and memory access without any console output: calls
+// return results and report progress through callbacks. Link with libmacmemory.a.
+
+#ifndef LIBMACMEMORY_H
+#define LIBMACMEMORY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+namespace macmemory {
+
+// Value types, as in the CLI's scan command
+enum class Type {
+    Byte,
+    Short,
+    Int,
+    Long,
+    Float,
+    Double,
+    String,
+    String16,
+    Any
+};
+
+// Comparisons of scan and next. Between and approx take "low high" and
+// "value tolerance"; changed through decreased compare with the previous values.
+enum class Compare {
+    Exact,
+    Greater,
+    Less,
+    Between,
+    Changed,
+    Unchanged,
+    Increased,
+    Decreased,
+    NoCase,
+    Approx
+};
+
+struct Process {
+    pid_t pid;
+    std::string name;
+};
+
+// Which regions a first scan reads: comma-separated tags as accepted by the
+// CLI's --include and --exclude (e.g. "malloc,stack"); empty means all
+struct ScanOptions {
+    std::string include;
+    std::string exclude;
+};
+
+// One value of a group scan: it must start within `within` bytes of the first
+// value of the group (the first one's is ignored)
+struct GroupValue {
+    Type type;
+    std::string value;
+    Compare compare;
+    size_t within;
+};
+
+struct Progress {
+    uint64_t bytesDone;
+    uint64_t bytesTotal;
+    uint64_t hits;
+};
+
+// Called on the thread that started the scan, about every 100 ms while it runs
+using ProgressCallback = std::function<void(const Progress&)>;
+
+// The results of the last scan, read in place from the scanner's columns:
+// addresses() is one array of addresses and values() holds valueSize() bytes
+// per row. Any scans pad every row to the widest type; type(i) tells them apart.
+// A view is invalidated by the next scan, undo or detach.
+class ResultView {
+private:
+    const uint64_t* addressColumn;
+    const uint8_t* valueColumn;
+    const uint8_t* typeColumn;
+    size_t rows;
+    size_t width;
+    Type storeType;
+
+public:
+    ResultView() : addressColumn(nullptr), valueColumn(nullptr), typeColumn(nullptr), rows(0), width(0), storeType(Type::Any) {}
+    ResultView(const uint64_t* addresses, const uint8_t* values, const uint8_t* types, size_t size, size_t valueSize, Type type)
+        : addressColumn(addresses), valueColumn(values), typeColumn(types), rows(size), width(valueSize), storeType(type) {}
+    
+    size_t size() const { return rows; }
+    bool empty() const { return rows == 0; }
+    size_t valueSize() const { return width; }
+    
+    uint64_t address(size_t index) const { return addressColumn[index]; }
+    const uint8_t* value(size_t index) const { return valueColumn + index * width; }
+    Type type(size_t index) const { return typeColumn ? static_cast<Type>(typeColumn[index]) : storeType; }
+    
+    const uint64_t* addresses() const { return addressColumn; }
+    const uint8_t* values() const { return valueColumn; }
+};
+
+// A change seen by a watch; the value pointers are only valid during the callback
+struct WatchChange {
+    uint32_t id;
+    uint64_t address;
+    Type type;
+    size_t size;
+    const uint8_t* oldValue;
+    const uint8_t* newValue;
+    bool readable;
+};
+
+// One attached process and its scan state. Not thread-safe, except for
+// cancel(), which may be called while another thread is scanning.
+class Scanner {
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl;
+
+public:
+    Scanner();
+    ~Scanner();
+    
+    Scanner(const Scanner&) = delete;
+    Scanner& operator=(const Scanner&) = delete;
+    
+    static std::vector<Process> processes();
+    
+    bool attach(pid_t pid);
+    void detach();
+    bool attached() const;
+    
+    // Scans return the number of results; when that is 0 because the scan
+    // could not run, messages() says why
+    size_t scan(Type type, const std::string& value, Compare compare, const ScanOptions& options = ScanOptions());
+    size_t scanUnknown(Type type, const ScanOptions& options = ScanOptions());
+    // Several numeric values close together in one pass; the results are every
+    // value of every group found, each with its own type
+    size_t scanGroup(const std::vector<GroupValue>& values, const ScanOptions& options = ScanOptions());
+    size_t next(Type type, const std::string& value, Compare compare);
+    size_t next(Compare compare);
+    bool undo();
+    void clear();
+    void cancel();
+    
+    // Results of the last scan. After an unknown scan the candidates stay in a
+    // bitmap until a next scan narrows them: the view is then empty and
+    // candidateCount() and forEachCandidate() give them instead.
+    ResultView results() const;
+    size_t candidateCount() const;
+    void forEachCandidate(const std::function<bool(uint64_t address, const uint8_t* value)>& visit) const;
+    
+    // Watches are polled on a background thread; their changes queue up until
+    // pollWatchChanges() hands them to the callback
+    uint32_t watch(uint64_t address, Type type, double intervalMs = 1000);
+    bool unwatch(uint32_t id);
+    size_t pollWatchChanges(const std::function<void(const WatchChange&)>& change);
+    
+    bool read(uint64_t address, void* buffer, size_t size);
+    bool write(uint64_t address, const void* data, size_t size);
+    
+    template <typename T>
+    bool read(uint64_t address, T& value) { return read(address, &value, sizeof(T)); }
+    template <typename T>
+    bool write(uint64_t address, const T& value) { return write(address, &value, sizeof(T)); }
+    
+    void setThreads(size_t threads);
+    void setAlignment(size_t bytes);
+    void setProgressCallback(const ProgressCallback& callback);
+    
+    // What the engine had to say during the last call (errors and notes, no
+    // terminal formatting)
+    std::string messages() const;
+};
+
+} // namespace macmemory
+
+#endif // LIBMACMEMORY_H
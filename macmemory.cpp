@@ -1,978 +1,73 @@
 // MacMemory - A macOS memory scanner and editor
 // Created by: Adrian Maier
 
-#include <iostream>
-#include <vector>
-#include <string>
-#include <map>
-#include <iomanip>
-#include <sstream>
-#include <fstream>
-#include <cstring>
-#include <algorithm>
-#include <functional>
-#include <unordered_map>
-#include <unistd.h> // For usleep()
-
-// macOS specific includes
-#include <mach/mach.h>
-#include <mach/mach_vm.h>
-#include <mach/vm_region.h>
-#include <mach/vm_map.h>
-#include <libproc.h>
-#include <sys/sysctl.h>
-
-// ANSI color codes for terminal output
-namespace Color {
-    const std::string RESET = "\033[0m";
-    const std::string RED = "\033[31m";
-    const std::string GREEN = "\033[32m";
-    const std::string YELLOW = "\033[33m";
-    const std::string BLUE = "\033[34m";
-    const std::string MAGENTA = "\033[35m";
-    const std::string CYAN = "\033[36m";
-    const std::string WHITE = "\033[37m";
-    const std::string BOLD = "\033[1m";
-}
-
-// Enum for value types (using regular enum for compatibility)
-enum ValueType {
-    BYTE,
-    INT16,
-    INT32,
-    INT64,
-    FLOAT,
-    DOUBLE,
-    STRING,
-    UNKNOWN
-};
-
-// String representation of value types
-std::map<ValueType, std::string> valueTypeNames;
-
-// Initialize the map in a function
-void initValueTypeNames() {
-    valueTypeNames[BYTE] = "Byte (1 byte)";
-    valueTypeNames[INT16] = "Short (2 bytes)";
-    valueTypeNames[INT32] = "Int (4 bytes)";
-    valueTypeNames[INT64] = "Long (8 bytes)";
-    valueTypeNames[FLOAT] = "Float (4 bytes)";
-    valueTypeNames[DOUBLE] = "Double (8 bytes)";
-    valueTypeNames[STRING] = "String";
-    valueTypeNames[UNKNOWN] = "Unknown";
-}
-
-// Memory region structure
-struct MemoryRegion {
-    mach_vm_address_t start;
-    mach_vm_size_t size;
-    vm_prot_t protection;
-    std::string name;
-    bool readable;
-    bool writable;
-    bool executable;
-};
-
-// Memory scan result
-struct ScanResult {
-    mach_vm_address_t address;
-    ValueType type;
-    std::vector<uint8_t> value;
-    std::string description;
-};
-
-// Process information
-struct ProcessInfo {
-    pid_t pid;
-    std::string name;
-};
-
-// Main class for memory operations
-class MemoryScanner {
-private:
-    task_t targetTask;
-    pid_t targetPid;
-    std::string targetName;
-    std::vector<MemoryRegion> memoryRegions;
-    std::vector<ScanResult> scanResults;
-    std::vector<ScanResult> previousScanResults;
-    bool isAttached;
-
-public:
-    MemoryScanner() : targetTask(MACH_PORT_NULL), targetPid(0), isAttached(false) {}
-    
-    ~MemoryScanner() {
-        if (isAttached) {
-            detachProcess();
-        }
-    }
-
-    // List all processes
-    std::vector<ProcessInfo> listProcesses() {
-        std::vector<ProcessInfo> processes;
-        int cntp = proc_listpids(PROC_ALL_PIDS, 0, NULL, 0);
-        std::vector<pid_t> pids(cntp);
-        
-        proc_listpids(PROC_ALL_PIDS, 0, pids.data(), sizeof(pid_t) * cntp);
-        
-        for (int i = 0; i < cntp; i++) {
-            if (pids[i] == 0) continue;
-            
-            char name[PROC_PIDPATHINFO_MAXSIZE];
-            if (proc_name(pids[i], name, sizeof(name)) > 0) {
-                ProcessInfo info;
-                info.pid = pids[i];
-                info.name = name;
-                processes.push_back(info);
-            }
-        }
-        
-        return processes;
-    }
-    
-    // Attach to a process
-    bool attachProcess(pid_t pid) {
-        kern_return_t kr = task_for_pid(mach_task_self(), pid, &targetTask);
-        if (kr != KERN_SUCCESS) {
-            std::cerr << "Failed to attach to process. Error: " << mach_error_string(kr) << std::endl;
-            std::cerr << "Note: On macOS, this may require running as root or with special permissions." << std::endl;
-            return false;
-        }
-        
-        targetPid = pid;
-        char name[PROC_PIDPATHINFO_MAXSIZE];
-        if (proc_name(targetPid, name, sizeof(name)) > 0) {
-            targetName = name;
-        } else {
-            targetName = "Unknown";
-        }
-        
-        isAttached = true;
-        memoryRegions.clear();
-        scanResults.clear();
-        previousScanResults.clear();
-        
-        std::cout << "Successfully attached to process: " << targetName << " (PID: " << targetPid << ")" << std::endl;
-        
-        // Load memory regions
-        refreshMemoryRegions();
-        
-        return true;
-    }
-    
-    // Detach from process
-    void detachProcess() {
-        if (isAttached) {
-            mach_port_deallocate(mach_task_self(), targetTask);
-            targetTask = MACH_PORT_NULL;
-            targetPid = 0;
-            targetName = "";
-            isAttached = false;
-            memoryRegions.clear();
-            scanResults.clear();
-            previousScanResults.clear();
-            std::cout << "Detached from process" << std::endl;
-        }
-    }
-    
-    // Refresh memory regions
-    void refreshMemoryRegions() {
-        memoryRegions.clear();
-        
-        mach_vm_address_t address = 0;
-        mach_vm_size_t size = 0;
-        vm_region_basic_info_data_64_t info;
-        mach_msg_type_number_t count = VM_REGION_BASIC_INFO_COUNT_64;
-        mach_port_t object_name;
-        
-        while (true) {
-            kern_return_t kr = mach_vm_region(targetTask, &address, &size, 
-                                             VM_REGION_BASIC_INFO_64, 
-                                             (vm_region_info_t)&info, 
-                                             &count, &object_name);
-            
-            if (kr != KERN_SUCCESS) {
-                break;
-            }
-            
-            MemoryRegion region;
-            region.start = address;
-            region.size = size;
-            region.protection = info.protection;
-            region.readable = (info.protection & VM_PROT_READ) != 0;
-            region.writable = (info.protection & VM_PROT_WRITE) != 0;
-            region.executable = (info.protection & VM_PROT_EXECUTE) != 0;
-            
-            // Get region name/type
-            if (info.reserved) {
-                region.name = "Reserved";
-            } else if (info.protection == 0) {
-                region.name = "No access";
-            } else {
-                std::stringstream ss;
-                ss << (region.readable ? "R" : "-")
-                   << (region.writable ? "W" : "-")
-                   << (region.executable ? "X" : "-");
-                region.name = ss.str();
-            }
-            
-            memoryRegions.push_back(region);
-            address += size;
-        }
-        
-        std::cout << "Found " << memoryRegions.size() << " memory regions" << std::endl;
-    }
-    
-    // Read memory
-    template <typename T>
-    bool readMemory(mach_vm_address_t address, T& value) {
-        mach_vm_size_t size = sizeof(T);
-        mach_vm_size_t data_size = 0;
-        
-        kern_return_t kr = mach_vm_read_overwrite(targetTask, address, size, 
-                                                 (mach_vm_address_t)&value, &data_size);
-        
-        return (kr == KERN_SUCCESS && data_size == size);
-    }
-    
-    // Read a block of memory
-    bool readMemoryBlock(mach_vm_address_t address, void* buffer, size_t size) {
-        mach_vm_size_t data_size = 0;
-        
-        kern_return_t kr = mach_vm_read_overwrite(targetTask, address, size, 
-                                                 (mach_vm_address_t)buffer, &data_size);
-        
-        return (kr == KERN_SUCCESS && data_size == size);
-    }
-    
-    // Write memory
-    template <typename T>
-    bool writeMemory(mach_vm_address_t address, const T& value) {
-        kern_return_t kr = mach_vm_write(targetTask, address, (vm_offset_t)&value, sizeof(T));
-        return (kr == KERN_SUCCESS);
-    }
-    
-    // First scan - find values
-    void firstScan(ValueType type, const std::string& value, const std::string& comparison) {
-        scanResults.clear();
-        previousScanResults.clear();
-        
-        std::cout << "Starting first scan, please wait..." << std::endl;
-        
-        size_t valueSize = 0;
-        std::vector<uint8_t> targetValue;
-        
-        switch (type) {
-            case ValueType::BYTE: {
-                uint8_t val = static_cast<uint8_t>(std::stoi(value));
-                valueSize = sizeof(val);
-                targetValue.resize(valueSize);
-                memcpy(targetValue.data(), &val, valueSize);
-                break;
-            }
-            case ValueType::INT16: {
-                int16_t val = static_cast<int16_t>(std::stoi(value));
-                valueSize = sizeof(val);
-                targetValue.resize(valueSize);
-                memcpy(targetValue.data(), &val, valueSize);
-                break;
-            }
-            case ValueType::INT32: {
-                int32_t val = static_cast<int32_t>(std::stoi(value));
-                valueSize = sizeof(val);
-                targetValue.resize(valueSize);
-                memcpy(targetValue.data(), &val, valueSize);
-                break;
-            }
-            case ValueType::INT64: {
-                int64_t val = static_cast<int64_t>(std::stoll(value));
-                valueSize = sizeof(val);
-                targetValue.resize(valueSize);
-                memcpy(targetValue.data(), &val, valueSize);
-                break;
-            }
-            case ValueType::FLOAT: {
-                float val = std::stof(value);
-                valueSize = sizeof(val);
-                targetValue.resize(valueSize);
-                memcpy(targetValue.data(), &val, valueSize);
-                break;
-            }
-            case ValueType::DOUBLE: {
-                double val = std::stod(value);
-                valueSize = sizeof(val);
-                targetValue.resize(valueSize);
-                memcpy(targetValue.data(), &val, valueSize);
-                break;
-            }
-            case ValueType::STRING: {
-                valueSize = value.length();
-                targetValue.resize(valueSize);
-                memcpy(targetValue.data(), value.c_str(), valueSize);
-                break;
-            }
-            default:
-                std::cout << "Unsupported value type" << std::endl;
-                return;
-        }
-        
-        size_t totalRegions = memoryRegions.size();
-        size_t regionsScanned = 0;
-        size_t totalHits = 0;
-        
-        // Iterate through memory regions
-        for (size_t i = 0; i < memoryRegions.size(); i++) {
-            const MemoryRegion& region = memoryRegions[i];
-            regionsScanned++;
-            
-            // Skip non-readable regions
-            if (!region.readable) {
-                continue;
-            }
-            
-            // Progress update
-            if (regionsScanned % 100 == 0) {
-                float progress = static_cast<float>(regionsScanned) / static_cast<float>(totalRegions) * 100.0f;
-                std::cout << "\rScanning... " << std::fixed << std::setprecision(1) << progress << "% complete" << std::flush;
-            }
-            
-            // Allocate buffer for region data
-            std::vector<uint8_t> buffer(region.size);
-            if (!readMemoryBlock(region.start, buffer.data(), region.size)) {
-                continue;
-            }
-            
-            // Scan for values
-            for (size_t offset = 0; offset <= buffer.size() - valueSize; offset++) {
-                bool found = false;
-                
-                if (comparison == "exact") {
-                    found = (memcmp(buffer.data() + offset, targetValue.data(), valueSize) == 0);
-                } else if (comparison == "greater") {
-                    // Implement comparison logic for each type
-                    switch (type) {
-                        case ValueType::BYTE: {
-                            uint8_t val = *reinterpret_cast<uint8_t*>(buffer.data() + offset);
-                            uint8_t target = *reinterpret_cast<uint8_t*>(targetValue.data());
-                            found = val > target;
-                            break;
-                        }
-                        case ValueType::INT16: {
-                            int16_t val = *reinterpret_cast<int16_t*>(buffer.data() + offset);
-                            int16_t target = *reinterpret_cast<int16_t*>(targetValue.data());
-                            found = val > target;
-                            break;
-                        }
-                        case ValueType::INT32: {
-                            int32_t val = *reinterpret_cast<int32_t*>(buffer.data() + offset);
-                            int32_t target = *reinterpret_cast<int32_t*>(targetValue.data());
-                            found = val > target;
-                            break;
-                        }
-                        case ValueType::INT64: {
-                            int64_t val = *reinterpret_cast<int64_t*>(buffer.data() + offset);
-                            int64_t target = *reinterpret_cast<int64_t*>(targetValue.data());
-                            found = val > target;
-                            break;
-                        }
-                        case ValueType::FLOAT: {
-                            float val = *reinterpret_cast<float*>(buffer.data() + offset);
-                            float target = *reinterpret_cast<float*>(targetValue.data());
-                            found = val > target;
-                            break;
-                        }
-                        case ValueType::DOUBLE: {
-                            double val = *reinterpret_cast<double*>(buffer.data() + offset);
-                            double target = *reinterpret_cast<double*>(targetValue.data());
-                            found = val > target;
-                            break;
-                        }
-                        default:
-                            break;
-                    }
-                } else if (comparison == "less") {
-                    // Similar logic for less than comparison
-                    switch (type) {
-                        case ValueType::BYTE: {
-                            uint8_t val = *reinterpret_cast<uint8_t*>(buffer.data() + offset);
-                            uint8_t target = *reinterpret_cast<uint8_t*>(targetValue.data());
-                            found = val < target;
-                            break;
-                        }
-                        case ValueType::INT16: {
-                            int16_t val = *reinterpret_cast<int16_t*>(buffer.data() + offset);
-                            int16_t target = *reinterpret_cast<int16_t*>(targetValue.data());
-                            found = val < target;
-                            break;
-                        }
-                        case ValueType::INT32: {
-                            int32_t val = *reinterpret_cast<int32_t*>(buffer.data() + offset);
-                            int32_t target = *reinterpret_cast<int32_t*>(targetValue.data());
-                            found = val < target;
-                            break;
-                        }
-                        case ValueType::INT64: {
-                            int64_t val = *reinterpret_cast<int64_t*>(buffer.data() + offset);
-                            int64_t target = *reinterpret_cast<int64_t*>(targetValue.data());
-                            found = val < target;
-                            break;
-                        }
-                        case ValueType::FLOAT: {
-                            float val = *reinterpret_cast<float*>(buffer.data() + offset);
-                            float target = *reinterpret_cast<float*>(targetValue.data());
-                            found = val < target;
-                            break;
-                        }
-                        case ValueType::DOUBLE: {
-                            double val = *reinterpret_cast<double*>(buffer.data() + offset);
-                            double target = *reinterpret_cast<double*>(targetValue.data());
-                            found = val < target;
-                            break;
-                        }
-                        default:
-                            break;
-                    }
-                }
-                
-                if (found) {
-                    ScanResult result;
-                    result.address = region.start + offset;
-                    result.type = type;
-                    result.value.resize(valueSize);
-                    memcpy(result.value.data(), buffer.data() + offset, valueSize);
-                    
-                    // Create description string
-                    std::stringstream ss;
-                    switch (type) {
-                        case ValueType::BYTE:
-                            ss << static_cast<int>(*reinterpret_cast<uint8_t*>(result.value.data()));
-                            break;
-                        case ValueType::INT16:
-                            ss << *reinterpret_cast<int16_t*>(result.value.data());
-                            break;
-                        case ValueType::INT32:
-                            ss << *reinterpret_cast<int32_t*>(result.value.data());
-                            break;
-                        case ValueType::INT64:
-                            ss << *reinterpret_cast<int64_t*>(result.value.data());
-                            break;
-                        case ValueType::FLOAT:
-                            ss << *reinterpret_cast<float*>(result.value.data());
-                            break;
-                        case ValueType::DOUBLE:
-                            ss << *reinterpret_cast<double*>(result.value.data());
-                            break;
-                        case ValueType::STRING: {
-                            std::string str(reinterpret_cast<char*>(result.value.data()), result.value.size());
-                            ss << "\"" << str << "\"";
-                            break;
-                        }
-                        default:
-                            ss << "Unknown";
-                            break;
-                    }
-                    result.description = ss.str();
-                    
-                    scanResults.push_back(result);
-                    totalHits++;
-                    
-                    // Limit results to prevent memory exhaustion
-                    if (totalHits >= 10000) {
-                        std::cout << "\rToo many results (>10000), stopping scan" << std::endl;
-                        break;
-                    }
-                }
-            }
-            
-            if (totalHits >= 10000) {
-                break;
-            }
-        }
-        
-        std::cout << "\rScan complete. Found " << scanResults.size() << " matches.                " << std::endl;
-    }
-    
-    // Next scan - filter existing results
-    void nextScan(ValueType type, const std::string& value, const std::string& comparison) {
-        if (scanResults.empty()) {
-            std::cout << "No previous scan results to filter" << std::endl;
-            return;
-        }
-        
-        // Store previous results
-        previousScanResults = scanResults;
-        scanResults.clear();
-        
-        std::cout << "Starting next scan, filtering " << previousScanResults.size() << " addresses..." << std::endl;
-        
-        // Parse search value
-        std::vector<uint8_t> targetValue;
-        size_t valueSize = 0;
-        
-        switch (type) {
-            case ValueType::BYTE: {
-                uint8_t val = static_cast<uint8_t>(std::stoi(value));
-                valueSize = sizeof(val);
-                targetValue.resize(valueSize);
-                memcpy(targetValue.data(), &val, valueSize);
-                break;
-            }
-            case ValueType::INT16: {
-                int16_t val = static_cast<int16_t>(std::stoi(value));
-                valueSize = sizeof(val);
-                targetValue.resize(valueSize);
-                memcpy(targetValue.data(), &val, valueSize);
-                break;
-            }
-            case ValueType::INT32: {
-                int32_t val = static_cast<int32_t>(std::stoi(value));
-                valueSize = sizeof(val);
-                targetValue.resize(valueSize);
-                memcpy(targetValue.data(), &val, valueSize);
-                break;
-            }
-            case ValueType::INT64: {
-                int64_t val = static_cast<int64_t>(std::stoll(value));
-                valueSize = sizeof(val);
-                targetValue.resize(valueSize);
-                memcpy(targetValue.data(), &val, valueSize);
-                break;
-            }
-            case ValueType::FLOAT: {
-                float val = std::stof(value);
-                valueSize = sizeof(val);
-                targetValue.resize(valueSize);
-                memcpy(targetValue.data(), &val, valueSize);
-                break;
-            }
-            case ValueType::DOUBLE: {
-                double val = std::stod(value);
-                valueSize = sizeof(val);
-                targetValue.resize(valueSize);
-                memcpy(targetValue.data(), &val, valueSize);
-                break;
-            }
-            case ValueType::STRING: {
-                valueSize = value.length();
-                targetValue.resize(valueSize);
-                memcpy(targetValue.data(), value.c_str(), valueSize);
-                break;
-            }
-            default:
-                std::cout << "Unsupported value type" << std::endl;
-                return;
-        }
-        
-        size_t totalAddresses = previousScanResults.size();
-        size_t addressesChecked = 0;
-        
-        // Check each previous result
-        for (size_t i = 0; i < previousScanResults.size(); i++) {
-            const ScanResult& prevResult = previousScanResults[i];
-            addressesChecked++;
-            
-            // Progress update
-            if (addressesChecked % 1000 == 0) {
-                float progress = static_cast<float>(addressesChecked) / static_cast<float>(totalAddresses) * 100.0f;
-                std::cout << "\rFiltering... " << std::fixed << std::setprecision(1) << progress << "% complete" << std::flush;
-            }
-            
-            // Read current value at address
-            std::vector<uint8_t> currentValue(valueSize);
-            if (!readMemoryBlock(prevResult.address, currentValue.data(), valueSize)) {
-                continue;
-            }
-            
-            bool found = false;
-            
-            if (comparison == "exact") {
-                found = (memcmp(currentValue.data(), targetValue.data(), valueSize) == 0);
-            } else if (comparison == "greater") {
-                switch (type) {
-                    case ValueType::BYTE: {
-                        uint8_t val = *reinterpret_cast<uint8_t*>(currentValue.data());
-                        uint8_t target = *reinterpret_cast<uint8_t*>(targetValue.data());
-                        found = val > target;
-                        break;
-                    }
-                    case ValueType::INT16: {
-                        int16_t val = *reinterpret_cast<int16_t*>(currentValue.data());
-                        int16_t target = *reinterpret_cast<int16_t*>(targetValue.data());
-                        found = val > target;
-                        break;
-                    }
-                    case ValueType::INT32: {
-                        int32_t val = *reinterpret_cast<int32_t*>(currentValue.data());
-                        int32_t target = *reinterpret_cast<int32_t*>(targetValue.data());
-                        found = val > target;
-                        break;
-                    }
-                    case ValueType::INT64: {
-                        int64_t val = *reinterpret_cast<int64_t*>(currentValue.data());
-                        int64_t target = *reinterpret_cast<int64_t*>(targetValue.data());
-                        found = val > target;
-                        break;
-                    }
-                    case ValueType::FLOAT: {
-                        float val = *reinterpret_cast<float*>(currentValue.data());
-                        float target = *reinterpret_cast<float*>(targetValue.data());
-                        found = val > target;
-                        break;
-                    }
-                    case ValueType::DOUBLE: {
-                        double val = *reinterpret_cast<double*>(currentValue.data());
-                        double target = *reinterpret_cast<double*>(targetValue.data());
-                        found = val > target;
-                        break;
-                    }
-                    default:
-                        break;
-                }
-            } else if (comparison == "less") {
-                switch (type) {
-                    case ValueType::BYTE: {
-                        uint8_t val = *reinterpret_cast<uint8_t*>(currentValue.data());
-                        uint8_t target = *reinterpret_cast<uint8_t*>(targetValue.data());
-                        found = val < target;
-                        break;
-                    }
-                    case ValueType::INT16: {
-                        int16_t val = *reinterpret_cast<int16_t*>(currentValue.data());
-                        int16_t target = *reinterpret_cast<int16_t*>(targetValue.data());
-                        found = val < target;
-                        break;
-                    }
-                    case ValueType::INT32: {
-                        int32_t val = *reinterpret_cast<int32_t*>(currentValue.data());
-                        int32_t target = *reinterpret_cast<int32_t*>(targetValue.data());
-                        found = val < target;
-                        break;
-                    }
-                    case ValueType::INT64: {
-                        int64_t val = *reinterpret_cast<int64_t*>(currentValue.data());
-                        int64_t target = *reinterpret_cast<int64_t*>(targetValue.data());
-                        found = val < target;
-                        break;
-                    }
-                    case ValueType::FLOAT: {
-                        float val = *reinterpret_cast<float*>(currentValue.data());
-                        float target = *reinterpret_cast<float*>(targetValue.data());
-                        found = val < target;
-                        break;
-                    }
-                    case ValueType::DOUBLE: {
-                        double val = *reinterpret_cast<double*>(currentValue.data());
-                        double target = *reinterpret_cast<double*>(targetValue.data());
-                        found = val < target;
-                        break;
-                    }
-                    default:
-                        break;
-                }
-            } else if (comparison == "changed") {
-                found = (memcmp(currentValue.data(), prevResult.value.data(), valueSize) != 0);
-            } else if (comparison == "unchanged") {
-                found = (memcmp(currentValue.data(), prevResult.value.data(), valueSize) == 0);
-            }
-            
-            if (found) {
-                ScanResult result = prevResult;
-                result.value = currentValue;
-                
-                // Update description
-                std::stringstream ss;
-                switch (type) {
-                    case ValueType::BYTE:
-                        ss << static_cast<int>(*reinterpret_cast<uint8_t*>(result.value.data()));
-                        break;
-                    case ValueType::INT16:
-                        ss << *reinterpret_cast<int16_t*>(result.value.data());
-                        break;
-                    case ValueType::INT32:
-                        ss << *reinterpret_cast<int32_t*>(result.value.data());
-                        break;
-                    case ValueType::INT64:
-                        ss << *reinterpret_cast<int64_t*>(result.value.data());
-                        break;
-                    case ValueType::FLOAT:
-                        ss << *reinterpret_cast<float*>(result.value.data());
-                        break;
-                    case ValueType::DOUBLE:
-                        ss << *reinterpret_cast<double*>(result.value.data());
-                        break;
-                    case ValueType::STRING: {
-                        std::string str(reinterpret_cast<char*>(result.value.data()), result.value.size());
-                        ss << "\"" << str << "\"";
-                        break;
-                    }
-                    default:
-                        ss << "Unknown";
-                        break;
-                }
-                result.description = ss.str();
-                
-                scanResults.push_back(result);
-            }
-        }
-        
-        std::cout << "\rFiltering complete. Found " << scanResults.size() << " matches.                " << std::endl;
-    }
-    
-    // Display scan results
-    void displayResults(size_t limit = 20) {
-        if (scanResults.empty()) {
-            std::cout << "No scan results to display" << std::endl;
-            return;
-        }
-        
-        std::cout << Color::BOLD << "Scan Results (" << scanResults.size() << " total):" << Color::RESET << std::endl;
-        std::cout << "───────────────────────────────────────────────────────────────" << std::endl;
-        std::cout << Color::BOLD << std::left << std::setw(5) << "ID" 
-                  << std::setw(18) << "Address" 
-                  << std::setw(12) << "Type" 
-                  << "Value" << Color::RESET << std::endl;
-        std::cout << "───────────────────────────────────────────────────────────────" << std::endl;
-        
-        size_t count = 0;
-        for (size_t i = 0; i < scanResults.size() && count < limit; i++) {
-            const auto& result = scanResults[i];
-            
-            std::stringstream addr;
-            addr << "0x" << std::hex << std::setw(16) << std::setfill('0') << result.address;
-            
-            std::cout << std::left << std::setw(5) << i 
-                      << std::setw(18) << addr.str() 
-                      << std::setw(12) << valueTypeNames[result.type] 
-                      << result.description << std::endl;
-            count++;
-        }
-        
-        if (scanResults.size() > limit) {
-            std::cout << "... and " << (scanResults.size() - limit) << " more results" << std::endl;
-        }
-        
-        std::cout << "───────────────────────────────────────────────────────────────" << std::endl;
-    }
-    
-    // Modify a value at a specific address
-    template <typename T>
-    bool modifyValue(mach_vm_address_t address, T value) {
-        return writeMemory(address, value);
-    }
-    
-    // Create a watchpoint for an address
-    void watchAddress(mach_vm_address_t address, ValueType type, size_t updateInterval = 1000) {
-        if (!isAttached) {
-            std::cout << "Not attached to any process" << std::endl;
-            return;
-        }
-        
-        size_t valueSize = 0;
-        switch (type) {
-            case ValueType::BYTE: valueSize = 1; break;
-            case ValueType::INT16: valueSize = 2; break;
-            case ValueType::INT32: valueSize = 4; break;
-            case ValueType::INT64: valueSize = 8; break;
-            case ValueType::FLOAT: valueSize = 4; break;
-            case ValueType::DOUBLE: valueSize = 8; break;
-            case ValueType::STRING: valueSize = 32; break; // Default string size to watch
-            default: valueSize = 4; break;
-        }
-        
-        std::vector<uint8_t> lastValue(valueSize);
-        if (!readMemoryBlock(address, lastValue.data(), valueSize)) {
-            std::cout << "Failed to read initial value at address 0x" 
-                      << std::hex << address << std::dec << std::endl;
-            return;
-        }
-        
-        // Display initial value
-        std::cout << "Watching address 0x" << std::hex << address << std::dec 
-                  << " (Type: " << valueTypeNames[type] << ")" << std::endl;
-        std::cout << "Initial value: ";
-        printValue(lastValue.data(), type);
-        std::cout << std::endl;
-        
-        std::cout << "Press Ctrl+C to stop watching" << std::endl;
-        
-        // Watch loop
-        int updateCount = 0;
-        try {
-            while (true) {
-                std::vector<uint8_t> currentValue(valueSize);
-                if (!readMemoryBlock(address, currentValue.data(), valueSize)) {
-                    std::cout << "Failed to read value" << std::endl;
-                    break;
-                }
-                
-                // Check if value changed
-                if (memcmp(lastValue.data(), currentValue.data(), valueSize) != 0) {
-                    updateCount++;
-                    std::cout << "Change detected (#" << updateCount << "): ";
-                    std::cout << "Old: ";
-                    printValue(lastValue.data(), type);
-                    std::cout << " → New: ";
-                    printValue(currentValue.data(), type);
-                    std::cout << std::endl;
-                    
-                    // Update last value
-                    lastValue = currentValue;
-                }
-                
-                // Sleep - using older sleep method for compatibility
-                usleep(updateInterval * 1000);
-            }
-        } catch (const std::exception& e) {
-            std::cout << "Error while watching: " << e.what() << std::endl;
-        }
-    }
-    
-    // Print a value based on type
-    void printValue(const void* data, ValueType type) {
-        switch (type) {
-            case ValueType::BYTE:
-                std::cout << static_cast<int>(*reinterpret_cast<const uint8_t*>(data));
-                break;
-            case ValueType::INT16:
-                std::cout << *reinterpret_cast<const int16_t*>(data);
-                break;
-            case ValueType::INT32:
-                std::cout << *reinterpret_cast<const int32_t*>(data);
-                break;
-            case ValueType::INT64:
-                std::cout << *reinterpret_cast<const int64_t*>(data);
-                break;
-            case ValueType::FLOAT:
-                std::cout << *reinterpret_cast<const float*>(data);
-                break;
-            case ValueType::DOUBLE:
-                std::cout << *reinterpret_cast<const double*>(data);
-                break;
-            case ValueType::STRING: {
-                std::string str(reinterpret_cast<const char*>(data));
-                std::cout << "\"" << str << "\"";
-                break;
-            }
-            default:
-                std::cout << "Unknown";
-                break;
-        }
-    }
-    
-    // Load scanning patterns from file
-    void loadPatterns(const std::string& filename) {
-        // Implementation for loading signature patterns
-    }
-    
-    // Save scan results to file
-    void saveResults(const std::string& filename) {
-        if (scanResults.empty()) {
-            std::cout << "No results to save" << std::endl;
-            return;
-        }
-        
-        std::ofstream file(filename);
-        if (!file) {
-            std::cout << "Failed to open file: " << filename << std::endl;
-            return;
-        }
-        
-        file << "# MacMemory Scan Results" << std::endl;
-        file << "# Process: " << targetName << " (PID: " << targetPid << ")" << std::endl;
-        file << "# Timestamp: " << std::time(nullptr) << std::endl;
-        file << "# Results: " << scanResults.size() << std::endl;
-        file << "# Format: ID,Address,Type,Value,Description" << std::endl;
-        
-        for (size_t i = 0; i < scanResults.size(); i++) {
-            const auto& result = scanResults[i];
-            
-            file << i << ","
-                 << "0x" << std::hex << result.address << std::dec << ","
-                 << static_cast<int>(result.type) << ",";
-            
-            // Save value as hex bytes
-            for (size_t j = 0; j < result.value.size(); j++) {
-                file << std::hex << std::setw(2) << std::setfill('0') 
-                     << static_cast<int>(result.value[j]);
-            }
-            
-            file << "," << result.description << std::endl;
-        }
-        
-        file.close();
-        std::cout << "Saved " << scanResults.size() << " results to " << filename << std::endl;
-    }
-    
-    // Load scan results from file
-    void loadResults(const std::string& filename) {
-        // Implementation for loading saved results
-    }
-    
-    // Get current attached process info
-    void getProcessInfo() {
-        if (!isAttached) {
-            std::cout << "Not attached to any process" << std::endl;
-            return;
-        }
-        
-        std::cout << "Process Information:" << std::endl;
-        std::cout << "  Name: " << targetName << std::endl;
-        std::cout << "  PID: " << targetPid << std::endl;
-        std::cout << "  Memory Regions: " << memoryRegions.size() << std::endl;
-        std::cout << "  Current Scan Results: " << scanResults.size() << std::endl;
-        
-        // Get total memory usage
-        size_t totalMemory = 0;
-        for (const auto& region : memoryRegions) {
-            totalMemory += region.size;
-        }
-        
-        std::cout << "  Total Memory: " << (totalMemory / (1024 * 1024)) << " MB" << std::endl;
-    }
-    
-    // Helper methods
-    bool isProcessAttached() const { return isAttached; }
-    std::string getProcessName() const { return targetName; }
-    pid_t getProcessId() const { return targetPid; }
-    size_t getResultCount() const { return scanResults.size(); }
-};
+#include "scanner.h"
 
 // Command-line interface class
 class CLI {
 private:
     MemoryScanner scanner;
+    ProcessSet processSet;
     bool running;
+    bool backgroundScans;
     std::unordered_map<std::string, std::function<void(const std::vector<std::string>&)>> commands;
     
 public:
-    CLI() : running(false) {
+    // Scans run in the background when someone is at the terminal; piped
+    // commands run one after the other
+    CLI() : processSet(scanner), running(false), backgroundScans(isatty(STDIN_FILENO)) {
         initCommands();
     }
     
     void initCommands() {
         // Core commands
         commands["help"] = [this](const std::vector<std::string>& args) { showHelp(args); };
-        commands["exit"] = [this](const std::vector<std::string>& args) { running = false; };
-        commands["quit"] = [this](const std::vector<std::string>& args) { running = false; };
+        commands["exit"] = [this](const std::vector<std::string>& args) { quit(); };
+        commands["quit"] = [this](const std::vector<std::string>& args) { quit(); };
         
         // Process commands
         commands["ps"] = [this](const std::vector<std::string>& args) { listProcesses(args); };
         commands["attach"] = [this](const std::vector<std::string>& args) { attachProcess(args); };
         commands["detach"] = [this](const std::vector<std::string>& args) { detachProcess(args); };
         commands["info"] = [this](const std::vector<std::string>& args) { processInfo(args); };
+        commands["multi"] = [this](const std::vector<std::string>& args) { multiProcess(args); };
         
         // Memory commands
         commands["regions"] = [this](const std::vector<std::string>& args) { listRegions(args); };
         commands["scan"] = [this](const std::vector<std::string>& args) { scanMemory(args); };
         commands["next"] = [this](const std::vector<std::string>& args) { nextScan(args); };
+        commands["undo"] = [this](const std::vector<std::string>& args) { undoScan(args); };
         commands["results"] = [this](const std::vector<std::string>& args) { showResults(args); };
         commands["read"] = [this](const std::vector<std::string>& args) { readMemory(args); };
         commands["write"] = [this](const std::vector<std::string>& args) { writeMemory(args); };
         commands["watch"] = [this](const std::vector<std::string>& args) { watchMemory(args); };
+        commands["watches"] = [this](const std::vector<std::string>& args) { listWatches(args); };
+        commands["unwatch"] = [this](const std::vector<std::string>& args) { unwatch(args); };
+        commands["freeze"] = [this](const std::vector<std::string>& args) { freezeMemory(args); };
+        commands["frozen"] = [this](const std::vector<std::string>& args) { scanner.listFreezes(); };
+        commands["unfreeze"] = [this](const std::vector<std::string>& args) { unfreeze(args); };
+        commands["pointerscan"] = [this](const std::vector<std::string>& args) { pointerScan(args); };
+        commands["pointers"] = [this](const std::vector<std::string>& args) { showPointers(args); };
+        commands["aob"] = [this](const std::vector<std::string>& args) { aobScan(args); };
+        commands["patterns"] = [this](const std::vector<std::string>& args) { patterns(args); };
+        commands["snapshot"] = [this](const std::vector<std::string>& args) { snapshot(args); };
+        commands["snapshots"] = [this](const std::vector<std::string>& args) { scanner.listSnapshots(); };
+        
+        // Background scans
+        commands["status"] = [this](const std::vector<std::string>& args) { scanner.displayJobStatus(); };
+        commands["cancel"] = [this](const std::vector<std::string>& args) { scanner.cancelJob(); };
+        commands["wait"] = [this](const std::vector<std::string>& args) { scanner.waitForJob(); };
+        
+        // Diagnostics
+        commands["stats"] = [this](const std::vector<std::string>& args) { showStats(args); };
         
         // Data management
         commands["save"] = [this](const std::vector<std::string>& args) { saveResults(args); };
         commands["load"] = [this](const std::vector<std::string>& args) { loadResults(args); };
+        commands["export"] = [this](const std::vector<std::string>& args) { exportResults(args); };
+        
+        // Settings
+        commands["set"] = [this](const std::vector<std::string>& args) { setOption(args); };
     }
     
     void run() {
@@ -986,6 +81,11 @@ public:
             std::string input;
             std::vector<std::string> args;
             
+            // Show changes the watch engine picked up since the last command, and
+            // what a background scan had to say once it finished
+            scanner.printWatchEvents();
+            scanner.printJobMessages();
+            
             // Display prompt based on attachment status
             if (scanner.isProcessAttached()) {
                 std::cout << Color::GREEN << scanner.getProcessName() << "(" << scanner.getProcessId() << ")> " << Color::RESET;
@@ -993,31 +93,32 @@ public:
                 std::cout << Color::YELLOW << "MacMemory> " << Color::RESET;
             }
             
-            std::getline(std::cin, input);
+            // End of input (Ctrl-D or the end of piped commands) exits
+            if (!std::getline(std::cin, input)) {
+                std::cout << std::endl;
+                quit();
+                break;
+            }
             if (input.empty()) {
                 continue;
             }
             
-            // Tokenize input
-            std::istringstream iss(input);
-            std::string token;
-            while (iss >> token) {
-                args.push_back(token);
-            }
-            
+            args = tokenize(input);
             if (!args.empty()) {
                 std::string cmd = args[0];
                 args.erase(args.begin()); // Remove command from args
                 
                 auto it = commands.find(cmd);
-                if (it != commands.end()) {
+                if (it != commands.end() && scanner.jobRunning() && !allowedDuringScan(cmd)) {
+                    std::cout << "A scan is running; use status, results, cancel or wait" << std::endl;
+                } else if (it != commands.end()) {
                     try {
                         it->second(args);
                     } catch (const std::exception& e) {
-                        std::cout << Color::RED << "Error executing command: " << e.what() << Color::RESET << std::endl;
+                        std::cerr << Color::RED << "Error executing command: " << e.what() << Color::RESET << std::endl;
                     }
                 } else {
-                    std::cout << "Unknown command: " << cmd << ". Type 'help' for a list of commands." << std::endl;
+                    std::cerr << "Unknown command: " << cmd << ". Type 'help' for a list of commands." << std::endl;
                 }
             }
         }
@@ -1025,36 +126,253 @@ public:
         std::cout << "Exiting MacMemory. Goodbye!" << std::endl;
     }
     
-    // Command implementations
-    void showHelp(const std::vector<std::string>& args) {
-        std::cout << Color::BOLD << "MacMemory Commands:" << Color::RESET << std::endl;
-        std::cout << "───────────────────────────────────────────────────────────────" << std::endl;
+    static std::vector<std::string> tokenize(const std::string& input) {
+        std::vector<std::string> args;
+        std::istringstream iss(input);
+        std::string token;
+        while (iss >> token) {
+            args.push_back(token);
+        }
+        return args;
+    }
+    
+    // Non-interactive mode: no prompt, colors or progress lines. Scans run in the
+    // foreground and the region map is only walked on attach (and by regions), so
+    // attach, scan, next and save don't each enumerate it again.
+    void startBatch() {
+        Color::disable();
+        backgroundScans = false;
+        scanner.setProgress(false);
+        scanner.setRegionRefresh(false);
+        running = true;
+    }
+    
+    // Run one command line of a batch and answer it with one NDJSON record:
+    // the command, whether it succeeded, how long it took, the result count, and
+    // what it printed. results adds its rows and stats its counters.
+    // Returns false if the command failed or wrote to stderr.
+    bool runBatchCommand(const std::string& line, size_t lineNumber) {
+        std::vector<std::string> args = tokenize(line);
+        if (args.empty() || args[0][0] == '#') {
+            return true;
+        }
+        std::string cmd = args[0];
+        args.erase(args.begin());
+        
+        std::ostringstream output;
+        std::ostringstream errors;
+        std::streambuf* savedOutput = std::cout.rdbuf(output.rdbuf());
+        std::streambuf* savedErrors = std::cerr.rdbuf(errors.rdbuf());
+        
+        std::string error;
+        uint64_t start = statClock();
+        auto it = commands.find(cmd);
+        if (it == commands.end()) {
+            error = "Unknown command: " + cmd;
+        } else {
+            try {
+                it->second(args);
+                scanner.printWatchEvents();
+            } catch (const std::exception& e) {
+                error = e.what();
+            }
+        }
+        double seconds = static_cast<double>(statClock() - start) / 1e9;
+        
+        std::cout.rdbuf(savedOutput);
+        std::cerr.rdbuf(savedErrors);
+        
+        // One entry per printed line; a progress line overwritten with \r keeps its last text
+        auto lines = [](const std::string& text) {
+            std::string list;
+            std::istringstream stream(text);
+            std::string line;
+            while (std::getline(stream, line)) {
+                size_t carriage = line.rfind('\r');
+                if (carriage != std::string::npos) {
+                    line = line.substr(carriage + 1);
+                }
+                if (!line.empty()) {
+                    list += (list.empty() ? "" : ", ") + jsonQuote(line);
+                }
+            }
+            return "[" + list + "]";
+        };
+        
+        bool succeeded = error.empty() && errors.str().empty();
+        std::cout << "{\"line\": " << lineNumber << ", \"command\": " << jsonQuote(cmd) << ", \"args\": [";
+        for (size_t i = 0; i < args.size(); i++) {
+            std::cout << (i > 0 ? ", " : "") << jsonQuote(args[i]);
+        }
+        std::cout << "], \"ok\": " << (succeeded ? "true" : "false");
+        if (!error.empty()) {
+            std::cout << ", \"error\": " << jsonQuote(error);
+        }
+        std::cout << ", \"seconds\": " << std::fixed << std::setprecision(6) << seconds << std::defaultfloat;
+        if (scanner.isProcessAttached()) {
+            std::cout << ", \"pid\": " << scanner.getProcessId() << ", \"results\": " << scanner.getResultCount();
+        }
+        if (cmd == "results" && it != commands.end()) {
+            size_t limit = 20;
+            try {
+                limit = args.empty() ? limit : std::stoul(args[0]);
+            } catch (const std::exception&) {
+            }
+            std::cout << ", \"rows\": " << scanner.resultsJson(limit);
+        } else if (cmd == "stats" && args.empty()) {
+            std::cout << ", \"stats\": " << scanner.statsJson();
+        }
+        std::cout << ", \"output\": " << lines(output.str());
+        if (!errors.str().empty()) {
+            std::cout << ", \"errors\": " << lines(errors.str());
+        }
+        std::cout << "}" << std::endl;
+        return succeeded;
+    }
+    
+    // Run a script of commands (or stdin) in batch mode, one per line; # starts a
+    // comment. Stops at quit or exit. Returns false if any command failed.
+    bool runBatch(std::istream& script) {
+        startBatch();
+        bool succeeded = true;
+        std::string line;
+        for (size_t lineNumber = 1; running && std::getline(script, line); lineNumber++) {
+            succeeded = runBatchCommand(line, lineNumber) && succeeded;
+        }
+        quit();
+        
+        // Detach quietly so stdout only carries the records
+        if (scanner.isProcessAttached()) {
+            std::ostringstream discarded;
+            std::streambuf* savedOutput = std::cout.rdbuf(discarded.rdbuf());
+            scanner.detachProcess();
+            std::cout.rdbuf(savedOutput);
+        }
+        return succeeded;
+    }
+    
+    // Commands that don't touch the scan state or the region map, so they can run
+    // next to a background scan
+    static bool allowedDuringScan(const std::string& cmd) {
+        static const std::unordered_set<std::string> allowed = {
+            "help", "exit", "quit", "ps", "results", "watches", "unwatch", "frozen", "unfreeze", "status", "cancel", "wait"
+        };
+        return allowed.count(cmd) > 0;
+    }
+    
+    // A scan still running is cancelled before exiting
+    void quit() {
+        if (scanner.jobRunning()) {
+            scanner.cancelJob();
+            scanner.waitForJob();
+        }
+        running = false;
+    }
+    
+    // Run a scan command as a job, named after the command line
+    void runScan(const std::string& command, const std::vector<std::string>& args, const std::function<void()>& fn) {
+        std::string description = command;
+        for (const std::string& arg : args) {
+            description += " " + arg;
+        }
+        scanner.startJob(description, backgroundScans, fn);
+    }
+    
+    // Command implementations
+    void showHelp(const std::vector<std::string>& args) {
+        std::cout << Color::BOLD << "MacMemory Commands:" << Color::RESET << std::endl;
+        std::cout << "───────────────────────────────────────────────────────────────" << std::endl;
         
         std::cout << Color::BOLD << "Process Commands:" << Color::RESET << std::endl;
-        std::cout << "  ps                    - List running processes" << std::endl;
+        std::cout << "  ps [name]             - List running processes (whose name contains name)" << std::endl;
+        std::cout << "    Options: --match <pattern> (shell pattern), --tree <pid> (a process and its children)" << std::endl;
         std::cout << "  attach <pid>          - Attach to a process by ID" << std::endl;
         std::cout << "  detach                - Detach from current process" << std::endl;
         std::cout << "  info                  - Show current process information" << std::endl;
         
+        std::cout << Color::BOLD << "Multi-Process Commands:" << Color::RESET << std::endl;
+        std::cout << "  multi                 - List the processes of the process set" << std::endl;
+        std::cout << "  multi add <pid...>    - Attach more processes (or: [name] --match <pattern> --tree <pid>)" << std::endl;
+        std::cout << "  multi remove <pid...|all> - Detach processes of the set" << std::endl;
+        std::cout << "  multi scan <type> <value> [comparison] - First scan of every process in the set" << std::endl;
+        std::cout << "  multi next <type> <value> [comparison] - Filter the results of every process" << std::endl;
+        std::cout << "  multi results [limit] - Show the results tagged by PID (limit per process)" << std::endl;
+        std::cout << "  multi clear           - Drop the results of the set" << std::endl;
+        
         std::cout << Color::BOLD << "Memory Commands:" << Color::RESET << std::endl;
         std::cout << "  regions               - List memory regions of current process" << std::endl;
         std::cout << "  scan <type> <value> [comparison] - First memory scan" << std::endl;
-        std::cout << "    Types: byte, short, int, long, float, double, string" << std::endl;
-        std::cout << "    Comparison: exact, greater, less (default: exact)" << std::endl;
+        std::cout << "    Types: byte, short, int, long, float, double, string, string16, any" << std::endl;
+        std::cout << "    Comparison: exact, greater, less, nocase (strings) (default: exact)" << std::endl;
+        std::cout << "    Strings: a|b|c finds several at once; string16 is UTF-16LE" << std::endl;
+        std::cout << "    any: int, long, float and double in one pass (see set anytypes)" << std::endl;
+        std::cout << "  scan <type> between <lo> <hi>       - Values in [lo, hi] (also for next)" << std::endl;
+        std::cout << "  scan <type> approx <value> <eps>    - Values within eps of value (also for next)" << std::endl;
+        std::cout << "  scan <type> unknown   - First scan for an unknown initial value" << std::endl;
+        std::cout << "  scan group <type> <value>, <type> <value> within <bytes>, ... - Values close together" << std::endl;
+        std::cout << "    e.g. scan group int 100, int 100 within 16, int 30 within 64 (default within: 64)" << std::endl;
+        std::cout << "    Options: --include <tags>, --exclude <tags> to pick regions by tag" << std::endl;
         std::cout << "  next <type> <value> [comparison] - Filter previous results" << std::endl;
-        std::cout << "    Additional comparisons: changed, unchanged" << std::endl;
+        std::cout << "    Additional comparisons: changed, unchanged, increased, decreased" << std::endl;
+        std::cout << "    (these need no value: next <type> <comparison>)" << std::endl;
+        std::cout << "  undo                  - Go back to the results before the last next scan" << std::endl;
         std::cout << "  results [limit]       - Show scan results (default limit: 20)" << std::endl;
         std::cout << "  read <addr> <type>    - Read value at address" << std::endl;
         std::cout << "  write <addr> <type> <value> - Write value to address" << std::endl;
-        std::cout << "  watch <addr> <type> [interval] - Watch for value changes (ms)" << std::endl;
+        std::cout << "  write all <value>     - Write value to every result (as the results' type)" << std::endl;
+        std::cout << "  watch <addr> <type> [interval] - Watch for value changes in the background (ms)" << std::endl;
+        std::cout << "  watches               - List active watches" << std::endl;
+        std::cout << "  unwatch <id|all>      - Stop watching" << std::endl;
+        std::cout << "  freeze <addr> <type> [value] - Keep a value in place (default: its current value)" << std::endl;
+        std::cout << "  freeze all [value]    - Freeze every result (default: its value from the last scan)" << std::endl;
+        std::cout << "  frozen                - List frozen values" << std::endl;
+        std::cout << "  unfreeze <id|all>     - Release frozen values" << std::endl;
+        std::cout << "  pointerscan <addr> [depth] [maxoffset] - Find static pointer paths to an address" << std::endl;
+        std::cout << "    (defaults: depth 4, maxoffset 0x1000)" << std::endl;
+        std::cout << "  pointers [limit]      - Show pointer paths and where they lead now" << std::endl;
+        std::cout << "  pointers validate [addr] - Keep the paths that still resolve (to addr)" << std::endl;
+        std::cout << "  aob <bytes...>        - Find a byte pattern in executable memory (?? = any byte)" << std::endl;
+        std::cout << "  patterns load <file>  - Load signatures, one \"name: 48 8B ?? ?? 89\" per line" << std::endl;
+        std::cout << "  patterns [scan]       - List the loaded signatures, or find them all in one pass" << std::endl;
+        std::cout << "  snapshot [name]       - Copy readable memory into the snapshot store (--include/--exclude tags)" << std::endl;
+        std::cout << "  snapshots             - List snapshots" << std::endl;
+        std::cout << "  snapshot diff <a> <b> [type] [limit] - Ranges that changed between two snapshots" << std::endl;
+        std::cout << "  snapshot delete <id|all> - Drop snapshots" << std::endl;
+        
+        std::cout << Color::BOLD << "Background Scans:" << Color::RESET << std::endl;
+        std::cout << "  status                - Progress, throughput and hits of the running scan" << std::endl;
+        std::cout << "  results [limit]       - While a scan runs: the first hits found so far" << std::endl;
+        std::cout << "  cancel                - Stop the running scan, keeping what it has found" << std::endl;
+        std::cout << "  wait                  - Wait for the running scan to finish" << std::endl;
+        
+        std::cout << Color::BOLD << "Diagnostics:" << Color::RESET << std::endl;
+        std::cout << "  stats [regions]       - Reads, compare time and slowest regions of the last scan" << std::endl;
+        std::cout << "  stats trace <file>    - Write the last scan as a trace for Perfetto or chrome://tracing" << std::endl;
         
         std::cout << Color::BOLD << "Data Management:" << Color::RESET << std::endl;
-        std::cout << "  save <filename>       - Save scan results to file" << std::endl;
-        std::cout << "  load <filename>       - Load scan results from file" << std::endl;
+        std::cout << "  save <filename>       - Save scan results and pointer paths as a session file" << std::endl;
+        std::cout << "  load <filename>       - Resume a saved session" << std::endl;
+        std::cout << "  export <filename>     - Export scan results as CSV" << std::endl;
+        
+        std::cout << Color::BOLD << "Settings:" << Color::RESET << std::endl;
+        std::cout << "  set                   - Show current settings" << std::endl;
+        std::cout << "  set threads <n>       - Scan worker threads (0 = one per core)" << std::endl;
+        std::cout << "  set zerocopy <on|off> - Map target pages instead of copying them" << std::endl;
+        std::cout << "  set simd <on|off>     - Use vector scan kernels (off = scalar loop)" << std::endl;
+        std::cout << "  set align <mode>      - auto (natural for type), unaligned, 2, 4 or 8" << std::endl;
+        std::cout << "  set rescan <mode>     - dirty (skip unchanged pages) or full, for unknown-value next scans" << std::endl;
+        std::cout << "  set background <on|off> - Run scan and next as background jobs (default: on at a terminal)" << std::endl;
+        std::cout << "  set pipeline <on|off> - Read memory ahead on separate threads while first scans match" << std::endl;
+        std::cout << "  set readers <n>       - Read-ahead threads (0 = half the scan threads)" << std::endl;
+        std::cout << "  set refresh <mode>    - Walk the region map before every scan (always) or on attach only (once)" << std::endl;
+        std::cout << "  set anytypes <list>   - Types an any scan looks for (default: int,long,float,double)" << std::endl;
+        std::cout << "  set freeze <ms>       - How often frozen values are checked and rewritten (default: 100)" << std::endl;
+        std::cout << "  set snapshotdir <dir|memory> - Where snapshot pages are kept (default: $TMPDIR)" << std::endl;
         
         std::cout << Color::BOLD << "Misc Commands:" << Color::RESET << std::endl;
         std::cout << "  help                  - Show this help message" << std::endl;
         std::cout << "  exit, quit            - Exit MacMemory" << std::endl;
+        std::cout << "  macmemory -b [script] - Run commands from a script or stdin, printing NDJSON" << std::endl;
         
         std::cout << "───────────────────────────────────────────────────────────────" << std::endl;
         std::cout << Color::BOLD << "System Requirements:" << Color::RESET << std::endl;
@@ -1076,195 +394,1133 @@ public:
         std::cout << "MacMemory - Contributors: Adrian Maier" << std::endl;
     }
     
+    // [name] [--match pattern] [--tree pid], as taken by ps and multi add
+    bool parseProcessFilter(const std::vector<std::string>& args, ProcessFilter& filter) {
+        for (size_t i = 0; i < args.size(); i++) {
+            if (args[i] == "--match" && i + 1 < args.size()) {
+                filter.pattern = args[++i];
+            } else if (args[i] == "--tree" && i + 1 < args.size()) {
+                try {
+                    filter.tree = std::stoi(args[++i]);
+                } catch (const std::exception& e) {
+                    std::cerr << "Error: Invalid PID format" << std::endl;
+                    return false;
+                }
+            } else if (args[i].compare(0, 2, "--") != 0 && filter.name.empty()) {
+                filter.name = args[i];
+            } else {
+                std::cerr << "Error: Unknown option '" << args[i] << "'" << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+    
     void listProcesses(const std::vector<std::string>& args) {
-        std::vector<ProcessInfo> processes = scanner.listProcesses();
+        ProcessFilter filter;
+        if (!parseProcessFilter(args, filter)) {
+            std::cerr << "Usage: ps [name] [--match pattern] [--tree pid]" << std::endl;
+            return;
+        }
+        std::vector<ProcessInfo> processes = MemoryScanner::listProcesses(filter);
         
         std::cout << Color::BOLD << "Running Processes:" << Color::RESET << std::endl;
         std::cout << "───────────────────────────────────────────────────────────────" << std::endl;
-        std::cout << Color::BOLD << std::left << std::setw(10) << "PID" << "Process Name" << Color::RESET << std::endl;
+        std::cout << Color::BOLD << std::left << std::setw(10) << "PID" << std::setw(10) << "Parent" << "Process Name" << Color::RESET << std::endl;
         std::cout << "───────────────────────────────────────────────────────────────" << std::endl;
         
-        for (const auto& proc : processes) {
-            std::cout << std::left << std::setw(10) << proc.pid << proc.name << std::endl;
+        for (const auto& proc : processes) {
+            std::cout << std::left << std::setw(10) << proc.pid << std::setw(10) << proc.parent << proc.name << std::endl;
+        }
+        
+        std::cout << "───────────────────────────────────────────────────────────────" << std::endl;
+        std::cout << processes.size() << " processes found" << std::endl;
+    }
+    
+    void attachProcess(const std::vector<std::string>& args) {
+        if (args.size() < 1) {
+            std::cerr << "Usage: attach <pid>" << std::endl;
+            return;
+        }
+        
+        try {
+            pid_t pid = std::stoi(args[0]);
+            scanner.attachProcess(pid);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: Invalid PID format" << std::endl;
+        }
+    }
+    
+    void detachProcess(const std::vector<std::string>& args) {
+        scanner.detachProcess();
+    }
+    
+    void processInfo(const std::vector<std::string>& args) {
+        scanner.getProcessInfo();
+    }
+    
+    // The process set: several attached processes scanned together, with their
+    // results tagged by PID. The attached process (attach) is not part of it.
+    void multiProcess(const std::vector<std::string>& args) {
+        if (args.empty() || args[0] == "list") {
+            processSet.list();
+            return;
+        }
+        
+        std::string action = args[0];
+        std::vector<std::string> rest(args.begin() + 1, args.end());
+        
+        if (action == "add") {
+            addProcesses(rest);
+        } else if (action == "remove") {
+            removeProcesses(rest);
+        } else if (action == "scan" || action == "next") {
+            if (processSet.empty()) {
+                std::cerr << "Error: No processes in the set. Use 'multi add <pid...>' first." << std::endl;
+                return;
+            }
+            
+            std::function<void(MemoryScanner&)> scan;
+            std::vector<std::string> positional;
+            if (action == "scan" && !parseFirstScan("multi scan", rest, scan, positional)) {
+                return;
+            }
+            if (action == "next" && !parseNextScan("multi next", rest, scan)) {
+                return;
+            }
+            if (action == "next") {
+                positional = rest;
+            }
+            if (action == "next" && processSet.resultCount() == 0) {
+                std::cerr << "Error: No previous scan results to filter" << std::endl;
+                return;
+            }
+            
+            std::string description = "multi " + action;
+            runScan(description, positional, [this, description, scan]() { processSet.scan(description, scan); });
+        } else if (action == "results") {
+            size_t limit = 20;
+            if (!rest.empty()) {
+                try {
+                    limit = std::stoi(rest[0]);
+                } catch (const std::exception& e) {
+                    std::cerr << "Error: Invalid limit value" << std::endl;
+                    return;
+                }
+            }
+            processSet.displayResults(limit);
+        } else if (action == "clear") {
+            processSet.clearResults();
+            std::cout << "Cleared the results of " << processSet.size() << " processes" << std::endl;
+        } else {
+            std::cerr << "Usage: multi [list] | add <pid...> | add [name] [--match pattern] [--tree pid]" << std::endl;
+            std::cerr << "       multi remove <pid...|all> | scan ... | next ... | results [limit] | clear" << std::endl;
+        }
+    }
+    
+    // PIDs, or the processes a filter finds (except this one)
+    void addProcesses(const std::vector<std::string>& args) {
+        std::vector<pid_t> pids;
+        bool numeric = !args.empty() && std::all_of(args.begin(), args.end(), [](const std::string& arg) {
+            return !arg.empty() && std::all_of(arg.begin(), arg.end(), ::isdigit);
+        });
+        if (numeric) {
+            for (const std::string& arg : args) {
+                pids.push_back(std::stoi(arg));
+            }
+        } else {
+            ProcessFilter filter;
+            if (args.empty() || !parseProcessFilter(args, filter)) {
+                std::cerr << "Usage: multi add <pid...> | multi add [name] [--match pattern] [--tree pid]" << std::endl;
+                return;
+            }
+            for (const ProcessInfo& info : MemoryScanner::listProcesses(filter)) {
+                if (info.pid != getpid()) {
+                    pids.push_back(info.pid);
+                }
+            }
+            if (pids.empty()) {
+                std::cerr << "No processes match" << std::endl;
+                return;
+            }
+        }
+        
+        size_t added = 0;
+        for (pid_t pid : pids) {
+            added += processSet.add(pid) ? 1 : 0;
+        }
+        std::cout << "Added " << added << " of " << pids.size() << " processes (" << processSet.size() << " in the set)" << std::endl;
+    }
+    
+    void removeProcesses(const std::vector<std::string>& args) {
+        if (args.empty()) {
+            std::cerr << "Usage: multi remove <pid...|all>" << std::endl;
+            return;
+        }
+        if (args[0] == "all") {
+            std::cout << "Removed " << processSet.removeAll() << " processes" << std::endl;
+            return;
+        }
+        for (const std::string& arg : args) {
+            try {
+                pid_t pid = std::stoi(arg);
+                if (processSet.remove(pid)) {
+                    std::cout << "Removed PID " << pid << std::endl;
+                } else {
+                    std::cerr << "PID " << pid << " is not in the set" << std::endl;
+                }
+            } catch (const std::exception& e) {
+                std::cerr << "Error: Invalid PID format" << std::endl;
+            }
+        }
+    }
+    
+    void listRegions(const std::vector<std::string>& args) {
+        scanner.displayRegions();
+    }
+    
+    bool parseValueType(const std::string& name, ValueType& type) {
+        std::string typeStr = name;
+        std::transform(typeStr.begin(), typeStr.end(), typeStr.begin(), ::tolower);
+        
+        if (typeStr == "byte") type = ValueType::BYTE;
+        else if (typeStr == "short") type = ValueType::INT16;
+        else if (typeStr == "int") type = ValueType::INT32;
+        else if (typeStr == "long") type = ValueType::INT64;
+        else if (typeStr == "float") type = ValueType::FLOAT;
+        else if (typeStr == "double") type = ValueType::DOUBLE;
+        else if (typeStr == "string") type = ValueType::STRING;
+        else if (typeStr == "string16" || typeStr == "utf16") type = ValueType::STRING16;
+        else if (typeStr == "any") type = ValueType::ANY;
+        else return false;
+        return true;
+    }
+    
+    // Addresses are hex, with or without the 0x prefix
+    bool parseAddress(const std::string& text, mach_vm_address_t& address) {
+        try {
+            size_t used = 0;
+            address = std::stoull(text, &used, 16);
+            return used == text.size();
+        } catch (const std::exception& e) {
+            return false;
+        }
+    }
+    
+    // Split --include/--exclude <tag,...> options from the other arguments
+    bool parseRegionFilter(const std::vector<std::string>& args, RegionFilter& filter, std::vector<std::string>& positional) {
+        for (size_t i = 0; i < args.size(); i++) {
+            if (args[i] != "--include" && args[i] != "--exclude") {
+                positional.push_back(args[i]);
+                continue;
+            }
+            
+            uint32_t tags = 0;
+            if (i + 1 >= args.size() || !parseRegionTags(args[i + 1], tags)) {
+                std::cerr << "Error: " << args[i] << " needs a comma-separated list of region tags" << std::endl;
+                std::cout << "Tags: " << formatRegionTags(~0u) << std::endl;
+                return false;
+            }
+            if (args[i] == "--include") {
+                filter.include |= tags;
+            } else {
+                filter.exclude |= tags;
+            }
+            i++;
+        }
+        return true;
+    }
+    
+    bool parseComparison(const std::string& name, Comparison& comparison) {
+        if (name == "exact") comparison = COMPARE_EXACT;
+        else if (name == "greater") comparison = COMPARE_GREATER;
+        else if (name == "less") comparison = COMPARE_LESS;
+        else if (name == "changed") comparison = COMPARE_CHANGED;
+        else if (name == "unchanged") comparison = COMPARE_UNCHANGED;
+        else if (name == "increased") comparison = COMPARE_INCREASED;
+        else if (name == "decreased") comparison = COMPARE_DECREASED;
+        else if (name == "nocase") comparison = COMPARE_NOCASE;
+        else return false;
+        return true;
+    }
+    
+    // "<type> between <lo> <hi>" and "<type> approx <value> <epsilon>" take two operands
+    bool parseRangeArgs(const std::vector<std::string>& args, Comparison& mode, std::string& value) {
+        if (args.size() != 4) {
+            return false;
+        }
+        std::string name = args[1];
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        if (name != "between" && name != "approx") {
+            return false;
+        }
+        mode = name == "between" ? COMPARE_BETWEEN : COMPARE_APPROX;
+        value = args[2] + " " + args[3];
+        return true;
+    }
+    
+    // "int 100, int 100 within 16, float approx 97.5 0.1 within 64 bytes": the
+    // members of a group scan, each a numeric scan term with how far it may be
+    // from the first (default GROUP_WITHIN_DEFAULT bytes)
+    bool parseGroup(const std::string& text, std::vector<GroupMember>& members) {
+        std::stringstream list(text);
+        std::string part;
+        while (std::getline(list, part, ',')) {
+            std::vector<std::string> terms = tokenize(part);
+            GroupMember member = { ValueType::UNKNOWN, COMPARE_EXACT, "", members.empty() ? 0 : GROUP_WITHIN_DEFAULT };
+            if (!terms.empty() && terms.back() == "bytes") {
+                terms.pop_back();
+            }
+            if (terms.size() >= 2 && terms[terms.size() - 2] == "within") {
+                try {
+                    member.within = std::stoul(terms.back());
+                } catch (const std::exception& e) {
+                    std::cerr << "Error: Invalid distance '" << terms.back() << "'" << std::endl;
+                    return false;
+                }
+                if (members.empty()) {
+                    std::cerr << "Error: The first value is where the others are measured from; it takes no distance" << std::endl;
+                    return false;
+                }
+                terms.resize(terms.size() - 2);
+            }
+            
+            if (terms.size() < 2 || !parseValueType(terms[0], member.type) || isStringType(member.type) || member.type == ValueType::ANY) {
+                std::cerr << "Error: Each group member is <type> <value> [comparison] with a numeric type, not '" << part << "'" << std::endl;
+                return false;
+            }
+            member.value = terms[1];
+            
+            std::string comparison = terms.size() >= 3 ? terms[2] : "exact";
+            std::transform(comparison.begin(), comparison.end(), comparison.begin(), ::tolower);
+            bool range = parseRangeArgs(terms, member.comparison, member.value);
+            if (!range && (terms.size() > 3 || !parseComparison(comparison, member.comparison) || comparisonNeedsPrevious(member.comparison) ||
+                           comparisonTakesRange(member.comparison) || member.comparison == COMPARE_NOCASE)) {
+                std::cerr << "Error: Unknown comparison type '" << comparison << "'" << std::endl;
+                return false;
+            }
+            members.push_back(member);
+        }
+        
+        if (members.size() < 2 || members.size() > GROUP_MEMBERS_MAX) {
+            std::cerr << "Error: A group scan takes 2 to " << GROUP_MEMBERS_MAX << " values, separated by commas" << std::endl;
+            return false;
+        }
+        return true;
+    }
+    
+    // The scan a scan command asks for, to run on one scanner or every process of
+    // the set. Prints the usage or the error and returns false if it makes no sense.
+    bool parseFirstScan(const std::string& command, const std::vector<std::string>& options,
+                        std::function<void(MemoryScanner&)>& scan, std::vector<std::string>& args) {
+        // --include/--exclude may appear anywhere after the command
+        RegionFilter filter;
+        if (!parseRegionFilter(options, filter, args)) {
+            return false;
+        }
+        
+        if (args.size() >= 2 && args[0] == "group") {
+            std::vector<GroupMember> members;
+            if (!parseGroup(joinArgs(args, 1), members)) {
+                return false;
+            }
+            scan = [members, filter](MemoryScanner& target) { target.firstScanGroup(members, filter); };
+            return true;
+        }
+        
+        if (args.size() < 2) {
+            std::cerr << "Usage: " << command << " <type> <value> [comparison] [--include tags] [--exclude tags]" << std::endl;
+            std::cerr << "       " << command << " <type> between <lo> <hi> | approx <value> <epsilon>" << std::endl;
+            std::cerr << "       " << command << " <type> unknown [--include tags] [--exclude tags]" << std::endl;
+            std::cerr << "       " << command << " group <type> <value>, <type> <value> within <bytes>, ..." << std::endl;
+            std::cerr << "Types: byte, short, int, long, float, double, string, string16, any" << std::endl;
+            std::cerr << "Comparison: exact, greater, less, nocase (default: exact)" << std::endl;
+            std::cerr << "Tags: " << formatRegionTags(~0u) << std::endl;
+            return false;
+        }
+        
+        ValueType type = ValueType::UNKNOWN;
+        if (!parseValueType(args[0], type)) {
+            std::cerr << "Error: Unknown value type '" << args[0] << "'" << std::endl;
+            return false;
+        }
+        
+        std::string value = args[1];
+        std::string comparison = "exact";
+        
+        Comparison rangeMode;
+        if (parseRangeArgs(args, rangeMode, value)) {
+            scan = [type, value, rangeMode, filter](MemoryScanner& target) { target.firstScan(type, value, rangeMode, filter); };
+            return true;
+        }
+        
+        // Unknown initial value: track every slot and narrow down with next
+        if (value == "unknown" && args.size() == 2) {
+            scan = [type, filter](MemoryScanner& target) { target.firstScanUnknown(type, filter); };
+            return true;
+        }
+        
+        if (args.size() >= 3) {
+            comparison = args[2];
+            std::transform(comparison.begin(), comparison.end(), comparison.begin(), ::tolower);
+        }
+        
+        Comparison mode = COMPARE_EXACT;
+        if (!parseComparison(comparison, mode) || comparisonNeedsPrevious(mode)) {
+            std::cerr << "Error: Unknown comparison type '" << comparison << "'" << std::endl;
+            return false;
+        }
+        
+        scan = [type, value, mode, filter](MemoryScanner& target) { target.firstScan(type, value, mode, filter); };
+        return true;
+    }
+    
+    void scanMemory(const std::vector<std::string>& options) {
+        std::function<void(MemoryScanner&)> scan;
+        std::vector<std::string> args;
+        if (!parseFirstScan("scan", options, scan, args)) {
+            return;
+        }
+        
+        if (!scanner.isProcessAttached()) {
+            std::cerr << "Error: Not attached to any process. Use 'attach <pid>' first." << std::endl;
+            return;
+        }
+        
+        runScan("scan", args, [this, scan]() { scan(scanner); });
+    }
+    
+    // Like parseFirstScan, for the next scan of a next command
+    bool parseNextScan(const std::string& command, const std::vector<std::string>& args, std::function<void(MemoryScanner&)>& scan) {
+        if (args.size() < 2) {
+            std::cerr << "Usage: " << command << " <type> <value> [comparison]" << std::endl;
+            std::cerr << "       " << command << " <type> between <lo> <hi> | approx <value> <epsilon>" << std::endl;
+            std::cerr << "       " << command << " <type> <changed|unchanged|increased|decreased>" << std::endl;
+            std::cerr << "Types: byte, short, int, long, float, double, string, string16, any" << std::endl;
+            std::cerr << "Comparison: exact, greater, less, nocase, changed, unchanged, increased, decreased (default: exact)" << std::endl;
+            return false;
+        }
+        
+        ValueType type = ValueType::UNKNOWN;
+        if (!parseValueType(args[0], type)) {
+            std::cerr << "Error: Unknown value type '" << args[0] << "'" << std::endl;
+            return false;
+        }
+        
+        std::string value = args[1];
+        std::string comparison = "exact";
+        
+        Comparison rangeMode;
+        if (parseRangeArgs(args, rangeMode, value)) {
+            scan = [type, value, rangeMode](MemoryScanner& target) { target.nextScan(type, value, rangeMode); };
+            return true;
+        }
+        
+        if (args.size() >= 3) {
+            comparison = args[2];
+            std::transform(comparison.begin(), comparison.end(), comparison.begin(), ::tolower);
+        } else {
+            // Comparisons against the previous value don't need a value argument
+            std::string name = value;
+            std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+            Comparison previousMode;
+            if (parseComparison(name, previousMode) && comparisonNeedsPrevious(previousMode)) {
+                comparison = name;
+                value.clear();
+            }
+        }
+        
+        Comparison mode = COMPARE_EXACT;
+        if (!parseComparison(comparison, mode)) {
+            std::cerr << "Error: Unknown comparison type '" << comparison << "'" << std::endl;
+            return false;
+        }
+        
+        scan = [type, value, mode](MemoryScanner& target) { target.nextScan(type, value, mode); };
+        return true;
+    }
+    
+    void nextScan(const std::vector<std::string>& args) {
+        std::function<void(MemoryScanner&)> scan;
+        if (!parseNextScan("next", args, scan)) {
+            return;
+        }
+        
+        if (!scanner.isProcessAttached()) {
+            std::cerr << "Error: Not attached to any process" << std::endl;
+            return;
+        }
+        
+        if (scanner.getResultCount() == 0) {
+            std::cerr << "Error: No previous scan results to filter" << std::endl;
+            return;
+        }
+        
+        runScan("next", args, [this, scan]() { scan(scanner); });
+    }
+    
+    void undoScan(const std::vector<std::string>& args) {
+        if (!scanner.isProcessAttached()) {
+            std::cerr << "Error: Not attached to any process" << std::endl;
+            return;
+        }
+        
+        scanner.undoScan();
+    }
+    
+    void showResults(const std::vector<std::string>& args) {
+        size_t limit = 20;
+        if (args.size() >= 1) {
+            try {
+                limit = std::stoi(args[0]);
+            } catch (const std::exception& e) {
+                std::cerr << "Error: Invalid limit value" << std::endl;
+                return;
+            }
+        }
+        
+        scanner.displayResults(limit);
+    }
+    
+    void showStats(const std::vector<std::string>& args) {
+        if (!args.empty() && args[0] == "trace") {
+            if (args.size() < 2) {
+                std::cerr << "Usage: stats trace <filename>" << std::endl;
+                return;
+            }
+            scanner.writeTrace(args[1]);
+            return;
+        }
+        
+        size_t limit = 10;
+        if (args.size() >= 1) {
+            try {
+                limit = std::stoi(args[0]);
+            } catch (const std::exception& e) {
+                std::cerr << "Error: Invalid region count" << std::endl;
+                return;
+            }
+        }
+        
+        scanner.displayStats(limit);
+    }
+    
+    // Values may contain spaces (strings): everything from args[first] on, joined
+    static std::string joinArgs(const std::vector<std::string>& args, size_t first) {
+        std::string text;
+        for (size_t i = first; i < args.size(); i++) {
+            text += (i > first ? " " : "") + args[i];
+        }
+        return text;
+    }
+    
+    void readMemory(const std::vector<std::string>& args) {
+        if (args.size() < 2) {
+            std::cerr << "Usage: read <addr> <type>" << std::endl;
+            return;
+        }
+        
+        mach_vm_address_t address = 0;
+        if (!parseAddress(args[0], address)) {
+            std::cerr << "Error: Invalid address '" << args[0] << "'" << std::endl;
+            return;
+        }
+        
+        ValueType type = ValueType::UNKNOWN;
+        if (!parseValueType(args[1], type)) {
+            std::cerr << "Error: Unknown value type '" << args[1] << "'" << std::endl;
+            return;
         }
         
-        std::cout << "───────────────────────────────────────────────────────────────" << std::endl;
-        std::cout << processes.size() << " processes found" << std::endl;
+        scanner.readValue(address, type);
     }
     
-    void attachProcess(const std::vector<std::string>& args) {
-        if (args.size() < 1) {
-            std::cout << "Usage: attach <pid>" << std::endl;
+    void writeMemory(const std::vector<std::string>& args) {
+        if (args.size() >= 2 && args[0] == "all") {
+            try {
+                scanner.writeAll(joinArgs(args, 1));
+            } catch (const std::exception& e) {
+                std::cerr << "Error: Invalid value format" << std::endl;
+            }
+            return;
+        }
+        if (args.size() < 3) {
+            std::cerr << "Usage: write <addr> <type> <value>, or write all <value>" << std::endl;
+            return;
+        }
+        
+        mach_vm_address_t address = 0;
+        if (!parseAddress(args[0], address)) {
+            std::cerr << "Error: Invalid address '" << args[0] << "'" << std::endl;
+            return;
+        }
+        
+        ValueType type = ValueType::UNKNOWN;
+        if (!parseValueType(args[1], type)) {
+            std::cerr << "Error: Unknown value type '" << args[1] << "'" << std::endl;
             return;
         }
         
         try {
-            pid_t pid = std::stoi(args[0]);
-            scanner.attachProcess(pid);
+            scanner.writeValue(address, type, joinArgs(args, 2));
         } catch (const std::exception& e) {
-            std::cout << "Error: Invalid PID format" << std::endl;
+            std::cerr << "Error: Invalid value format" << std::endl;
         }
     }
     
-    void detachProcess(const std::vector<std::string>& args) {
-        scanner.detachProcess();
-    }
-    
-    void processInfo(const std::vector<std::string>& args) {
-        scanner.getProcessInfo();
-    }
-    
-    void listRegions(const std::vector<std::string>& args) {
-        // Implementation to list memory regions
-    }
-    
-    void scanMemory(const std::vector<std::string>& args) {
+    void freezeMemory(const std::vector<std::string>& args) {
+        if (!args.empty() && args[0] == "all") {
+            try {
+                scanner.freezeResults(joinArgs(args, 1));
+            } catch (const std::exception& e) {
+                std::cerr << "Error: Invalid value format" << std::endl;
+            }
+            return;
+        }
         if (args.size() < 2) {
-            std::cout << "Usage: scan <type> <value> [comparison]" << std::endl;
-            std::cout << "Types: byte, short, int, long, float, double, string" << std::endl;
-            std::cout << "Comparison: exact, greater, less (default: exact)" << std::endl;
+            std::cerr << "Usage: freeze <addr> <type> [value], or freeze all [value]" << std::endl;
+            std::cerr << "Without a value the current one is kept" << std::endl;
             return;
         }
         
-        if (!scanner.isProcessAttached()) {
-            std::cout << "Error: Not attached to any process. Use 'attach <pid>' first." << std::endl;
+        mach_vm_address_t address = 0;
+        if (!parseAddress(args[0], address)) {
+            std::cerr << "Error: Invalid address '" << args[0] << "'" << std::endl;
             return;
         }
         
         ValueType type = ValueType::UNKNOWN;
-        std::string typeStr = args[0];
-        std::transform(typeStr.begin(), typeStr.end(), typeStr.begin(), ::tolower);
+        if (!parseValueType(args[1], type)) {
+            std::cerr << "Error: Unknown value type '" << args[1] << "'" << std::endl;
+            return;
+        }
         
-        if (typeStr == "byte") type = ValueType::BYTE;
-        else if (typeStr == "short") type = ValueType::INT16;
-        else if (typeStr == "int") type = ValueType::INT32;
-        else if (typeStr == "long") type = ValueType::INT64;
-        else if (typeStr == "float") type = ValueType::FLOAT;
-        else if (typeStr == "double") type = ValueType::DOUBLE;
-        else if (typeStr == "string") type = ValueType::STRING;
+        try {
+            scanner.freezeValue(address, type, joinArgs(args, 2));
+        } catch (const std::exception& e) {
+            std::cerr << "Error: Invalid value format" << std::endl;
+        }
+    }
+    
+    // snapshot [name], snapshot diff <a> <b> [type] [limit], snapshot delete <id|all>
+    void snapshot(const std::vector<std::string>& options) {
+        RegionFilter filter;
+        std::vector<std::string> args;
+        if (!parseRegionFilter(options, filter, args)) {
+            return;
+        }
+        
+        if (!args.empty() && args[0] == "diff") {
+            if (args.size() < 3) {
+                std::cerr << "Usage: snapshot diff <id> <id> [type] [limit] (default: byte, 20)" << std::endl;
+                return;
+            }
+            uint32_t first = 0;
+            uint32_t second = 0;
+            ValueType type = ValueType::BYTE;
+            size_t limit = 20;
+            try {
+                first = static_cast<uint32_t>(std::stoul(args[1]));
+                second = static_cast<uint32_t>(std::stoul(args[2]));
+                if (args.size() >= 4 && !parseValueType(args[3], type)) {
+                    std::cerr << "Error: Unknown value type '" << args[3] << "'" << std::endl;
+                    return;
+                }
+                if (args.size() >= 5) {
+                    limit = static_cast<size_t>(std::stoul(args[4]));
+                }
+            } catch (const std::exception& e) {
+                std::cerr << "Error: Invalid snapshot id or limit" << std::endl;
+                return;
+            }
+            runScan("snapshot", args, [this, first, second, type, limit]() { scanner.diffSnapshots(first, second, type, limit); });
+            return;
+        }
         
-        if (type == ValueType::UNKNOWN) {
-            std::cout << "Error: Unknown value type '" << typeStr << "'" << std::endl;
+        if (!args.empty() && args[0] == "delete") {
+            if (args.size() < 2) {
+                std::cerr << "Usage: snapshot delete <id|all>" << std::endl;
+                return;
+            }
+            if (args[1] == "all") {
+                std::cout << "Deleted " << scanner.deleteAllSnapshots() << " snapshots" << std::endl;
+                return;
+            }
+            uint32_t id = 0;
+            try {
+                id = static_cast<uint32_t>(std::stoul(args[1]));
+            } catch (const std::exception& e) {
+                std::cerr << "Error: Invalid snapshot id" << std::endl;
+                return;
+            }
+            if (scanner.deleteSnapshot(id)) {
+                std::cout << "Deleted snapshot #" << id << std::endl;
+            } else {
+                std::cerr << "No snapshot with id " << id << std::endl;
+            }
             return;
         }
         
-        std::string value = args[1];
-        std::string comparison = "exact";
+        if (!scanner.isProcessAttached()) {
+            std::cerr << "Error: Not attached to any process. Use 'attach <pid>' first." << std::endl;
+            return;
+        }
+        std::string name = args.empty() ? "" : args[0];
+        runScan("snapshot", args, [this, name, filter]() { scanner.takeSnapshot(name, filter); });
+    }
+    
+    void unfreeze(const std::vector<std::string>& args) {
+        if (args.empty()) {
+            std::cerr << "Usage: unfreeze <id|all>" << std::endl;
+            return;
+        }
         
-        if (args.size() >= 3) {
-            comparison = args[2];
-            std::transform(comparison.begin(), comparison.end(), comparison.begin(), ::tolower);
+        if (args[0] == "all") {
+            std::cout << "Released " << scanner.removeAllFreezes() << " frozen values" << std::endl;
+            return;
         }
         
-        if (comparison != "exact" && comparison != "greater" && comparison != "less") {
-            std::cout << "Error: Unknown comparison type '" << comparison << "'" << std::endl;
+        uint32_t id = 0;
+        try {
+            id = static_cast<uint32_t>(std::stoul(args[0]));
+        } catch (const std::exception& e) {
+            std::cerr << "Error: Invalid freeze id" << std::endl;
             return;
         }
         
-        scanner.firstScan(type, value, comparison);
+        if (scanner.removeFreeze(id)) {
+            std::cout << "Released freeze #" << id << std::endl;
+        } else {
+            std::cerr << "No freeze with id " << id << std::endl;
+        }
     }
     
-    void nextScan(const std::vector<std::string>& args) {
+    void watchMemory(const std::vector<std::string>& args) {
         if (args.size() < 2) {
-            std::cout << "Usage: next <type> <value> [comparison]" << std::endl;
-            std::cout << "Types: byte, short, int, long, float, double, string" << std::endl;
-            std::cout << "Comparison: exact, greater, less, changed, unchanged (default: exact)" << std::endl;
+            std::cerr << "Usage: watch <addr> <type> [interval]" << std::endl;
+            std::cerr << "Interval is in milliseconds and may be fractional (default: 1000)" << std::endl;
             return;
         }
         
         if (!scanner.isProcessAttached()) {
-            std::cout << "Error: Not attached to any process" << std::endl;
+            std::cerr << "Error: Not attached to any process" << std::endl;
             return;
         }
         
-        if (scanner.getResultCount() == 0) {
-            std::cout << "Error: No previous scan results to filter" << std::endl;
+        mach_vm_address_t address = 0;
+        if (!parseAddress(args[0], address)) {
+            std::cerr << "Error: Invalid address '" << args[0] << "'" << std::endl;
             return;
         }
         
         ValueType type = ValueType::UNKNOWN;
-        std::string typeStr = args[0];
-        std::transform(typeStr.begin(), typeStr.end(), typeStr.begin(), ::tolower);
+        if (!parseValueType(args[1], type)) {
+            std::cerr << "Error: Unknown value type '" << args[1] << "'" << std::endl;
+            return;
+        }
         
-        if (typeStr == "byte") type = ValueType::BYTE;
-        else if (typeStr == "short") type = ValueType::INT16;
-        else if (typeStr == "int") type = ValueType::INT32;
-        else if (typeStr == "long") type = ValueType::INT64;
-        else if (typeStr == "float") type = ValueType::FLOAT;
-        else if (typeStr == "double") type = ValueType::DOUBLE;
-        else if (typeStr == "string") type = ValueType::STRING;
+        double interval = 1000;
+        if (args.size() >= 3) {
+            try {
+                interval = std::stod(args[2]);
+            } catch (const std::exception& e) {
+                interval = 0;
+            }
+            if (!(interval >= 0.01)) {
+                std::cerr << "Error: Interval must be at least 0.01 ms" << std::endl;
+                return;
+            }
+        }
         
-        if (type == ValueType::UNKNOWN) {
-            std::cout << "Error: Unknown value type '" << typeStr << "'" << std::endl;
+        scanner.addWatch(address, type, interval);
+    }
+    
+    void listWatches(const std::vector<std::string>& args) {
+        scanner.listWatches();
+    }
+    
+    void unwatch(const std::vector<std::string>& args) {
+        if (args.empty()) {
+            std::cerr << "Usage: unwatch <id|all>" << std::endl;
             return;
         }
         
-        std::string value = args[1];
-        std::string comparison = "exact";
+        if (args[0] == "all") {
+            std::cout << "Removed " << scanner.removeAllWatches() << " watches" << std::endl;
+            return;
+        }
         
-        if (args.size() >= 3) {
-            comparison = args[2];
-            std::transform(comparison.begin(), comparison.end(), comparison.begin(), ::tolower);
+        uint32_t id = 0;
+        try {
+            id = static_cast<uint32_t>(std::stoul(args[0]));
+        } catch (const std::exception& e) {
+            std::cerr << "Error: Invalid watch id" << std::endl;
+            return;
+        }
+        
+        if (scanner.removeWatch(id)) {
+            std::cout << "Removed watch #" << id << std::endl;
+        } else {
+            std::cerr << "No watch with id " << id << std::endl;
+        }
+    }
+    
+    void pointerScan(const std::vector<std::string>& args) {
+        if (args.size() < 1) {
+            std::cerr << "Usage: pointerscan <address> [depth] [maxoffset]" << std::endl;
+            return;
+        }
+        
+        mach_vm_address_t address = 0;
+        if (!parseAddress(args[0], address)) {
+            std::cerr << "Error: Invalid address format" << std::endl;
+            return;
         }
         
-        if (comparison != "exact" && comparison != "greater" && comparison != "less" && 
-            comparison != "changed" && comparison != "unchanged") {
-            std::cout << "Error: Unknown comparison type '" << comparison << "'" << std::endl;
+        size_t depth = 4;
+        uint64_t maxOffset = 0x1000;
+        try {
+            if (args.size() >= 2) {
+                depth = static_cast<size_t>(std::stoul(args[1]));
+            }
+            if (args.size() >= 3) {
+                maxOffset = std::stoull(args[2], nullptr, 0);
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Usage: pointerscan <address> [depth] [maxoffset]" << std::endl;
+            return;
+        }
+        if (depth == 0 || depth > POINTER_MAX_DEPTH) {
+            std::cerr << "Error: Depth must be between 1 and " << POINTER_MAX_DEPTH << std::endl;
             return;
         }
         
-        scanner.nextScan(type, value, comparison);
+        scanner.pointerScan(address, depth, maxOffset);
     }
     
-    void showResults(const std::vector<std::string>& args) {
+    void showPointers(const std::vector<std::string>& args) {
+        if (!args.empty() && args[0] == "validate") {
+            mach_vm_address_t address = 0;
+            if (args.size() >= 2 && !parseAddress(args[1], address)) {
+                std::cerr << "Error: Invalid address format" << std::endl;
+                return;
+            }
+            scanner.validatePointers(args.size() >= 2, address);
+            return;
+        }
+        
         size_t limit = 20;
         if (args.size() >= 1) {
             try {
                 limit = std::stoi(args[0]);
             } catch (const std::exception& e) {
-                std::cout << "Error: Invalid limit value" << std::endl;
+                std::cerr << "Error: Invalid limit value" << std::endl;
                 return;
             }
         }
         
-        scanner.displayResults(limit);
-    }
-    
-    void readMemory(const std::vector<std::string>& args) {
-        // Implementation to read memory at address
+        scanner.displayPointers(limit);
     }
     
-    void writeMemory(const std::vector<std::string>& args) {
-        // Implementation to write memory at address
+    void aobScan(const std::vector<std::string>& options) {
+        RegionFilter filter;
+        std::vector<std::string> args;
+        if (!parseRegionFilter(options, filter, args)) {
+            return;
+        }
+        
+        std::string text;
+        for (const std::string& arg : args) {
+            text += arg + " ";
+        }
+        BytePattern pattern;
+        if (args.empty() || !parseBytePattern(text, pattern)) {
+            std::cerr << "Usage: aob <bytes...> [--include tags] [--exclude tags]   e.g. aob 48 8B ?? ?? 89" << std::endl;
+            return;
+        }
+        pattern.name = formatBytePattern(pattern);
+        
+        PatternMatcher matcher;
+        matcher.compile(std::vector<BytePattern>(1, pattern));
+        scanner.scanPatterns(matcher, filter);
     }
     
-    void watchMemory(const std::vector<std::string>& args) {
-        // Implementation to watch memory at address
+    void patterns(const std::vector<std::string>& options) {
+        RegionFilter filter;
+        std::vector<std::string> args;
+        if (!parseRegionFilter(options, filter, args)) {
+            return;
+        }
+        
+        if (args.empty()) {
+            scanner.listPatterns();
+        } else if (args[0] == "load" && args.size() == 2) {
+            scanner.loadPatterns(args[1]);
+        } else if (args[0] == "scan" && args.size() == 1) {
+            scanner.scanPatterns(filter);
+        } else {
+            std::cerr << "Usage: patterns [load <file> | scan [--include tags] [--exclude tags]]" << std::endl;
+        }
     }
     
     void saveResults(const std::vector<std::string>& args) {
         if (args.size() < 1) {
-            std::cout << "Usage: save <filename>" << std::endl;
+            std::cerr << "Usage: save <filename>" << std::endl;
             return;
         }
         
         scanner.saveResults(args[0]);
     }
     
+    void exportResults(const std::vector<std::string>& args) {
+        if (args.size() < 1) {
+            std::cerr << "Usage: export <filename>" << std::endl;
+            return;
+        }
+        
+        scanner.exportResults(args[0]);
+    }
+    
     void loadResults(const std::vector<std::string>& args) {
         if (args.size() < 1) {
-            std::cout << "Usage: load <filename>" << std::endl;
+            std::cerr << "Usage: load <filename>" << std::endl;
             return;
         }
         
         scanner.loadResults(args[0]);
     }
+    
+    std::string alignmentName(size_t alignment) {
+        if (alignment == 0) {
+            return "auto (natural for type)";
+        }
+        if (alignment == 1) {
+            return "unaligned";
+        }
+        return std::to_string(alignment) + " bytes";
+    }
+    
+    std::string anyTypesName(const std::vector<ValueType>& types) {
+        std::string name;
+        for (ValueType type : types) {
+            name += (name.empty() ? "" : ",") + std::string(valueTypeKeyword(type));
+        }
+        return name;
+    }
+    
+    void setOption(const std::vector<std::string>& args) {
+        if (args.empty()) {
+            std::cout << "Settings:" << std::endl;
+            std::cout << "  threads    " << scanner.getThreadCount() << std::endl;
+            std::cout << "  zerocopy   " << (scanner.getZeroCopy() ? "on" : "off") << std::endl;
+            std::cout << "  simd       " << (scanner.getSimd() ? simdLevelName(simdLevel()) : "off") << std::endl;
+            std::cout << "  align      " << alignmentName(scanner.getAlignment()) << std::endl;
+            std::cout << "  rescan     " << (scanner.getRescanMode() == RESCAN_DIRTY ? "dirty" : "full") << std::endl;
+            std::cout << "  pipeline   " << (scanner.getPipelined() ? "on" : "off") << std::endl;
+            std::cout << "  readers    " << scanner.getReaderThreads() << std::endl;
+            std::cout << "  background " << (backgroundScans ? "on" : "off") << std::endl;
+            std::cout << "  refresh    " << (scanner.getRegionRefresh() ? "always" : "once") << std::endl;
+            std::cout << "  anytypes   " << anyTypesName(scanner.getAnyTypes()) << std::endl;
+            std::cout << "  freeze     " << scanner.getFreezeInterval() << " ms" << std::endl;
+            std::cout << "  snapshotdir " << (scanner.getSnapshotDirectory().empty() ? "memory" : scanner.getSnapshotDirectory()) << std::endl;
+            return;
+        }
+        
+        if (args.size() < 2) {
+            std::cerr << "Usage: set <option> <value>" << std::endl;
+            return;
+        }
+        
+        std::string option = args[0];
+        std::transform(option.begin(), option.end(), option.begin(), ::tolower);
+        
+        if (option == "threads") {
+            try {
+                int threads = std::stoi(args[1]);
+                if (threads < 0) {
+                    throw std::invalid_argument("negative thread count");
+                }
+                scanner.setThreadCount(static_cast<size_t>(threads));
+                std::cout << "Scanning with " << scanner.getThreadCount() << " threads" << std::endl;
+            } catch (const std::exception& e) {
+                std::cerr << "Error: Invalid thread count" << std::endl;
+            }
+        } else if (option == "zerocopy") {
+            if (args[1] == "on") {
+                scanner.setZeroCopy(true);
+            } else if (args[1] == "off") {
+                scanner.setZeroCopy(false);
+            } else {
+                std::cerr << "Usage: set zerocopy <on|off>" << std::endl;
+                return;
+            }
+            std::cout << "Zero-copy scanning " << (scanner.getZeroCopy() ? "enabled" : "disabled") << std::endl;
+        } else if (option == "simd") {
+            if (args[1] == "on") {
+                scanner.setSimd(true);
+            } else if (args[1] == "off") {
+                scanner.setSimd(false);
+            } else {
+                std::cerr << "Usage: set simd <on|off>" << std::endl;
+                return;
+            }
+            std::cout << "Scan kernels: " << (scanner.getSimd() ? simdLevelName(simdLevel()) : "scalar") << std::endl;
+        } else if (option == "align") {
+            std::string mode = args[1];
+            std::transform(mode.begin(), mode.end(), mode.begin(), ::tolower);
+            if (mode == "auto" || mode == "natural") {
+                scanner.setAlignment(0);
+            } else if (mode == "unaligned" || mode == "1") {
+                scanner.setAlignment(1);
+            } else if (mode == "2" || mode == "4" || mode == "8") {
+                scanner.setAlignment(static_cast<size_t>(std::stoi(mode)));
+            } else {
+                std::cerr << "Usage: set align <auto|unaligned|1|2|4|8>" << std::endl;
+                return;
+            }
+            std::cout << "Scan alignment: " << alignmentName(scanner.getAlignment()) << std::endl;
+        } else if (option == "rescan") {
+            if (args[1] == "dirty") {
+                scanner.setRescanMode(RESCAN_DIRTY);
+            } else if (args[1] == "full") {
+                scanner.setRescanMode(RESCAN_FULL);
+            } else {
+                std::cerr << "Usage: set rescan <dirty|full>" << std::endl;
+                return;
+            }
+            std::cout << "Unknown-value rescans " << (scanner.getRescanMode() == RESCAN_DIRTY ? "skip unchanged pages" : "compare every candidate") << std::endl;
+        } else if (option == "background") {
+            if (args[1] == "on") {
+                backgroundScans = true;
+            } else if (args[1] == "off") {
+                backgroundScans = false;
+            } else {
+                std::cerr << "Usage: set background <on|off>" << std::endl;
+                return;
+            }
+            std::cout << "Scans run " << (backgroundScans ? "in the background" : "in the foreground") << std::endl;
+        } else if (option == "pipeline") {
+            if (args[1] == "on") {
+                scanner.setPipelined(true);
+            } else if (args[1] == "off") {
+                scanner.setPipelined(false);
+            } else {
+                std::cerr << "Usage: set pipeline <on|off>" << std::endl;
+                return;
+            }
+            std::cout << "First scans " << (scanner.getPipelined() ? "read ahead while matching" : "read and match in turn") << std::endl;
+        } else if (option == "refresh") {
+            if (args[1] == "always") {
+                scanner.setRegionRefresh(true);
+            } else if (args[1] == "once") {
+                scanner.setRegionRefresh(false);
+            } else {
+                std::cerr << "Usage: set refresh <always|once>" << std::endl;
+                return;
+            }
+            std::cout << "The region map is walked " << (scanner.getRegionRefresh() ? "before every scan" : "on attach and by regions") << std::endl;
+        } else if (option == "readers") {
+            try {
+                int readers = std::stoi(args[1]);
+                if (readers < 0) {
+                    throw std::invalid_argument("negative reader count");
+                }
+                scanner.setReaderThreads(static_cast<size_t>(readers));
+                std::cout << "Reading ahead with " << scanner.getReaderThreads() << " threads" << std::endl;
+            } catch (const std::exception& e) {
+                std::cerr << "Error: Invalid reader count" << std::endl;
+            }
+        } else if (option == "anytypes") {
+            std::vector<ValueType> types;
+            std::stringstream list(args[1]);
+            std::string name;
+            while (std::getline(list, name, ',')) {
+                ValueType type = ValueType::UNKNOWN;
+                if (!parseValueType(name, type) || valueTypeSize(type) == 0 ||
+                    std::find(types.begin(), types.end(), type) != types.end()) {
+                    types.clear();
+                    break;
+                }
+                types.push_back(type);
+            }
+            if (types.empty()) {
+                std::cerr << "Usage: set anytypes <type,...> (byte, short, int, long, float, double)" << std::endl;
+                return;
+            }
+            scanner.setAnyTypes(types);
+            std::cout << "Any scans look for " << anyTypesName(types) << std::endl;
+        } else if (option == "freeze") {
+            double interval = 0;
+            try {
+                interval = std::stod(args[1]);
+            } catch (const std::exception& e) {
+                interval = 0;
+            }
+            if (!(interval >= 1)) {
+                std::cerr << "Error: The freeze interval must be at least 1 ms" << std::endl;
+                return;
+            }
+            scanner.setFreezeInterval(interval);
+            std::cout << "Frozen values are checked every " << scanner.getFreezeInterval() << " ms" << std::endl;
+        } else if (option == "snapshotdir") {
+            scanner.setSnapshotDirectory(args[1] == "memory" ? "" : args[1]);
+            std::cout << "New snapshot stores keep their pages " << (args[1] == "memory" ? "in memory" : "in " + args[1]) << std::endl;
+        } else {
+            std::cerr << "Error: Unknown option '" << option << "'" << std::endl;
+        }
+    }
 };
 
 int main(int argc, char* argv[]) {
     // Initialize the value type names
     initValueTypeNames();
     
+    // Command-line options; settings are applied once the mode is known
+    std::vector<std::vector<std::string>> settings;
+    bool batch = false;
+    std::string script;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) {
+            settings.push_back({"threads", argv[++i]});
+        } else if (arg == "--align" && i + 1 < argc) {
+            settings.push_back({"align", argv[++i]});
+        } else if (arg == "-b" || arg == "--batch") {
+            batch = true;
+            if (i + 1 < argc && (argv[i + 1][0] != '-' || std::string(argv[i + 1]) == "-")) {
+                script = argv[++i];
+            }
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--threads N] [--align 1|2|4|8] [-b|--batch [script|-]]" << std::endl;
+            return 1;
+        }
+    }
+    
+    CLI cli;
+    
+    // Batch mode: commands from the script (or stdin), NDJSON on stdout
+    if (batch) {
+        if (geteuid() != 0) {
+            std::cerr << "Warning: MacMemory requires root permissions to access process memory." << std::endl;
+        }
+        std::ifstream file;
+        if (!script.empty() && script != "-") {
+            file.open(script);
+            if (!file) {
+                std::cerr << "Failed to open script: " << script << std::endl;
+                return 1;
+            }
+        }
+        
+        cli.startBatch();
+        bool succeeded = true;
+        for (const auto& setting : settings) {
+            succeeded = cli.runBatchCommand("set " + setting[0] + " " + setting[1], 0) && succeeded;
+        }
+        succeeded = cli.runBatch(file.is_open() ? static_cast<std::istream&>(file) : std::cin) && succeeded;
+        return succeeded ? 0 : 1;
+    }
+    
     // Check for root permissions
     if (geteuid() != 0) {
         std::cout << Color::YELLOW << "Warning: MacMemory requires root permissions to access process memory." << Color::RESET << std::endl;
@@ -1277,8 +1533,11 @@ int main(int argc, char* argv[]) {
     std::cout << "         See README for instructions on disabling SIP." << std::endl;
     std::cout << std::endl;
     
-    CLI cli;
+    for (const auto& setting : settings) {
+        cli.setOption(setting);
+    }
+    
     cli.run();
     
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,7719 @@
+// MacMemory - scan engine
+// Process attachment, region maps, scan kernels and MemoryScanner. The CLI
+// (macmemory.cpp) and libmacmemory (libmacmemory.cpp) are built on top of it.
+
+#ifndef MACMEMORY_SCANNER_H
+#define MACMEMORY_SCANNER_H
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <map>
+#include <iomanip>
+#include <sstream>
+#include <fstream>
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <cstddef>
+#include <climits>
+#include <cerrno>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <type_traits>
+#include <unistd.h> // For usleep()
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <fnmatch.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+// macOS specific includes
+#include <mach/mach.h>
+#include <mach/mach_vm.h>
+#include <mach/vm_region.h>
+#include <mach/vm_map.h>
+#include <mach/shared_region.h>
+#include <mach-o/loader.h>
+#include <mach-o/dyld_images.h>
+#include <libproc.h>
+#include <sys/sysctl.h>
+
+// ANSI color codes for terminal output; disable() blanks them for batch output
+namespace Color {
+    inline std::string RESET = "\033[0m";
+    inline std::string RED = "\033[31m";
+    inline std::string GREEN = "\033[32m";
+    inline std::string YELLOW = "\033[33m";
+    inline std::string BLUE = "\033[34m";
+    inline std::string MAGENTA = "\033[35m";
+    inline std::string CYAN = "\033[36m";
+    inline std::string WHITE = "\033[37m";
+    inline std::string BOLD = "\033[1m";
+    inline std::string CLEAR_LINE = "\033[K";
+    
+    inline void disable() {
+        for (std::string* code : { &RESET, &RED, &GREEN, &YELLOW, &BLUE, &MAGENTA, &CYAN, &WHITE, &BOLD, &CLEAR_LINE }) {
+            code->clear();
+        }
+    }
+}
+
+// Enum for value types (using regular enum for compatibility)
+enum ValueType {
+    BYTE,
+    INT16,
+    INT32,
+    INT64,
+    FLOAT,
+    DOUBLE,
+    STRING,
+    STRING16,
+    ANY,
+    UNKNOWN
+};
+
+// String representation of value types
+inline std::map<ValueType, std::string> valueTypeNames;
+
+// Initialize the map in a function
+inline void initValueTypeNames() {
+    valueTypeNames[BYTE] = "Byte (1 byte)";
+    valueTypeNames[INT16] = "Short (2 bytes)";
+    valueTypeNames[INT32] = "Int (4 bytes)";
+    valueTypeNames[INT64] = "Long (8 bytes)";
+    valueTypeNames[FLOAT] = "Float (4 bytes)";
+    valueTypeNames[DOUBLE] = "Double (8 bytes)";
+    valueTypeNames[STRING] = "String";
+    valueTypeNames[STRING16] = "UTF-16 String";
+    valueTypeNames[ANY] = "Any numeric";
+    valueTypeNames[UNKNOWN] = "Unknown";
+}
+
+inline bool isStringType(ValueType type) {
+    return type == STRING || type == STRING16;
+}
+
+// The name a type goes by on the command line
+inline const char* valueTypeKeyword(ValueType type) {
+    static const char* const keywords[] = { "byte", "short", "int", "long", "float", "double", "string", "string16", "any", "unknown" };
+    return keywords[type];
+}
+
+// text as a quoted JSON string
+inline std::string jsonQuote(const std::string& text) {
+    std::string quoted = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+            quoted += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escape[8];
+            snprintf(escape, sizeof(escape), "\\u%04x", c);
+            quoted += escape;
+        } else {
+            quoted += c;
+        }
+    }
+    return quoted + "\"";
+}
+
+// Width of a fixed-size value type (0 for strings, any and unknown)
+inline size_t valueTypeSize(ValueType type) {
+    switch (type) {
+        case ValueType::BYTE: return 1;
+        case ValueType::INT16: return 2;
+        case ValueType::INT32: return 4;
+        case ValueType::INT64: return 8;
+        case ValueType::FLOAT: return 4;
+        case ValueType::DOUBLE: return 8;
+        default: return 0;
+    }
+}
+
+inline bool isIntegerType(ValueType type) {
+    return type == ValueType::BYTE || type == ValueType::INT16 || type == ValueType::INT32 || type == ValueType::INT64;
+}
+
+// UTF-8 text as UTF-16LE bytes (invalid sequences become U+FFFD)
+inline std::vector<uint8_t> utf8ToUtf16(const std::string& text) {
+    std::vector<uint8_t> encoded;
+    auto put = [&encoded](uint32_t unit) {
+        encoded.push_back(static_cast<uint8_t>(unit & 0xFF));
+        encoded.push_back(static_cast<uint8_t>(unit >> 8));
+    };
+    for (size_t i = 0; i < text.size(); ) {
+        uint8_t lead = static_cast<uint8_t>(text[i]);
+        size_t length = lead < 0x80 ? 1 : (lead >> 5) == 0x6 ? 2 : (lead >> 4) == 0xE ? 3 : (lead >> 3) == 0x1E ? 4 : 0;
+        uint32_t codePoint = length == 1 ? lead : length == 2 ? (lead & 0x1F) : length == 3 ? (lead & 0x0F) : (lead & 0x07);
+        bool valid = length > 0 && i + length <= text.size();
+        for (size_t k = 1; valid && k < length; k++) {
+            uint8_t next = static_cast<uint8_t>(text[i + k]);
+            valid = (next & 0xC0) == 0x80;
+            codePoint = (codePoint << 6) | (next & 0x3F);
+        }
+        if (!valid) {
+            put(0xFFFD);
+            i++;
+            continue;
+        }
+        if (codePoint >= 0x10000) {
+            codePoint -= 0x10000;
+            put(0xD800 | (codePoint >> 10));
+            put(0xDC00 | (codePoint & 0x3FF));
+        } else {
+            put(codePoint);
+        }
+        i += length;
+    }
+    return encoded;
+}
+
+// UTF-16LE bytes as UTF-8 text
+inline std::string utf16ToUtf8(const uint8_t* data, size_t size) {
+    std::string text;
+    for (size_t i = 0; i + 1 < size; i += 2) {
+        uint32_t codePoint = data[i] | (data[i + 1] << 8);
+        if (codePoint >= 0xD800 && codePoint < 0xDC00 && i + 3 < size) {
+            uint32_t low = data[i + 2] | (data[i + 3] << 8);
+            if (low >= 0xDC00 && low < 0xE000) {
+                codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+                i += 2;
+            }
+        }
+        if (codePoint < 0x80) {
+            text += static_cast<char>(codePoint);
+        } else if (codePoint < 0x800) {
+            text += static_cast<char>(0xC0 | (codePoint >> 6));
+            text += static_cast<char>(0x80 | (codePoint & 0x3F));
+        } else if (codePoint < 0x10000) {
+            text += static_cast<char>(0xE0 | (codePoint >> 12));
+            text += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+            text += static_cast<char>(0x80 | (codePoint & 0x3F));
+        } else {
+            text += static_cast<char>(0xF0 | (codePoint >> 18));
+            text += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+            text += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+            text += static_cast<char>(0x80 | (codePoint & 0x3F));
+        }
+    }
+    return text;
+}
+
+// Region tags (bit flags), derived from the VM user tag, share mode and the
+// loaded images of the target
+enum RegionTag {
+    TAG_MALLOC = 1 << 0,
+    TAG_MALLOC_TINY = 1 << 1,
+    TAG_MALLOC_SMALL = 1 << 2,
+    TAG_MALLOC_LARGE = 1 << 3,
+    TAG_STACK = 1 << 4,
+    TAG_GUARD = 1 << 5,
+    TAG_SHARED_CACHE = 1 << 6,
+    TAG_IMAGE = 1 << 7,
+    TAG_TEXT = 1 << 8,
+    TAG_DATA = 1 << 9,
+    TAG_SHARED = 1 << 10,
+    TAG_ANONYMOUS = 1 << 11
+};
+
+const std::pair<RegionTag, const char*> regionTagNames[] = {
+    { TAG_MALLOC, "malloc" },
+    { TAG_MALLOC_TINY, "malloc_tiny" },
+    { TAG_MALLOC_SMALL, "malloc_small" },
+    { TAG_MALLOC_LARGE, "malloc_large" },
+    { TAG_STACK, "stack" },
+    { TAG_GUARD, "guard" },
+    { TAG_SHARED_CACHE, "shared_cache" },
+    { TAG_IMAGE, "image" },
+    { TAG_TEXT, "text" },
+    { TAG_DATA, "data" },
+    { TAG_SHARED, "shared" },
+    { TAG_ANONYMOUS, "anon" }
+};
+
+// Comma-separated names of the set tags
+inline std::string formatRegionTags(uint32_t tags) {
+    std::string names;
+    for (const auto& tag : regionTagNames) {
+        if (tags & tag.first) {
+            if (!names.empty()) {
+                names += ",";
+            }
+            names += tag.second;
+        }
+    }
+    return names.empty() ? "-" : names;
+}
+
+// Parse a comma-separated list of tag names
+inline bool parseRegionTags(const std::string& text, uint32_t& tags) {
+    tags = 0;
+    std::stringstream list(text);
+    std::string name;
+    while (std::getline(list, name, ',')) {
+        bool found = false;
+        for (const auto& tag : regionTagNames) {
+            if (name == tag.second) {
+                tags |= tag.first;
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            return false;
+        }
+    }
+    return tags != 0;
+}
+
+// Memory region structure
+struct MemoryRegion {
+    mach_vm_address_t start;
+    mach_vm_size_t size;
+    vm_prot_t protection;
+    std::string name;
+    bool readable;
+    bool writable;
+    bool executable;
+    uint32_t userTag;
+    uint32_t shareMode;
+    uint32_t objectId;
+    uint32_t depth;
+    uint32_t tags;
+};
+
+// Which regions a scan covers: any region with an included tag (all regions if
+// none are given) and none of the excluded ones
+struct RegionFilter {
+    uint32_t include;
+    uint32_t exclude;
+    
+    RegionFilter() : include(0), exclude(0) {}
+    
+    bool matches(const MemoryRegion& region) const {
+        return (include == 0 || (region.tags & include) != 0) && (region.tags & exclude) == 0;
+    }
+};
+
+// What changed between two refreshes of the region map
+struct RegionDiff {
+    size_t added;
+    size_t removed;
+    size_t changed;
+    // Old extents of regions that went away or changed; cached state there is suspect
+    std::vector<std::pair<mach_vm_address_t, mach_vm_address_t>> invalidated;
+    
+    RegionDiff() : added(0), removed(0), changed(0) {}
+    bool empty() const { return added == 0 && removed == 0 && changed == 0; }
+};
+
+// Memory regions of the target sorted by start address, with O(log n) lookup of
+// the region that contains an address
+class RegionIndex {
+private:
+    std::vector<MemoryRegion> regions;
+    
+    static bool sameRegion(const MemoryRegion& a, const MemoryRegion& b) {
+        return a.start == b.start && a.size == b.size && a.protection == b.protection;
+    }
+    
+public:
+    size_t size() const { return regions.size(); }
+    bool empty() const { return regions.empty(); }
+    void clear() { regions.clear(); }
+    const MemoryRegion& operator[](size_t index) const { return regions[index]; }
+    std::vector<MemoryRegion>::const_iterator begin() const { return regions.begin(); }
+    std::vector<MemoryRegion>::const_iterator end() const { return regions.end(); }
+    
+    // Region containing address, or nullptr if it isn't mapped
+    const MemoryRegion* find(mach_vm_address_t address) const {
+        auto it = std::upper_bound(regions.begin(), regions.end(), address,
+            [](mach_vm_address_t value, const MemoryRegion& region) { return value < region.start; });
+        if (it == regions.begin()) {
+            return nullptr;
+        }
+        --it;
+        return address - it->start < it->size ? &*it : nullptr;
+    }
+    
+    // Whether [address, address + size) is mapped with at least the given protection.
+    // The range may span adjacent regions.
+    bool contains(mach_vm_address_t address, mach_vm_size_t size, vm_prot_t protection = VM_PROT_READ) const {
+        mach_vm_address_t end = address + size;
+        while (address < end) {
+            const MemoryRegion* region = find(address);
+            if (!region || (region->protection & protection) != protection) {
+                return false;
+            }
+            address = region->start + region->size;
+        }
+        return true;
+    }
+    
+    // Recompute the tags of every region
+    template <typename Fn>
+    void retag(Fn tagsFor) {
+        for (MemoryRegion& region : regions) {
+            region.tags = tagsFor(region);
+        }
+    }
+    
+    // Replace the map with a fresh enumeration and report what changed
+    RegionDiff update(std::vector<MemoryRegion> fresh) {
+        RegionDiff diff;
+        size_t i = 0;
+        size_t j = 0;
+        while (i < regions.size() || j < fresh.size()) {
+            if (j == fresh.size() || (i < regions.size() && regions[i].start < fresh[j].start)) {
+                diff.removed++;
+                diff.invalidated.push_back(std::make_pair(regions[i].start, regions[i].start + regions[i].size));
+                i++;
+            } else if (i == regions.size() || fresh[j].start < regions[i].start) {
+                diff.added++;
+                j++;
+            } else {
+                if (!sameRegion(regions[i], fresh[j])) {
+                    diff.changed++;
+                    diff.invalidated.push_back(std::make_pair(regions[i].start, regions[i].start + regions[i].size));
+                }
+                i++;
+                j++;
+            }
+        }
+        regions.swap(fresh);
+        return diff;
+    }
+};
+
+// One segment of an image loaded in the target
+struct ImageSegment {
+    mach_vm_address_t start;
+    mach_vm_address_t end;
+    mach_vm_address_t imageBase;
+    std::string segment;
+    std::string image;
+};
+
+// Images loaded in the target, read from dyld's image list (TASK_DYLD_INFO) and
+// kept as segments sorted by address
+class ModuleMap {
+private:
+    std::vector<ImageSegment> segments;
+    
+    // Upper bounds for values read from target memory
+    static constexpr uint32_t MAX_IMAGES = 1 << 16;
+    static constexpr uint32_t MAX_LOAD_COMMANDS_SIZE = 1 << 20;
+    
+    static bool readTarget(task_t task, mach_vm_address_t address, void* data, size_t size) {
+        mach_vm_size_t dataSize = 0;
+        kern_return_t kr = mach_vm_read_overwrite(task, address, size, (mach_vm_address_t)data, &dataSize);
+        return kr == KERN_SUCCESS && dataSize == size;
+    }
+    
+    // File name of an image, or "" if its path can't be read
+    static std::string readImageName(task_t task, mach_vm_address_t address) {
+        char path[1024];
+        size_t length = sizeof(path);
+        // The path may end close to an unmapped page; retry with shorter reads
+        while (length >= 64 && !readTarget(task, address, path, length)) {
+            length /= 2;
+        }
+        if (length < 64) {
+            return "";
+        }
+        std::string name(path, strnlen(path, length));
+        size_t slash = name.rfind('/');
+        return slash == std::string::npos ? name : name.substr(slash + 1);
+    }
+    
+    void addImage(task_t task, mach_vm_address_t loadAddress, const std::string& name) {
+        mach_header_64 header;
+        if (!readTarget(task, loadAddress, &header, sizeof(header)) || header.magic != MH_MAGIC_64 ||
+            header.sizeofcmds > MAX_LOAD_COMMANDS_SIZE) {
+            return;
+        }
+        
+        std::vector<uint8_t> commands(header.sizeofcmds);
+        if (!readTarget(task, loadAddress + sizeof(header), commands.data(), commands.size())) {
+            return;
+        }
+        
+        // Segment addresses are relative to the unslid __TEXT address
+        std::vector<segment_command_64> found;
+        mach_vm_address_t textAddress = 0;
+        size_t offset = 0;
+        for (uint32_t i = 0; i < header.ncmds && offset + sizeof(load_command) <= commands.size(); i++) {
+            load_command command;
+            memcpy(&command, commands.data() + offset, sizeof(command));
+            if (command.cmdsize < sizeof(load_command) || offset + command.cmdsize > commands.size()) {
+                break;
+            }
+            if (command.cmd == LC_SEGMENT_64 && command.cmdsize >= sizeof(segment_command_64)) {
+                segment_command_64 segment;
+                memcpy(&segment, commands.data() + offset, sizeof(segment));
+                if (strncmp(segment.segname, "__TEXT", sizeof(segment.segname)) == 0) {
+                    textAddress = segment.vmaddr;
+                }
+                // __PAGEZERO and other inaccessible segments aren't mapped
+                if (segment.vmsize > 0 && segment.initprot != 0) {
+                    found.push_back(segment);
+                }
+            }
+            offset += command.cmdsize;
+        }
+        
+        mach_vm_address_t slide = loadAddress - textAddress;
+        for (const segment_command_64& segment : found) {
+            ImageSegment entry;
+            entry.start = segment.vmaddr + slide;
+            entry.end = entry.start + segment.vmsize;
+            entry.imageBase = loadAddress;
+            entry.segment = std::string(segment.segname, strnlen(segment.segname, sizeof(segment.segname)));
+            entry.image = name;
+            segments.push_back(entry);
+        }
+    }
+    
+public:
+    // Read the image list of the target. Returns false if dyld's info isn't available.
+    bool load(task_t task) {
+        segments.clear();
+        
+        task_dyld_info_data_t dyldInfo;
+        mach_msg_type_number_t count = TASK_DYLD_INFO_COUNT;
+        if (task_info(task, TASK_DYLD_INFO, (task_info_t)&dyldInfo, &count) != KERN_SUCCESS ||
+            dyldInfo.all_image_info_addr == 0) {
+            return false;
+        }
+        
+        dyld_all_image_infos infos;
+        memset(&infos, 0, sizeof(infos));
+        size_t infoSize = std::min<size_t>(sizeof(infos), dyldInfo.all_image_info_size);
+        if (!readTarget(task, dyldInfo.all_image_info_addr, &infos, infoSize) ||
+            infos.infoArray == nullptr || infos.infoArrayCount == 0 || infos.infoArrayCount > MAX_IMAGES) {
+            return false;
+        }
+        
+        std::vector<dyld_image_info> images(infos.infoArrayCount);
+        if (!readTarget(task, (mach_vm_address_t)infos.infoArray, images.data(), images.size() * sizeof(dyld_image_info))) {
+            return false;
+        }
+        
+        for (const dyld_image_info& image : images) {
+            addImage(task, (mach_vm_address_t)image.imageLoadAddress,
+                     readImageName(task, (mach_vm_address_t)image.imageFilePath));
+        }
+        
+        std::sort(segments.begin(), segments.end(),
+                  [](const ImageSegment& a, const ImageSegment& b) { return a.start < b.start; });
+        return true;
+    }
+    
+    void clear() { segments.clear(); }
+    bool empty() const { return segments.empty(); }
+    const std::vector<ImageSegment>& all() const { return segments; }
+    
+    // Segment containing address, or nullptr
+    const ImageSegment* find(mach_vm_address_t address) const {
+        auto it = std::upper_bound(segments.begin(), segments.end(), address,
+            [](mach_vm_address_t value, const ImageSegment& segment) { return value < segment.start; });
+        if (it == segments.begin()) {
+            return nullptr;
+        }
+        --it;
+        return address < it->end ? &*it : nullptr;
+    }
+    
+    // Load address of the first image with this file name
+    bool imageBase(const std::string& name, mach_vm_address_t& base) const {
+        for (const ImageSegment& segment : segments) {
+            if (segment.image == name) {
+                base = segment.imageBase;
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    // Image tags for the segments overlapping [start, end)
+    uint32_t tagsFor(mach_vm_address_t start, mach_vm_address_t end) const {
+        auto it = std::upper_bound(segments.begin(), segments.end(), start,
+            [](mach_vm_address_t value, const ImageSegment& segment) { return value < segment.start; });
+        if (it != segments.begin() && std::prev(it)->end > start) {
+            --it;
+        }
+        
+        uint32_t tags = 0;
+        for (; it != segments.end() && it->start < end; ++it) {
+            tags |= TAG_IMAGE;
+            if (it->segment == "__TEXT") {
+                tags |= TAG_TEXT;
+            } else if (it->segment.compare(0, 6, "__DATA") == 0) {
+                tags |= TAG_DATA;
+            }
+        }
+        return tags;
+    }
+};
+
+// Hot-path counters of the scan engine
+enum StatCounter {
+    STAT_READ_CALLS,
+    STAT_READ_BYTES,
+    STAT_READ_FAILURES,
+    STAT_READ_NANOS,
+    STAT_REMAP_CALLS,
+    STAT_COMPARE_BYTES,
+    STAT_COMPARE_NANOS,
+    STAT_FORMAT_NANOS,
+    STAT_BUFFER_ALLOCATIONS,
+    STAT_BUFFER_BYTES,
+    STAT_COUNT
+};
+
+// One timed piece of scan work: a chunk, a read window or a group of results
+struct TraceSpan {
+    const char* name;
+    mach_vm_address_t address;
+    uint64_t bytes;
+    uint64_t start;
+    uint64_t duration;
+    uint32_t thread;
+};
+
+// Spans kept per thread and scan; past this only the counters keep going
+const size_t TRACE_SPAN_LIMIT = 65536;
+
+inline uint64_t statClock() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// Counters of one thread. Only the owning thread writes them (a relaxed load
+// and store, no locked add), and each block fills whole cache lines of its own,
+// so the hot loops never share one. spanLock only meets spans() and reset(),
+// which run between scans; spans are per read window or chunk, so the
+// uncontended lock in record() is accepted.
+struct alignas(64) ThreadStats {
+    std::atomic<uint64_t> counters[STAT_COUNT];
+    std::mutex spanLock;
+    std::vector<TraceSpan> spans;
+    uint32_t thread;
+    
+    explicit ThreadStats(uint32_t index) : thread(index) {
+        reset();
+    }
+    
+    void add(StatCounter counter, uint64_t amount) {
+        counters[counter].store(counters[counter].load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+    
+    void record(const char* name, mach_vm_address_t address, uint64_t bytes, uint64_t start, uint64_t duration) {
+        std::lock_guard<std::mutex> guard(spanLock);
+        if (spans.size() < TRACE_SPAN_LIMIT) {
+            spans.push_back({ name, address, bytes, start, duration, thread });
+        }
+    }
+    
+    void reset() {
+        for (auto& counter : counters) {
+            counter.store(0, std::memory_order_relaxed);
+        }
+        std::lock_guard<std::mutex> guard(spanLock);
+        spans.clear();
+    }
+};
+
+// Registry of the per-thread counters, merged on demand. Blocks outlive their
+// threads (an exiting thread hands its block to the next new one) so counts
+// of short-lived reader threads aren't lost.
+class ScanStats {
+private:
+    std::mutex lock;
+    std::vector<std::unique_ptr<ThreadStats>> threads;
+    std::vector<ThreadStats*> unused;
+    std::string name;
+    uint64_t started;
+    uint64_t finished;
+    
+public:
+    ScanStats() : started(0), finished(0) {}
+    
+    ThreadStats* acquire() {
+        std::lock_guard<std::mutex> guard(lock);
+        if (!unused.empty()) {
+            ThreadStats* stats = unused.back();
+            unused.pop_back();
+            return stats;
+        }
+        threads.emplace_back(new ThreadStats(static_cast<uint32_t>(threads.size())));
+        return threads.back().get();
+    }
+    
+    void release(ThreadStats* stats) {
+        std::lock_guard<std::mutex> guard(lock);
+        unused.push_back(stats);
+    }
+    
+    // Start counting a new scan
+    void begin(const std::string& description) {
+        std::lock_guard<std::mutex> guard(lock);
+        for (auto& stats : threads) {
+            stats->reset();
+        }
+        name = description;
+        started = statClock();
+        finished = 0;
+    }
+    
+    void end() {
+        std::lock_guard<std::mutex> guard(lock);
+        finished = statClock();
+    }
+    
+    std::string description() {
+        std::lock_guard<std::mutex> guard(lock);
+        return name;
+    }
+    
+    // Start of the scan and its wall time so far, in nanoseconds
+    uint64_t startTime() {
+        std::lock_guard<std::mutex> guard(lock);
+        return started;
+    }
+    
+    uint64_t elapsed() {
+        std::lock_guard<std::mutex> guard(lock);
+        return started == 0 ? 0 : (finished > 0 ? finished : statClock()) - started;
+    }
+    
+    uint64_t total(StatCounter counter) {
+        std::lock_guard<std::mutex> guard(lock);
+        uint64_t sum = 0;
+        for (auto& stats : threads) {
+            sum += stats->counters[counter].load(std::memory_order_relaxed);
+        }
+        return sum;
+    }
+    
+    // Spans of every thread in start order
+    std::vector<TraceSpan> spans() {
+        std::vector<TraceSpan> all;
+        std::lock_guard<std::mutex> guard(lock);
+        for (auto& stats : threads) {
+            std::lock_guard<std::mutex> spanGuard(stats->spanLock);
+            all.insert(all.end(), stats->spans.begin(), stats->spans.end());
+        }
+        std::sort(all.begin(), all.end(), [](const TraceSpan& a, const TraceSpan& b) { return a.start < b.start; });
+        return all;
+    }
+};
+
+inline ScanStats scanStats;
+
+// The calling thread's counters
+inline ThreadStats& threadStats() {
+    struct Slot {
+        ThreadStats* stats;
+        Slot() : stats(scanStats.acquire()) {}
+        ~Slot() { scanStats.release(stats); }
+    };
+    thread_local Slot slot;
+    return *slot.stats;
+}
+
+// Adds the time spent in a scope to a counter (STAT_COUNT for none) and, when
+// given a name, records the scope as a trace span
+class StatTimer {
+private:
+    StatCounter counter;
+    const char* name;
+    mach_vm_address_t address;
+    uint64_t bytes;
+    uint64_t start;
+    
+public:
+    StatTimer(StatCounter timeCounter, const char* spanName = nullptr, mach_vm_address_t spanAddress = 0, uint64_t spanBytes = 0)
+        : counter(timeCounter), name(spanName), address(spanAddress), bytes(spanBytes), start(statClock()) {}
+    
+    ~StatTimer() {
+        uint64_t duration = statClock() - start;
+        ThreadStats& stats = threadStats();
+        if (counter != STAT_COUNT) {
+            stats.add(counter, duration);
+        }
+        if (name) {
+            stats.record(name, address, bytes, start, duration);
+        }
+    }
+    
+    StatTimer(const StatTimer&) = delete;
+    StatTimer& operator=(const StatTimer&) = delete;
+};
+
+// mach_vm_read_overwrite of the whole range, counted in the read stats
+inline bool readTargetMemory(task_t task, mach_vm_address_t address, void* buffer, size_t size) {
+    uint64_t start = statClock();
+    mach_vm_size_t dataSize = 0;
+    kern_return_t kr = mach_vm_read_overwrite(task, address, size, (mach_vm_address_t)buffer, &dataSize);
+    bool complete = kr == KERN_SUCCESS && dataSize == size;
+    
+    ThreadStats& stats = threadStats();
+    stats.add(STAT_READ_CALLS, 1);
+    stats.add(STAT_READ_NANOS, statClock() - start);
+    if (complete) {
+        stats.add(STAT_READ_BYTES, size);
+    } else {
+        stats.add(STAT_READ_FAILURES, 1);
+    }
+    return complete;
+}
+
+// One value to write into the target
+struct ValueWrite {
+    mach_vm_address_t address;
+    const uint8_t* data;
+    size_t size;
+};
+
+// Values on the same page are written together when they are at most this many bytes apart
+const size_t WRITE_GAP_MAX = 256;
+
+// Write values sorted by address with as few mach_vm_write calls as possible:
+// the values starting on one page become a single run. The bytes between the
+// values of a run are read right before and written back unchanged; if that read
+// fails the run falls back to one write per value. Returns how many values were
+// written, and adds the mach_vm_write calls made to calls.
+inline size_t writeTargetValues(task_t task, const std::vector<ValueWrite>& values, std::vector<uint8_t>& scratch, size_t& calls) {
+    mach_vm_address_t pageMask = ~static_cast<mach_vm_address_t>(vm_page_size - 1);
+    size_t written = 0;
+    for (size_t first = 0; first < values.size(); ) {
+        mach_vm_address_t start = values[first].address;
+        mach_vm_address_t end = start + values[first].size;
+        bool gaps = false;
+        size_t last = first + 1;
+        for (; last < values.size(); last++) {
+            const ValueWrite& value = values[last];
+            if ((value.address & pageMask) != (start & pageMask) || value.address > end + WRITE_GAP_MAX) {
+                break;
+            }
+            gaps = gaps || value.address > end;
+            end = std::max<mach_vm_address_t>(end, value.address + value.size);
+        }
+        
+        scratch.resize(static_cast<size_t>(end - start));
+        if (last - first == 1 || !gaps || readTargetMemory(task, start, scratch.data(), scratch.size())) {
+            for (size_t i = first; i < last; i++) {
+                memcpy(scratch.data() + (values[i].address - start), values[i].data, values[i].size);
+            }
+            calls++;
+            if (mach_vm_write(task, start, (vm_offset_t)scratch.data(), static_cast<mach_msg_type_number_t>(scratch.size())) == KERN_SUCCESS) {
+                written += last - first;
+            }
+        } else {
+            for (size_t i = first; i < last; i++) {
+                calls++;
+                if (mach_vm_write(task, values[i].address, (vm_offset_t)values[i].data, static_cast<mach_msg_type_number_t>(values[i].size)) == KERN_SUCCESS) {
+                    written++;
+                }
+            }
+        }
+        first = last;
+    }
+    return written;
+}
+
+// Growable array of trivially copyable values. Unlike std::vector it never
+// value-initializes on resize and grows with realloc, so appending millions of
+// hits doesn't zero-fill or construct anything. A buffer can also adopt memory
+// it doesn't own (such as a mapped session file); it is copied out on first growth.
+template <typename T>
+class PodBuffer {
+private:
+    static_assert(std::is_trivially_copyable<T>::value, "PodBuffer needs a trivially copyable type");
+    
+    T* items;
+    size_t count;
+    size_t capacity;
+    std::shared_ptr<void> backing;
+    
+public:
+    PodBuffer() : items(nullptr), count(0), capacity(0) {}
+    
+    PodBuffer(const PodBuffer& other) : items(nullptr), count(0), capacity(0) {
+        append(other.items, other.count);
+    }
+    
+    PodBuffer(PodBuffer&& other) : items(other.items), count(other.count), capacity(other.capacity),
+                                   backing(std::move(other.backing)) {
+        other.items = nullptr;
+        other.count = 0;
+        other.capacity = 0;
+    }
+    
+    PodBuffer& operator=(PodBuffer other) {
+        std::swap(items, other.items);
+        std::swap(count, other.count);
+        std::swap(capacity, other.capacity);
+        std::swap(backing, other.backing);
+        return *this;
+    }
+    
+    ~PodBuffer() {
+        if (!backing) {
+            free(items);
+        }
+    }
+    
+    // Use size elements at data, kept alive by owner, instead of an own allocation
+    void adopt(T* data, size_t size, std::shared_ptr<void> owner) {
+        if (!backing) {
+            free(items);
+        }
+        items = data;
+        count = size;
+        capacity = size;
+        backing = std::move(owner);
+    }
+    
+    void reserve(size_t wanted) {
+        if (wanted <= capacity) {
+            return;
+        }
+        T* grown = nullptr;
+        if (backing) {
+            grown = static_cast<T*>(malloc(wanted * sizeof(T)));
+            if (grown && count > 0) {
+                memcpy(grown, items, count * sizeof(T));
+            }
+        } else {
+            grown = static_cast<T*>(realloc(items, wanted * sizeof(T)));
+        }
+        if (!grown) {
+            throw std::bad_alloc();
+        }
+        ThreadStats& stats = threadStats();
+        stats.add(STAT_BUFFER_ALLOCATIONS, 1);
+        stats.add(STAT_BUFFER_BYTES, wanted * sizeof(T));
+        items = grown;
+        capacity = wanted;
+        backing.reset();
+    }
+    
+    // Resize without initializing new elements
+    void resize(size_t size) {
+        if (size > capacity) {
+            reserve(std::max(size, capacity * 2));
+        }
+        count = size;
+    }
+    
+    void push_back(const T& item) {
+        if (count == capacity) {
+            reserve(capacity > 0 ? capacity * 2 : 1024);
+        }
+        items[count++] = item;
+    }
+    
+    void append(const T* source, size_t size) {
+        if (size == 0) {
+            return;
+        }
+        resize(count + size);
+        memcpy(items + count - size, source, size * sizeof(T));
+    }
+    
+    void clear() { count = 0; }
+    bool empty() const { return count == 0; }
+    size_t size() const { return count; }
+    T* data() { return items; }
+    const T* data() const { return items; }
+    T& operator[](size_t index) { return items[index]; }
+    const T& operator[](size_t index) const { return items[index]; }
+};
+
+// Scan results stored as columns: one contiguous array of addresses and one
+// packed array of fixed-width values. A hit costs sizeof(address) + valueSize
+// bytes; descriptions are only formatted when results are displayed.
+// Results of an any scan also carry the type of each row; their values are
+// padded to the widest type.
+struct ResultStore {
+    ValueType type;
+    size_t valueSize;
+    PodBuffer<mach_vm_address_t> addresses;
+    PodBuffer<uint8_t> values;
+    PodBuffer<uint8_t> types;
+    
+    ResultStore() : type(UNKNOWN), valueSize(0) {}
+    
+    void reset(ValueType valueType, size_t size) {
+        type = valueType;
+        valueSize = size;
+        addresses.clear();
+        values.clear();
+        types.clear();
+    }
+    
+    void clear() { reset(UNKNOWN, 0); }
+    size_t size() const { return addresses.size(); }
+    bool empty() const { return addresses.empty(); }
+    
+    void append(mach_vm_address_t address, const uint8_t* value) {
+        addresses.push_back(address);
+        values.append(value, valueSize);
+    }
+    
+    // Append a row of an any store: only the bytes of its own type are read
+    void append(mach_vm_address_t address, const uint8_t* value, ValueType rowType) {
+        size_t width = valueTypeSize(rowType);
+        addresses.push_back(address);
+        values.resize(values.size() + valueSize);
+        uint8_t* row = values.data() + values.size() - valueSize;
+        memcpy(row, value, width);
+        memset(row + width, 0, valueSize - width);
+        types.push_back(static_cast<uint8_t>(rowType));
+    }
+    
+    // Append a row of which only the first width bytes exist; the rest is zeroed
+    void appendPadded(mach_vm_address_t address, const uint8_t* value, size_t width) {
+        addresses.push_back(address);
+        values.resize(values.size() + valueSize);
+        uint8_t* row = values.data() + values.size() - valueSize;
+        memcpy(row, value, width);
+        memset(row + width, 0, valueSize - width);
+    }
+    
+    // Append rows [first, last) of another store with the same value width
+    void append(const ResultStore& other, size_t first, size_t last) {
+        addresses.append(other.addresses.data() + first, last - first);
+        values.append(other.values.data() + first * valueSize, (last - first) * valueSize);
+        if (!other.types.empty()) {
+            types.append(other.types.data() + first, last - first);
+        }
+    }
+    
+    const uint8_t* value(size_t index) const { return values.data() + index * valueSize; }
+    ValueType rowType(size_t index) const { return types.empty() ? type : static_cast<ValueType>(types[index]); }
+    size_t rowSize(size_t index) const { return types.empty() ? valueSize : valueTypeSize(rowType(index)); }
+    
+    // Drop repeated rows (same address and type) of a store sorted by address
+    void removeDuplicates() {
+        size_t kept = 0;
+        for (size_t i = 0; i < size(); i++) {
+            if (kept > 0 && addresses[kept - 1] == addresses[i] && rowType(kept - 1) == rowType(i)) {
+                continue;
+            }
+            if (kept != i) {
+                addresses[kept] = addresses[i];
+                memcpy(values.data() + kept * valueSize, value(i), valueSize);
+                if (!types.empty()) {
+                    types[kept] = types[i];
+                }
+            }
+            kept++;
+        }
+        addresses.resize(kept);
+        values.resize(kept * valueSize);
+        if (!types.empty()) {
+            types.resize(kept);
+        }
+    }
+    
+    // Reorder rows by address (scans already produce them in order)
+    void sortByAddress() {
+        if (std::is_sorted(addresses.data(), addresses.data() + size())) {
+            return;
+        }
+        std::vector<size_t> order(size());
+        for (size_t i = 0; i < order.size(); i++) {
+            order[i] = i;
+        }
+        std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) { return addresses[a] < addresses[b]; });
+        
+        ResultStore sorted;
+        sorted.reset(type, valueSize);
+        sorted.addresses.reserve(size());
+        sorted.values.reserve(values.size());
+        for (size_t index : order) {
+            sorted.append(addresses[index], value(index));
+            if (!types.empty()) {
+                sorted.types.push_back(types[index]);
+            }
+        }
+        std::swap(addresses, sorted.addresses);
+        std::swap(values, sorted.values);
+        std::swap(types, sorted.types);
+    }
+};
+
+// One step of the next scan history: which rows of the first scan were still
+// results (empty for the first scan itself) and their values at that point
+struct ScanGeneration {
+    ValueType type;
+    size_t valueSize;
+    PodBuffer<size_t> indices;
+    PodBuffer<uint8_t> values;
+};
+
+// Reverse pointer index entry: a pointer-sized slot in writable memory and the
+// address it holds. The index is sorted by value, so the slots pointing into a
+// range of addresses are found with one binary search.
+struct PointerSlot {
+    mach_vm_address_t value;
+    mach_vm_address_t slot;
+    
+    bool operator<(const PointerSlot& other) const {
+        return value < other.value || (value == other.value && slot < other.slot);
+    }
+};
+
+// Pointer scans follow at most this many levels and stop after this many paths
+// or visited slots
+const size_t POINTER_MAX_DEPTH = 8;
+const size_t POINTER_PATH_LIMIT = 100000;
+const size_t POINTER_NODE_LIMIT = 1 << 24;
+
+// A static pointer path: read the pointer at image load address + baseOffset,
+// then for each offset add it to the pointer and, except after the last one,
+// read the pointer found there
+struct PointerPath {
+    std::string image;
+    uint64_t baseOffset;
+    std::vector<int64_t> offsets;
+};
+
+// Saved session file: a SessionHeader, the region table of the process at save
+// time, then (page-aligned) the address column and the packed value column (and,
+// for an any scan, one type byte per row), followed by the pointer paths of the
+// last pointer scan (image name table, then one fixed-size record per path).
+// Fields are in native byte order.
+const char SESSION_MAGIC[8] = { 'M', 'M', 'S', 'E', 'S', 'S', 'N', '\0' };
+const uint32_t SESSION_VERSION = 3;
+
+struct SessionHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    int32_t pid;
+    uint32_t type;
+    uint64_t valueSize;
+    uint64_t count;
+    uint64_t regionCount;
+    uint64_t addressOffset;
+    uint64_t valueOffset;
+    uint64_t timestamp;
+    char processName[256];
+    // Version 2
+    uint64_t pointerTarget;
+    uint64_t imageCount;
+    uint64_t imageOffset;
+    uint64_t pointerCount;
+    uint64_t pointerOffset;
+    // Version 3
+    uint64_t typeOffset;
+};
+
+// Version 1 headers end before the pointer fields, version 2 before the type column
+const size_t SESSION_V1_HEADER_SIZE = offsetof(SessionHeader, pointerTarget);
+const size_t SESSION_V2_HEADER_SIZE = offsetof(SessionHeader, typeOffset);
+
+struct SessionRegion {
+    uint64_t start;
+    uint64_t size;
+    int32_t protection;
+    uint32_t reserved;
+};
+
+struct SessionImage {
+    char name[256];
+    uint64_t base;
+};
+
+struct SessionPointer {
+    uint32_t image;
+    uint32_t depth;
+    uint64_t baseOffset;
+    int64_t offsets[POINTER_MAX_DEPTH];
+};
+
+// Candidates further apart than this are read separately by next scans
+const size_t READ_GROUP_GAP = 64 * 1024;
+
+// Comparison applied by a scan (using regular enum for compatibility)
+enum Comparison {
+    COMPARE_EXACT,
+    COMPARE_GREATER,
+    COMPARE_LESS,
+    COMPARE_BETWEEN,
+    COMPARE_CHANGED,
+    COMPARE_UNCHANGED,
+    COMPARE_INCREASED,
+    COMPARE_DECREASED,
+    COMPARE_NOCASE,
+    COMPARE_APPROX
+};
+
+// Comparisons whose operand is a lower bound followed by an upper bound. approx
+// is between with the bounds derived from a value and a tolerance.
+inline bool comparisonTakesRange(Comparison comparison) {
+    return comparison == COMPARE_BETWEEN || comparison == COMPARE_APPROX;
+}
+
+// Comparisons that need the value from the previous scan
+inline bool comparisonNeedsPrevious(Comparison comparison) {
+    return comparison == COMPARE_CHANGED || comparison == COMPARE_UNCHANGED ||
+           comparison == COMPARE_INCREASED || comparison == COMPARE_DECREASED;
+}
+
+// Unaligned load of a value from a scan buffer
+template <typename T>
+inline T loadValue(const uint8_t* data) {
+    T value;
+    memcpy(&value, data, sizeof(T));
+    return value;
+}
+
+// Scan predicates, built from the kernel's encoded operand. Each is called with
+// the current value and the value found by the previous scan (ignored by the
+// comparisons that don't need it).
+template <typename T>
+struct EqualTo {
+    static const Comparison kind = COMPARE_EXACT;
+    T operand;
+    explicit EqualTo(const uint8_t* data) : operand(loadValue<T>(data)) {}
+    bool operator()(T value, T) const { return value == operand; }
+};
+
+template <typename T>
+struct GreaterThan {
+    static const Comparison kind = COMPARE_GREATER;
+    T operand;
+    explicit GreaterThan(const uint8_t* data) : operand(loadValue<T>(data)) {}
+    bool operator()(T value, T) const { return value > operand; }
+};
+
+template <typename T>
+struct LessThan {
+    static const Comparison kind = COMPARE_LESS;
+    T operand;
+    explicit LessThan(const uint8_t* data) : operand(loadValue<T>(data)) {}
+    bool operator()(T value, T) const { return value < operand; }
+};
+
+// Inclusive range; the operand holds the lower bound followed by the upper bound
+template <typename T>
+struct InRange {
+    static const Comparison kind = COMPARE_BETWEEN;
+    T lower;
+    T upper;
+    explicit InRange(const uint8_t* data) : lower(loadValue<T>(data)), upper(loadValue<T>(data + sizeof(T))) {}
+    bool operator()(T value, T) const { return value >= lower && value <= upper; }
+};
+
+template <typename T>
+struct ChangedFrom {
+    static const Comparison kind = COMPARE_CHANGED;
+    explicit ChangedFrom(const uint8_t*) {}
+    bool operator()(T value, T previous) const { return value != previous; }
+};
+
+template <typename T>
+struct UnchangedFrom {
+    static const Comparison kind = COMPARE_UNCHANGED;
+    explicit UnchangedFrom(const uint8_t*) {}
+    bool operator()(T value, T previous) const { return value == previous; }
+};
+
+template <typename T>
+struct IncreasedFrom {
+    static const Comparison kind = COMPARE_INCREASED;
+    explicit IncreasedFrom(const uint8_t*) {}
+    bool operator()(T value, T previous) const { return value > previous; }
+};
+
+template <typename T>
+struct DecreasedFrom {
+    static const Comparison kind = COMPARE_DECREASED;
+    explicit DecreasedFrom(const uint8_t*) {}
+    bool operator()(T value, T previous) const { return value < previous; }
+};
+
+// One needle of a string scan. When the scan ignores case its letters are stored
+// lowercase, and firstFold/lastFold (0x20 where the needle has a letter) are OR-ed
+// into the data before the vector filter compares those bytes.
+struct StringNeedle {
+    std::vector<uint8_t> bytes;
+    size_t last;
+    uint8_t firstFold;
+    uint8_t lastFold;
+};
+
+// A string scan looks for at most this many needles ("a|b|c") in one pass
+const size_t STRING_NEEDLE_MAX = 16;
+
+// A ValueType x Comparison pair resolved once, up front, into specialized code.
+// scan() walks a buffer and records the offsets that match; match() tests a
+// single value against its previous value during a next scan. Offsets are only
+// tested every alignment bytes, counted from the (aligned) buffer start.
+struct ScanKernel {
+    Comparison comparison;
+    size_t valueSize;
+    size_t alignment;
+    std::vector<uint8_t> operand;
+    // String scans: the needles (valueSize is the longest), character width, case folding
+    std::vector<StringNeedle> needles;
+    size_t charSize;
+    bool foldCase;
+    void (*scan)(const ScanKernel& kernel, const uint8_t* data, size_t count, std::vector<size_t>& offsets);
+    bool (*match)(const ScanKernel& kernel, const uint8_t* current, const uint8_t* previous);
+};
+
+// Tight typed loop over every aligned start offset in [0, count). The buffer
+// holds at least count + sizeof(T) - 1 bytes.
+template <typename T, template <typename> class Pred>
+void typedScanKernel(const ScanKernel& kernel, const uint8_t* data, size_t count, std::vector<size_t>& offsets) {
+    const Pred<T> pred(kernel.operand.data());
+    const size_t stride = kernel.alignment;
+    for (size_t offset = 0; offset < count; offset += stride) {
+        if (pred(loadValue<T>(data + offset), T())) {
+            offsets.push_back(offset);
+        }
+    }
+}
+
+template <typename T, template <typename> class Pred>
+bool typedMatchKernel(const ScanKernel& kernel, const uint8_t* current, const uint8_t* previous) {
+    const Pred<T> pred(kernel.operand.data());
+    return pred(loadValue<T>(current), loadValue<T>(previous));
+}
+
+// Vector kernels. Each vector step loads one register of candidates at every
+// aligned byte phase of the value, compares all lanes at once and folds the lane
+// results into a bitmask with one bit per start offset. With natural alignment
+// that is a single load per step. The typed loop above handles the tail and
+// stays the reference implementation.
+enum SimdLevel {
+    SIMD_NONE,
+    SIMD_SSE42,
+    SIMD_AVX2,
+    SIMD_NEON
+};
+
+inline SimdLevel detectSimdLevel() {
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return SIMD_AVX2;
+    }
+    if (__builtin_cpu_supports("sse4.2")) {
+        return SIMD_SSE42;
+    }
+    return SIMD_NONE;
+#elif defined(__aarch64__)
+    return SIMD_NEON;
+#else
+    return SIMD_NONE;
+#endif
+}
+
+inline SimdLevel simdLevel() {
+    static const SimdLevel level = detectSimdLevel();
+    return level;
+}
+
+inline const char* simdLevelName(SimdLevel level) {
+    switch (level) {
+        case SIMD_SSE42: return "SSE4.2";
+        case SIMD_AVX2: return "AVX2";
+        case SIMD_NEON: return "NEON";
+        default: return "scalar";
+    }
+}
+
+// Bits marking every step-th byte of a byte-granular compare mask (step 1, 2, 4 or 8)
+inline uint32_t everyNthBit(size_t step) {
+    return step == 1 ? 0xFFFFFFFFu : step == 2 ? 0x55555555u : step == 4 ? 0x11111111u : 0x01010101u;
+}
+
+// Emit the offsets for every set bit of a block mask
+inline void emitMaskOffsets(uint32_t mask, size_t base, std::vector<size_t>& offsets) {
+    while (mask != 0) {
+        offsets.push_back(base + __builtin_ctz(mask));
+        mask &= mask - 1;
+    }
+}
+
+#if defined(__x86_64__)
+template <typename T>
+__attribute__((target("avx2"))) inline __m256i avx2Splat(T value) {
+    if constexpr (std::is_same<T, float>::value) return _mm256_castps_si256(_mm256_set1_ps(value));
+    else if constexpr (std::is_same<T, double>::value) return _mm256_castpd_si256(_mm256_set1_pd(value));
+    else if constexpr (sizeof(T) == 1) return _mm256_set1_epi8(static_cast<char>(value));
+    else if constexpr (sizeof(T) == 2) return _mm256_set1_epi16(static_cast<short>(value));
+    else if constexpr (sizeof(T) == 4) return _mm256_set1_epi32(static_cast<int>(value));
+    else return _mm256_set1_epi64x(static_cast<long long>(value));
+}
+
+template <typename T>
+__attribute__((target("avx2"))) inline __m256i avx2Equal(__m256i a, __m256i b) {
+    if constexpr (sizeof(T) == 1) return _mm256_cmpeq_epi8(a, b);
+    else if constexpr (sizeof(T) == 2) return _mm256_cmpeq_epi16(a, b);
+    else if constexpr (sizeof(T) == 4) return _mm256_cmpeq_epi32(a, b);
+    else return _mm256_cmpeq_epi64(a, b);
+}
+
+template <typename T>
+__attribute__((target("avx2"))) inline __m256i avx2Greater(__m256i a, __m256i b) {
+    if constexpr (sizeof(T) == 2) return _mm256_cmpgt_epi16(a, b);
+    else if constexpr (sizeof(T) == 4) return _mm256_cmpgt_epi32(a, b);
+    else return _mm256_cmpgt_epi64(a, b);
+}
+
+// Byte-granular mask of the lanes of v that satisfy comparison C
+template <typename T, Comparison C>
+__attribute__((target("avx2"))) inline uint32_t avx2Mask(__m256i v, __m256i lo, __m256i hi) {
+    if constexpr (std::is_same<T, float>::value) {
+        __m256 x = _mm256_castsi256_ps(v);
+        __m256 a = _mm256_castsi256_ps(lo);
+        __m256 b = _mm256_castsi256_ps(hi);
+        __m256 m;
+        if constexpr (C == COMPARE_EXACT) m = _mm256_cmp_ps(x, a, _CMP_EQ_OQ);
+        else if constexpr (C == COMPARE_GREATER) m = _mm256_cmp_ps(x, a, _CMP_GT_OQ);
+        else if constexpr (C == COMPARE_LESS) m = _mm256_cmp_ps(x, a, _CMP_LT_OQ);
+        else m = _mm256_and_ps(_mm256_cmp_ps(x, a, _CMP_GE_OQ), _mm256_cmp_ps(x, b, _CMP_LE_OQ));
+        return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_castps_si256(m)));
+    } else if constexpr (std::is_same<T, double>::value) {
+        __m256d x = _mm256_castsi256_pd(v);
+        __m256d a = _mm256_castsi256_pd(lo);
+        __m256d b = _mm256_castsi256_pd(hi);
+        __m256d m;
+        if constexpr (C == COMPARE_EXACT) m = _mm256_cmp_pd(x, a, _CMP_EQ_OQ);
+        else if constexpr (C == COMPARE_GREATER) m = _mm256_cmp_pd(x, a, _CMP_GT_OQ);
+        else if constexpr (C == COMPARE_LESS) m = _mm256_cmp_pd(x, a, _CMP_LT_OQ);
+        else m = _mm256_and_pd(_mm256_cmp_pd(x, a, _CMP_GE_OQ), _mm256_cmp_pd(x, b, _CMP_LE_OQ));
+        return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_castpd_si256(m)));
+    } else if constexpr (C == COMPARE_EXACT) {
+        return static_cast<uint32_t>(_mm256_movemask_epi8(avx2Equal<T>(v, lo)));
+    } else if constexpr (sizeof(T) == 1) {
+        // BYTE is unsigned; compare through min/max
+        if constexpr (C == COMPARE_GREATER) return ~static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_max_epu8(v, lo), lo)));
+        else if constexpr (C == COMPARE_LESS) return ~static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_min_epu8(v, lo), lo)));
+        else return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(v, lo), v),
+                                                                                 _mm256_cmpeq_epi8(_mm256_min_epu8(v, hi), v))));
+    } else {
+        if constexpr (C == COMPARE_GREATER) return static_cast<uint32_t>(_mm256_movemask_epi8(avx2Greater<T>(v, lo)));
+        else if constexpr (C == COMPARE_LESS) return static_cast<uint32_t>(_mm256_movemask_epi8(avx2Greater<T>(lo, v)));
+        else return ~static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(avx2Greater<T>(lo, v), avx2Greater<T>(v, hi))));
+    }
+}
+
+template <typename T, template <typename> class Pred>
+__attribute__((target("avx2")))
+void avx2ScanKernel(const ScanKernel& kernel, const uint8_t* data, size_t count, std::vector<size_t>& offsets) {
+    const Pred<T> pred(kernel.operand.data());
+    const T lower = loadValue<T>(kernel.operand.data());
+    const T upper = kernel.operand.size() >= 2 * sizeof(T) ? loadValue<T>(kernel.operand.data() + sizeof(T)) : lower;
+    const __m256i lo = avx2Splat<T>(lower);
+    const __m256i hi = avx2Splat<T>(upper);
+    const size_t stride = kernel.alignment;
+    const uint32_t lanes = everyNthBit(sizeof(T));
+    const uint32_t aligned = everyNthBit(stride);
+    
+    size_t offset = 0;
+    for (; offset + 32 <= count; offset += 32) {
+        uint32_t mask = 0;
+        for (size_t phase = 0; phase < sizeof(T); phase += stride) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + offset + phase));
+            mask |= (avx2Mask<T, Pred<T>::kind>(v, lo, hi) & lanes) << phase;
+        }
+        emitMaskOffsets(mask & aligned, offset, offsets);
+    }
+    
+    for (; offset < count; offset += stride) {
+        if (pred(loadValue<T>(data + offset), T())) {
+            offsets.push_back(offset);
+        }
+    }
+}
+
+template <typename T>
+__attribute__((target("sse4.2"))) inline __m128i sse42Splat(T value) {
+    if constexpr (std::is_same<T, float>::value) return _mm_castps_si128(_mm_set1_ps(value));
+    else if constexpr (std::is_same<T, double>::value) return _mm_castpd_si128(_mm_set1_pd(value));
+    else if constexpr (sizeof(T) == 1) return _mm_set1_epi8(static_cast<char>(value));
+    else if constexpr (sizeof(T) == 2) return _mm_set1_epi16(static_cast<short>(value));
+    else if constexpr (sizeof(T) == 4) return _mm_set1_epi32(static_cast<int>(value));
+    else return _mm_set1_epi64x(static_cast<long long>(value));
+}
+
+template <typename T>
+__attribute__((target("sse4.2"))) inline __m128i sse42Equal(__m128i a, __m128i b) {
+    if constexpr (sizeof(T) == 1) return _mm_cmpeq_epi8(a, b);
+    else if constexpr (sizeof(T) == 2) return _mm_cmpeq_epi16(a, b);
+    else if constexpr (sizeof(T) == 4) return _mm_cmpeq_epi32(a, b);
+    else return _mm_cmpeq_epi64(a, b);
+}
+
+template <typename T>
+__attribute__((target("sse4.2"))) inline __m128i sse42Greater(__m128i a, __m128i b) {
+    if constexpr (sizeof(T) == 2) return _mm_cmpgt_epi16(a, b);
+    else if constexpr (sizeof(T) == 4) return _mm_cmpgt_epi32(a, b);
+    else return _mm_cmpgt_epi64(a, b);
+}
+
+template <typename T, Comparison C>
+__attribute__((target("sse4.2"))) inline uint32_t sse42Mask(__m128i v, __m128i lo, __m128i hi) {
+    if constexpr (std::is_same<T, float>::value) {
+        __m128 x = _mm_castsi128_ps(v);
+        __m128 a = _mm_castsi128_ps(lo);
+        __m128 b = _mm_castsi128_ps(hi);
+        __m128 m;
+        if constexpr (C == COMPARE_EXACT) m = _mm_cmpeq_ps(x, a);
+        else if constexpr (C == COMPARE_GREATER) m = _mm_cmpgt_ps(x, a);
+        else if constexpr (C == COMPARE_LESS) m = _mm_cmplt_ps(x, a);
+        else m = _mm_and_ps(_mm_cmpge_ps(x, a), _mm_cmple_ps(x, b));
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_castps_si128(m)));
+    } else if constexpr (std::is_same<T, double>::value) {
+        __m128d x = _mm_castsi128_pd(v);
+        __m128d a = _mm_castsi128_pd(lo);
+        __m128d b = _mm_castsi128_pd(hi);
+        __m128d m;
+        if constexpr (C == COMPARE_EXACT) m = _mm_cmpeq_pd(x, a);
+        else if constexpr (C == COMPARE_GREATER) m = _mm_cmpgt_pd(x, a);
+        else if constexpr (C == COMPARE_LESS) m = _mm_cmplt_pd(x, a);
+        else m = _mm_and_pd(_mm_cmpge_pd(x, a), _mm_cmple_pd(x, b));
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_castpd_si128(m)));
+    } else if constexpr (C == COMPARE_EXACT) {
+        return static_cast<uint32_t>(_mm_movemask_epi8(sse42Equal<T>(v, lo)));
+    } else if constexpr (sizeof(T) == 1) {
+        if constexpr (C == COMPARE_GREATER) return ~static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(v, lo), lo))) & 0xFFFFu;
+        else if constexpr (C == COMPARE_LESS) return ~static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(v, lo), lo))) & 0xFFFFu;
+        else return static_cast<uint32_t>(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(_mm_max_epu8(v, lo), v),
+                                                                           _mm_cmpeq_epi8(_mm_min_epu8(v, hi), v))));
+    } else {
+        if constexpr (C == COMPARE_GREATER) return static_cast<uint32_t>(_mm_movemask_epi8(sse42Greater<T>(v, lo)));
+        else if constexpr (C == COMPARE_LESS) return static_cast<uint32_t>(_mm_movemask_epi8(sse42Greater<T>(lo, v)));
+        else return ~static_cast<uint32_t>(_mm_movemask_epi8(_mm_or_si128(sse42Greater<T>(lo, v), sse42Greater<T>(v, hi)))) & 0xFFFFu;
+    }
+}
+
+template <typename T, template <typename> class Pred>
+__attribute__((target("sse4.2")))
+void sse42ScanKernel(const ScanKernel& kernel, const uint8_t* data, size_t count, std::vector<size_t>& offsets) {
+    const Pred<T> pred(kernel.operand.data());
+    const T lower = loadValue<T>(kernel.operand.data());
+    const T upper = kernel.operand.size() >= 2 * sizeof(T) ? loadValue<T>(kernel.operand.data() + sizeof(T)) : lower;
+    const __m128i lo = sse42Splat<T>(lower);
+    const __m128i hi = sse42Splat<T>(upper);
+    const size_t stride = kernel.alignment;
+    const uint32_t lanes = everyNthBit(sizeof(T)) & 0xFFFFu;
+    const uint32_t aligned = everyNthBit(stride);
+    
+    size_t offset = 0;
+    for (; offset + 16 <= count; offset += 16) {
+        uint32_t mask = 0;
+        for (size_t phase = 0; phase < sizeof(T); phase += stride) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + offset + phase));
+            mask |= (sse42Mask<T, Pred<T>::kind>(v, lo, hi) & lanes) << phase;
+        }
+        emitMaskOffsets(mask & aligned, offset, offsets);
+    }
+    
+    for (; offset < count; offset += stride) {
+        if (pred(loadValue<T>(data + offset), T())) {
+            offsets.push_back(offset);
+        }
+    }
+}
+#elif defined(__aarch64__)
+template <typename T>
+inline uint8x16_t neonSplat(T value) {
+    if constexpr (std::is_same<T, float>::value) return vreinterpretq_u8_f32(vdupq_n_f32(value));
+    else if constexpr (std::is_same<T, double>::value) return vreinterpretq_u8_f64(vdupq_n_f64(value));
+    else if constexpr (sizeof(T) == 1) return vdupq_n_u8(static_cast<uint8_t>(value));
+    else if constexpr (sizeof(T) == 2) return vreinterpretq_u8_s16(vdupq_n_s16(static_cast<int16_t>(value)));
+    else if constexpr (sizeof(T) == 4) return vreinterpretq_u8_s32(vdupq_n_s32(static_cast<int32_t>(value)));
+    else return vreinterpretq_u8_s64(vdupq_n_s64(static_cast<int64_t>(value)));
+}
+
+// Byte-granular compare result of the lanes of v that satisfy comparison C
+template <typename T, Comparison C>
+inline uint8x16_t neonCompare(uint8x16_t v, uint8x16_t lo, uint8x16_t hi) {
+    if constexpr (std::is_same<T, float>::value) {
+        float32x4_t x = vreinterpretq_f32_u8(v);
+        float32x4_t a = vreinterpretq_f32_u8(lo);
+        float32x4_t b = vreinterpretq_f32_u8(hi);
+        if constexpr (C == COMPARE_EXACT) return vreinterpretq_u8_u32(vceqq_f32(x, a));
+        else if constexpr (C == COMPARE_GREATER) return vreinterpretq_u8_u32(vcgtq_f32(x, a));
+        else if constexpr (C == COMPARE_LESS) return vreinterpretq_u8_u32(vcltq_f32(x, a));
+        else return vreinterpretq_u8_u32(vandq_u32(vcgeq_f32(x, a), vcleq_f32(x, b)));
+    } else if constexpr (std::is_same<T, double>::value) {
+        float64x2_t x = vreinterpretq_f64_u8(v);
+        float64x2_t a = vreinterpretq_f64_u8(lo);
+        float64x2_t b = vreinterpretq_f64_u8(hi);
+        if constexpr (C == COMPARE_EXACT) return vreinterpretq_u8_u64(vceqq_f64(x, a));
+        else if constexpr (C == COMPARE_GREATER) return vreinterpretq_u8_u64(vcgtq_f64(x, a));
+        else if constexpr (C == COMPARE_LESS) return vreinterpretq_u8_u64(vcltq_f64(x, a));
+        else return vreinterpretq_u8_u64(vandq_u64(vcgeq_f64(x, a), vcleq_f64(x, b)));
+    } else if constexpr (sizeof(T) == 1) {
+        if constexpr (C == COMPARE_EXACT) return vceqq_u8(v, lo);
+        else if constexpr (C == COMPARE_GREATER) return vcgtq_u8(v, lo);
+        else if constexpr (C == COMPARE_LESS) return vcltq_u8(v, lo);
+        else return vandq_u8(vcgeq_u8(v, lo), vcleq_u8(v, hi));
+    } else if constexpr (sizeof(T) == 2) {
+        int16x8_t x = vreinterpretq_s16_u8(v);
+        int16x8_t a = vreinterpretq_s16_u8(lo);
+        int16x8_t b = vreinterpretq_s16_u8(hi);
+        if constexpr (C == COMPARE_EXACT) return vreinterpretq_u8_u16(vceqq_s16(x, a));
+        else if constexpr (C == COMPARE_GREATER) return vreinterpretq_u8_u16(vcgtq_s16(x, a));
+        else if constexpr (C == COMPARE_LESS) return vreinterpretq_u8_u16(vcltq_s16(x, a));
+        else return vreinterpretq_u8_u16(vandq_u16(vcgeq_s16(x, a), vcleq_s16(x, b)));
+    } else if constexpr (sizeof(T) == 4) {
+        int32x4_t x = vreinterpretq_s32_u8(v);
+        int32x4_t a = vreinterpretq_s32_u8(lo);
+        int32x4_t b = vreinterpretq_s32_u8(hi);
+        if constexpr (C == COMPARE_EXACT) return vreinterpretq_u8_u32(vceqq_s32(x, a));
+        else if constexpr (C == COMPARE_GREATER) return vreinterpretq_u8_u32(vcgtq_s32(x, a));
+        else if constexpr (C == COMPARE_LESS) return vreinterpretq_u8_u32(vcltq_s32(x, a));
+        else return vreinterpretq_u8_u32(vandq_u32(vcgeq_s32(x, a), vcleq_s32(x, b)));
+    } else {
+        int64x2_t x = vreinterpretq_s64_u8(v);
+        int64x2_t a = vreinterpretq_s64_u8(lo);
+        int64x2_t b = vreinterpretq_s64_u8(hi);
+        if constexpr (C == COMPARE_EXACT) return vreinterpretq_u8_u64(vceqq_s64(x, a));
+        else if constexpr (C == COMPARE_GREATER) return vreinterpretq_u8_u64(vcgtq_s64(x, a));
+        else if constexpr (C == COMPARE_LESS) return vreinterpretq_u8_u64(vcltq_s64(x, a));
+        else return vreinterpretq_u8_u64(vandq_u64(vcgeq_s64(x, a), vcleq_s64(x, b)));
+    }
+}
+
+// NEON has no movemask; weight each byte by its bit and add across the halves
+inline uint32_t neonMovemask(uint8x16_t m) {
+    static const uint8_t weights[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+    uint8x16_t bits = vandq_u8(m, vld1q_u8(weights));
+    return static_cast<uint32_t>(vaddv_u8(vget_low_u8(bits))) |
+           (static_cast<uint32_t>(vaddv_u8(vget_high_u8(bits))) << 8);
+}
+
+template <typename T, template <typename> class Pred>
+void neonScanKernel(const ScanKernel& kernel, const uint8_t* data, size_t count, std::vector<size_t>& offsets) {
+    const Pred<T> pred(kernel.operand.data());
+    const T lower = loadValue<T>(kernel.operand.data());
+    const T upper = kernel.operand.size() >= 2 * sizeof(T) ? loadValue<T>(kernel.operand.data() + sizeof(T)) : lower;
+    const uint8x16_t lo = neonSplat<T>(lower);
+    const uint8x16_t hi = neonSplat<T>(upper);
+    const size_t stride = kernel.alignment;
+    const uint32_t lanes = everyNthBit(sizeof(T)) & 0xFFFFu;
+    const uint32_t aligned = everyNthBit(stride);
+    
+    size_t offset = 0;
+    for (; offset + 16 <= count; offset += 16) {
+        uint32_t mask = 0;
+        for (size_t phase = 0; phase < sizeof(T); phase += stride) {
+            uint8x16_t v = vld1q_u8(data + offset + phase);
+            mask |= (neonMovemask(neonCompare<T, Pred<T>::kind>(v, lo, hi)) & lanes) << phase;
+        }
+        emitMaskOffsets(mask & aligned, offset, offsets);
+    }
+    
+    for (; offset < count; offset += stride) {
+        if (pred(loadValue<T>(data + offset), T())) {
+            offsets.push_back(offset);
+        }
+    }
+}
+#endif
+
+// Swap in the vector kernel for first-scan comparisons when the CPU has one
+template <typename T, template <typename> class Pred>
+void bindSimdKernel(ScanKernel& kernel) {
+    if constexpr (Pred<T>::kind == COMPARE_EXACT || Pred<T>::kind == COMPARE_GREATER ||
+                  Pred<T>::kind == COMPARE_LESS || Pred<T>::kind == COMPARE_BETWEEN) {
+#if defined(__x86_64__)
+        if (simdLevel() == SIMD_AVX2) {
+            kernel.scan = &avx2ScanKernel<T, Pred>;
+        } else if (simdLevel() == SIMD_SSE42) {
+            kernel.scan = &sse42ScanKernel<T, Pred>;
+        }
+#elif defined(__aarch64__)
+        kernel.scan = &neonScanKernel<T, Pred>;
+#endif
+    }
+}
+
+// Strings support exact (optionally case-insensitive) matches and changed/unchanged
+
+// Case folding for case-insensitive string scans (ASCII letters only)
+inline uint8_t foldAscii(uint8_t c) {
+    return c >= 'A' && c <= 'Z' ? static_cast<uint8_t>(c | 0x20) : c;
+}
+
+// Whether needle occurs at data. With foldCase only the low byte of each
+// character is folded, so UTF-16 high bytes still compare exactly.
+inline bool stringNeedleMatches(const ScanKernel& kernel, const StringNeedle& needle, const uint8_t* data) {
+    if (!kernel.foldCase) {
+        return memcmp(data, needle.bytes.data(), needle.bytes.size()) == 0;
+    }
+    for (size_t i = 0; i < needle.bytes.size(); i++) {
+        uint8_t c = i % kernel.charSize == 0 ? foldAscii(data[i]) : data[i];
+        if (c != needle.bytes[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The shortest value a kernel can match: its shortest needle for a string scan.
+// String kernels get buffers of count + shortestMatch() - 1 bytes, so a short
+// needle is still found in the last bytes before a region ends.
+inline size_t shortestMatch(const ScanKernel& kernel) {
+    size_t shortest = kernel.valueSize;
+    for (const StringNeedle& needle : kernel.needles) {
+        shortest = std::min(shortest, needle.bytes.size());
+    }
+    return shortest;
+}
+
+// Reference string search over start offsets [offset, count); the vector kernels
+// use it for their tail. Each needle is only tried where it fits in the buffer.
+// Each offset is reported once even if several needles match.
+inline void stringScanRange(const ScanKernel& kernel, const uint8_t* data, size_t offset, size_t count, std::vector<size_t>& offsets) {
+    const size_t end = count + shortestMatch(kernel) - 1;
+    for (; offset < count; offset += kernel.alignment) {
+        for (const StringNeedle& needle : kernel.needles) {
+            if (offset + needle.bytes.size() <= end && (data[offset] | needle.firstFold) == needle.bytes[0] &&
+                stringNeedleMatches(kernel, needle, data + offset)) {
+                offsets.push_back(offset);
+                break;
+            }
+        }
+    }
+}
+
+inline void stringScanKernel(const ScanKernel& kernel, const uint8_t* data, size_t count, std::vector<size_t>& offsets) {
+    stringScanRange(kernel, data, 0, count, offsets);
+}
+
+// Verify the offsets of a block that passed the first/last byte filter for needle
+inline uint32_t verifyStringCandidates(const ScanKernel& kernel, const StringNeedle& needle, const uint8_t* block, uint32_t candidates) {
+    uint32_t hits = 0;
+    while (candidates != 0) {
+        uint32_t bit = __builtin_ctz(candidates);
+        if (stringNeedleMatches(kernel, needle, block + bit)) {
+            hits |= 1u << bit;
+        }
+        candidates &= candidates - 1;
+    }
+    return hits;
+}
+
+// Vector string search: for each block of start offsets, compare the first byte
+// and the last character's byte of every needle at once (like memchr on two
+// bytes), then verify only the offsets where both agree. The per-needle hit masks
+// are OR-ed, so hits come out in address order.
+#if defined(__x86_64__)
+__attribute__((target("avx2")))
+inline void avx2StringScanKernel(const ScanKernel& kernel, const uint8_t* data, size_t count, std::vector<size_t>& offsets) {
+    const size_t needleCount = kernel.needles.size();
+    __m256i first[STRING_NEEDLE_MAX], firstFold[STRING_NEEDLE_MAX];
+    __m256i last[STRING_NEEDLE_MAX], lastFold[STRING_NEEDLE_MAX];
+    for (size_t i = 0; i < needleCount; i++) {
+        const StringNeedle& needle = kernel.needles[i];
+        first[i] = _mm256_set1_epi8(static_cast<char>(needle.bytes[0]));
+        firstFold[i] = _mm256_set1_epi8(static_cast<char>(needle.firstFold));
+        last[i] = _mm256_set1_epi8(static_cast<char>(needle.bytes[needle.last]));
+        lastFold[i] = _mm256_set1_epi8(static_cast<char>(needle.lastFold));
+    }
+    const uint32_t aligned = everyNthBit(kernel.alignment);
+    
+    // Blocks where even the longest needle fits; the rest goes to the tail
+    const size_t slack = kernel.valueSize - shortestMatch(kernel);
+    const size_t blocks = count > slack ? count - slack : 0;
+    size_t offset = 0;
+    for (; offset + 32 <= blocks; offset += 32) {
+        __m256i head = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + offset));
+        uint32_t mask = 0;
+        for (size_t i = 0; i < needleCount; i++) {
+            const StringNeedle& needle = kernel.needles[i];
+            __m256i tail = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + offset + needle.last));
+            __m256i hit = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_or_si256(head, firstFold[i]), first[i]),
+                                           _mm256_cmpeq_epi8(_mm256_or_si256(tail, lastFold[i]), last[i]));
+            uint32_t candidates = static_cast<uint32_t>(_mm256_movemask_epi8(hit)) & aligned;
+            if (candidates != 0) {
+                mask |= verifyStringCandidates(kernel, needle, data + offset, candidates);
+            }
+        }
+        emitMaskOffsets(mask, offset, offsets);
+    }
+    
+    stringScanRange(kernel, data, offset, count, offsets);
+}
+
+__attribute__((target("sse4.2")))
+inline void sse42StringScanKernel(const ScanKernel& kernel, const uint8_t* data, size_t count, std::vector<size_t>& offsets) {
+    const size_t needleCount = kernel.needles.size();
+    __m128i first[STRING_NEEDLE_MAX], firstFold[STRING_NEEDLE_MAX];
+    __m128i last[STRING_NEEDLE_MAX], lastFold[STRING_NEEDLE_MAX];
+    for (size_t i = 0; i < needleCount; i++) {
+        const StringNeedle& needle = kernel.needles[i];
+        first[i] = _mm_set1_epi8(static_cast<char>(needle.bytes[0]));
+        firstFold[i] = _mm_set1_epi8(static_cast<char>(needle.firstFold));
+        last[i] = _mm_set1_epi8(static_cast<char>(needle.bytes[needle.last]));
+        lastFold[i] = _mm_set1_epi8(static_cast<char>(needle.lastFold));
+    }
+    const uint32_t aligned = everyNthBit(kernel.alignment) & 0xFFFF;
+    
+    // Blocks where even the longest needle fits; the rest goes to the tail
+    const size_t slack = kernel.valueSize - shortestMatch(kernel);
+    const size_t blocks = count > slack ? count - slack : 0;
+    size_t offset = 0;
+    for (; offset + 16 <= blocks; offset += 16) {
+        __m128i head = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + offset));
+        uint32_t mask = 0;
+        for (size_t i = 0; i < needleCount; i++) {
+            const StringNeedle& needle = kernel.needles[i];
+            __m128i tail = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + offset + needle.last));
+            __m128i hit = _mm_and_si128(_mm_cmpeq_epi8(_mm_or_si128(head, firstFold[i]), first[i]),
+                                        _mm_cmpeq_epi8(_mm_or_si128(tail, lastFold[i]), last[i]));
+            uint32_t candidates = static_cast<uint32_t>(_mm_movemask_epi8(hit)) & aligned;
+            if (candidates != 0) {
+                mask |= verifyStringCandidates(kernel, needle, data + offset, candidates);
+            }
+        }
+        emitMaskOffsets(mask, offset, offsets);
+    }
+    
+    stringScanRange(kernel, data, offset, count, offsets);
+}
+#elif defined(__aarch64__)
+inline void neonStringScanKernel(const ScanKernel& kernel, const uint8_t* data, size_t count, std::vector<size_t>& offsets) {
+    const size_t needleCount = kernel.needles.size();
+    uint8x16_t first[STRING_NEEDLE_MAX], firstFold[STRING_NEEDLE_MAX];
+    uint8x16_t last[STRING_NEEDLE_MAX], lastFold[STRING_NEEDLE_MAX];
+    for (size_t i = 0; i < needleCount; i++) {
+        const StringNeedle& needle = kernel.needles[i];
+        first[i] = vdupq_n_u8(needle.bytes[0]);
+        firstFold[i] = vdupq_n_u8(needle.firstFold);
+        last[i] = vdupq_n_u8(needle.bytes[needle.last]);
+        lastFold[i] = vdupq_n_u8(needle.lastFold);
+    }
+    const uint32_t aligned = everyNthBit(kernel.alignment) & 0xFFFF;
+    
+    // Blocks where even the longest needle fits; the rest goes to the tail
+    const size_t slack = kernel.valueSize - shortestMatch(kernel);
+    const size_t blocks = count > slack ? count - slack : 0;
+    size_t offset = 0;
+    for (; offset + 16 <= blocks; offset += 16) {
+        uint8x16_t head = vld1q_u8(data + offset);
+        uint32_t mask = 0;
+        for (size_t i = 0; i < needleCount; i++) {
+            const StringNeedle& needle = kernel.needles[i];
+            uint8x16_t tail = vld1q_u8(data + offset + needle.last);
+            uint8x16_t hit = vandq_u8(vceqq_u8(vorrq_u8(head, firstFold[i]), first[i]),
+                                      vceqq_u8(vorrq_u8(tail, lastFold[i]), last[i]));
+            uint32_t candidates = neonMovemask(hit) & aligned;
+            if (candidates != 0) {
+                mask |= verifyStringCandidates(kernel, needle, data + offset, candidates);
+            }
+        }
+        emitMaskOffsets(mask, offset, offsets);
+    }
+    
+    stringScanRange(kernel, data, offset, count, offsets);
+}
+#endif
+
+inline bool stringMatchKernel(const ScanKernel& kernel, const uint8_t* current, const uint8_t*) {
+    for (const StringNeedle& needle : kernel.needles) {
+        if (stringNeedleMatches(kernel, needle, current)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+inline bool stringChangedKernel(const ScanKernel& kernel, const uint8_t* current, const uint8_t* previous) {
+    return memcmp(current, previous, kernel.valueSize) != 0;
+}
+
+inline bool stringUnchangedKernel(const ScanKernel& kernel, const uint8_t* current, const uint8_t* previous) {
+    return memcmp(current, previous, kernel.valueSize) == 0;
+}
+
+template <typename T, template <typename> class Pred>
+void bindKernel(ScanKernel& kernel, bool useSimd) {
+    kernel.scan = &typedScanKernel<T, Pred>;
+    kernel.match = &typedMatchKernel<T, Pred>;
+    if (useSimd) {
+        bindSimdKernel<T, Pred>(kernel);
+    }
+}
+
+// Pick the instantiation for a numeric type. Exact and changed/unchanged compare
+// floating point values by their bit pattern, like the memcmp they replace.
+template <template <typename> class Pred>
+bool bindNumericKernel(ScanKernel& kernel, ValueType type, bool bitwise, bool useSimd) {
+    switch (type) {
+        case ValueType::BYTE: bindKernel<uint8_t, Pred>(kernel, useSimd); return true;
+        case ValueType::INT16: bindKernel<int16_t, Pred>(kernel, useSimd); return true;
+        case ValueType::INT32: bindKernel<int32_t, Pred>(kernel, useSimd); return true;
+        case ValueType::INT64: bindKernel<int64_t, Pred>(kernel, useSimd); return true;
+        case ValueType::FLOAT:
+            if (bitwise) {
+                bindKernel<uint32_t, Pred>(kernel, useSimd);
+            } else {
+                bindKernel<float, Pred>(kernel, useSimd);
+            }
+            return true;
+        case ValueType::DOUBLE:
+            if (bitwise) {
+                bindKernel<uint64_t, Pred>(kernel, useSimd);
+            } else {
+                bindKernel<double, Pred>(kernel, useSimd);
+            }
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Natural alignment of a value type (strings are byte aligned)
+inline size_t naturalAlignment(ValueType type) {
+    switch (type) {
+        case ValueType::INT16: return 2;
+        case ValueType::INT32: return 4;
+        case ValueType::INT64: return 8;
+        case ValueType::FLOAT: return 4;
+        case ValueType::DOUBLE: return 8;
+        case ValueType::STRING16: return 2;
+        default: return 1;
+    }
+}
+
+// Turn an encoded value into the bounds [value - epsilon, value + epsilon] of its
+// own type. Integer bounds are rounded inwards and clamped to the range of the type.
+template <typename T>
+inline void approxBounds(std::vector<uint8_t>& lower, std::vector<uint8_t>& upper, double epsilon) {
+    T value = loadValue<T>(lower.data());
+    T low;
+    T high;
+    if constexpr (std::is_floating_point<T>::value) {
+        low = static_cast<T>(value - epsilon);
+        high = static_cast<T>(value + epsilon);
+    } else {
+        long double first = std::ceil(static_cast<long double>(value) - epsilon);
+        long double last = std::floor(static_cast<long double>(value) + epsilon);
+        low = first <= static_cast<long double>(std::numeric_limits<T>::min()) ? std::numeric_limits<T>::min() : static_cast<T>(first);
+        high = last >= static_cast<long double>(std::numeric_limits<T>::max()) ? std::numeric_limits<T>::max() : static_cast<T>(last);
+    }
+    lower.resize(sizeof(T));
+    upper.resize(sizeof(T));
+    memcpy(lower.data(), &low, sizeof(T));
+    memcpy(upper.data(), &high, sizeof(T));
+}
+
+// Resolve a string search for one or more encoded needles
+inline bool makeStringKernel(ValueType type, const std::vector<std::vector<uint8_t>>& needles, bool foldCase,
+                             ScanKernel& kernel, bool useSimd = true, size_t alignment = 0) {
+    kernel.comparison = foldCase ? COMPARE_NOCASE : COMPARE_EXACT;
+    kernel.alignment = alignment > 0 ? alignment : naturalAlignment(type);
+    kernel.charSize = type == ValueType::STRING16 ? 2 : 1;
+    kernel.foldCase = foldCase;
+    kernel.valueSize = 0;
+    kernel.needles.clear();
+    kernel.scan = nullptr;
+    kernel.match = nullptr;
+    if (!isStringType(type) || needles.empty() || needles.size() > STRING_NEEDLE_MAX) {
+        return false;
+    }
+    
+    for (const std::vector<uint8_t>& bytes : needles) {
+        if (bytes.size() < kernel.charSize) {
+            return false;
+        }
+        StringNeedle needle;
+        needle.bytes = bytes;
+        needle.last = bytes.size() - kernel.charSize;
+        if (foldCase) {
+            for (size_t i = 0; i < needle.bytes.size(); i += kernel.charSize) {
+                needle.bytes[i] = foldAscii(needle.bytes[i]);
+            }
+        }
+        auto isLetter = [](uint8_t c) { return c >= 'a' && c <= 'z'; };
+        needle.firstFold = foldCase && isLetter(needle.bytes[0]) ? 0x20 : 0;
+        needle.lastFold = foldCase && isLetter(needle.bytes[needle.last]) ? 0x20 : 0;
+        kernel.valueSize = std::max(kernel.valueSize, bytes.size());
+        kernel.needles.push_back(needle);
+    }
+    kernel.operand = needles[0];
+    
+    kernel.scan = &stringScanKernel;
+    kernel.match = &stringMatchKernel;
+    if (useSimd) {
+#if defined(__x86_64__)
+        if (simdLevel() == SIMD_AVX2) {
+            kernel.scan = &avx2StringScanKernel;
+        } else if (simdLevel() == SIMD_SSE42) {
+            kernel.scan = &sse42StringScanKernel;
+        }
+#elif defined(__aarch64__)
+        kernel.scan = &neonStringScanKernel;
+#endif
+    }
+    return true;
+}
+
+// Resolve a kernel for the given type, comparison and encoded operand. For
+// between, the operand is the lower bound followed by the upper bound.
+// An alignment of 0 selects the natural alignment of the type.
+inline bool makeScanKernel(ValueType type, Comparison comparison, const std::vector<uint8_t>& operand,
+                           ScanKernel& kernel, bool useSimd = true, size_t alignment = 0) {
+    kernel.comparison = comparison;
+    kernel.valueSize = comparisonTakesRange(comparison) ? operand.size() / 2 : operand.size();
+    kernel.alignment = alignment > 0 ? alignment : naturalAlignment(type);
+    kernel.operand = operand;
+    kernel.charSize = 1;
+    kernel.foldCase = false;
+    kernel.scan = nullptr;
+    kernel.match = nullptr;
+    
+    if (isStringType(type)) {
+        switch (comparison) {
+            case COMPARE_EXACT:
+            case COMPARE_NOCASE:
+                return makeStringKernel(type, std::vector<std::vector<uint8_t>>(1, operand), comparison == COMPARE_NOCASE,
+                                        kernel, useSimd, alignment);
+            case COMPARE_CHANGED:
+                kernel.match = &stringChangedKernel;
+                return true;
+            case COMPARE_UNCHANGED:
+                kernel.match = &stringUnchangedKernel;
+                return true;
+            default:
+                return false;
+        }
+    }
+    
+    switch (comparison) {
+        case COMPARE_EXACT: return bindNumericKernel<EqualTo>(kernel, type, true, useSimd);
+        case COMPARE_GREATER: return bindNumericKernel<GreaterThan>(kernel, type, false, useSimd);
+        case COMPARE_LESS: return bindNumericKernel<LessThan>(kernel, type, false, useSimd);
+        case COMPARE_BETWEEN:
+        case COMPARE_APPROX: return bindNumericKernel<InRange>(kernel, type, false, useSimd);
+        case COMPARE_CHANGED: return bindNumericKernel<ChangedFrom>(kernel, type, true, useSimd);
+        case COMPARE_UNCHANGED: return bindNumericKernel<UnchangedFrom>(kernel, type, true, useSimd);
+        case COMPARE_INCREASED: return bindNumericKernel<IncreasedFrom>(kernel, type, false, useSimd);
+        case COMPARE_DECREASED: return bindNumericKernel<DecreasedFrom>(kernel, type, false, useSimd);
+        case COMPARE_NOCASE: return false;
+    }
+    return false;
+}
+
+// One value of a group scan. Every member but the first must start within
+// `within` bytes of the first one, before or after it; members don't overlap.
+struct GroupMember {
+    ValueType type;
+    Comparison comparison;
+    std::string value;
+    size_t within;
+};
+
+// Group scans take 2 to GROUP_MEMBERS_MAX numeric values, at most
+// GROUP_WITHIN_MAX bytes from the first (GROUP_WITHIN_DEFAULT if not given)
+const size_t GROUP_MEMBERS_MAX = 8;
+const size_t GROUP_WITHIN_MAX = 4096;
+const size_t GROUP_WITHIN_DEFAULT = 64;
+
+// The anchor of a group scan is picked by counting each member's hits in up to
+// GROUP_SAMPLE_CHUNKS pieces of GROUP_SAMPLE_BYTES spread over the memory to scan
+const size_t GROUP_SAMPLE_CHUNKS = 16;
+const size_t GROUP_SAMPLE_BYTES = 64 * 1024;
+
+// A slice of a memory region handed to one scan worker
+struct ScanChunk {
+    size_t region;
+    mach_vm_address_t start;
+    mach_vm_size_t size;
+};
+
+// Regions larger than this are split so the work spreads across the pool
+const mach_vm_size_t SCAN_CHUNK_SIZE = 16 * 1024 * 1024;
+
+// Size of the reusable window each worker streams target memory through
+const size_t SCAN_WINDOW_SIZE = 2 * 1024 * 1024;
+
+// Maps a range of the target's pages into our own address space with
+// mach_vm_remap so the scanner can read them in place instead of copying.
+// The pages are shared, not copied; unmap() releases our view of them.
+class TargetMapping {
+private:
+    mach_vm_address_t localAddress;
+    mach_vm_address_t remoteAddress;
+    mach_vm_size_t length;
+    
+public:
+    TargetMapping() : localAddress(0), remoteAddress(0), length(0) {}
+    
+    ~TargetMapping() {
+        unmap();
+    }
+    
+    TargetMapping(const TargetMapping&) = delete;
+    TargetMapping& operator=(const TargetMapping&) = delete;
+    
+    bool map(task_t task, mach_vm_address_t address, mach_vm_size_t size) {
+        unmap();
+        
+        mach_vm_address_t local = 0;
+        vm_prot_t currentProtection = VM_PROT_NONE;
+        vm_prot_t maxProtection = VM_PROT_NONE;
+        threadStats().add(STAT_REMAP_CALLS, 1);
+        kern_return_t kr = mach_vm_remap(mach_task_self(), &local, size, 0,
+                                         VM_FLAGS_ANYWHERE | VM_FLAGS_RETURN_DATA_ADDR,
+                                         task, address, FALSE,
+                                         &currentProtection, &maxProtection, VM_INHERIT_NONE);
+        if (kr != KERN_SUCCESS) {
+            return false;
+        }
+        
+        localAddress = local;
+        remoteAddress = address;
+        length = size;
+        
+        if ((currentProtection & VM_PROT_READ) == 0) {
+            unmap();
+            return false;
+        }
+        return true;
+    }
+    
+    void unmap() {
+        if (length > 0) {
+            mach_vm_deallocate(mach_task_self(), localAddress, length);
+            localAddress = 0;
+            remoteAddress = 0;
+            length = 0;
+        }
+    }
+    
+    bool contains(mach_vm_address_t address, size_t size) const {
+        return length > 0 && address >= remoteAddress && address + size <= remoteAddress + length;
+    }
+    
+    const uint8_t* at(mach_vm_address_t address) const {
+        return reinterpret_cast<const uint8_t*>(localAddress + (address - remoteAddress));
+    }
+};
+
+// Streams a range of target memory through one reusable fixed-size window.
+// Consecutive windows overlap so values that straddle a window boundary are
+// still seen, and a page that can't be read only drops that page.
+// In zero-copy mode each range is mapped and scanned in place instead, falling
+// back to the copying window if the pages can't be remapped.
+class RegionReader {
+private:
+    task_t task;
+    bool zeroCopy;
+    std::vector<uint8_t> window;
+    TargetMapping mapping;
+    
+    bool readBlock(mach_vm_address_t address, uint8_t* buffer, size_t size) {
+        return readTargetMemory(task, address, buffer, size);
+    }
+    
+public:
+    explicit RegionReader(task_t targetTask, bool useZeroCopy = false, size_t windowSize = SCAN_WINDOW_SIZE)
+        : task(targetTask), zeroCopy(useZeroCopy), window(windowSize) {}
+    
+    // Deliver [start, start + size) to fn(data, length, startLimit, address).
+    // Matches may only start in the first startLimit bytes of each delivery; up to
+    // overlap extra bytes (never past readEnd) follow so boundary values are complete.
+    template <typename Fn>
+    void stream(mach_vm_address_t start, mach_vm_size_t size, mach_vm_address_t readEnd,
+                size_t overlap, Fn&& fn) {
+        if (overlap >= window.size()) {
+            return;
+        }
+        
+        mach_vm_address_t end = start + size;
+        mach_vm_address_t position = start;
+        
+        if (zeroCopy) {
+            size_t length = static_cast<size_t>(std::min<mach_vm_address_t>(end + overlap, readEnd) - start);
+            if (mapping.map(task, start, length)) {
+                fn(mapping.at(start), length, static_cast<size_t>(size), start);
+                mapping.unmap();
+                return;
+            }
+        }
+        
+        while (position < end) {
+            size_t step = static_cast<size_t>(std::min<mach_vm_address_t>(window.size() - overlap, end - position));
+            size_t length = static_cast<size_t>(std::min<mach_vm_address_t>(step + overlap, readEnd - position));
+            fetch(window.data(), position, length, step, fn);
+            position += step;
+        }
+    }
+    
+    // Read one window of length bytes at position into buffer and deliver it as
+    // stream() does, with matches starting in its first step bytes. A window that
+    // fails to read is fetched again page by page.
+    template <typename Fn>
+    void fetch(uint8_t* buffer, mach_vm_address_t position, size_t length, size_t step, Fn&& fn) {
+        if (readBlock(position, buffer, length)) {
+            fn(buffer, length, step, position);
+        } else {
+            streamPages(buffer, position, length, step, fn);
+        }
+    }
+    
+private:
+    // Slow path for a window that failed to read: fetch it page by page and hand
+    // each readable run to fn on its own.
+    template <typename Fn>
+    void streamPages(uint8_t* buffer, mach_vm_address_t position, size_t length, size_t step, Fn&& fn) {
+        mach_vm_address_t pageSize = vm_page_size;
+        size_t runStart = 0;
+        size_t offset = 0;
+        bool inRun = false;
+        
+        while (offset < length) {
+            mach_vm_address_t address = position + offset;
+            size_t chunk = static_cast<size_t>(std::min<mach_vm_address_t>(pageSize - (address % pageSize), length - offset));
+            bool readable = readBlock(address, buffer + offset, chunk);
+            
+            if (readable && !inRun) {
+                runStart = offset;
+                inRun = true;
+            } else if (!readable && inRun) {
+                if (runStart < step) {
+                    fn(buffer + runStart, offset - runStart, std::min(step, offset) - runStart, position + runStart);
+                }
+                inRun = false;
+            }
+            offset += chunk;
+        }
+        
+        if (inRun && runStart < step) {
+            fn(buffer + runStart, length - runStart, step - runStart, position + runStart);
+        }
+    }
+};
+
+// Hash of one page of memory, eight bytes at a time
+inline uint64_t hashPage(const uint8_t* data, size_t size) {
+    uint64_t hash = 0x9E3779B97F4A7C15ull ^ size;
+    size_t offset = 0;
+    for (; offset + 8 <= size; offset += 8) {
+        hash ^= loadValue<uint64_t>(data + offset);
+        hash *= 0xFF51AFD7ED558CCDull;
+        hash ^= hash >> 32;
+    }
+    for (; offset < size; offset++) {
+        hash = (hash ^ data[offset]) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+inline bool isZeroPage(const uint8_t* data, size_t size) {
+    size_t offset = 0;
+    for (; offset + 8 <= size; offset += 8) {
+        if (loadValue<uint64_t>(data + offset) != 0) {
+            return false;
+        }
+    }
+    for (; offset < size; offset++) {
+        if (data[offset] != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Compressed store for memory snapshots. Identical pages are kept once (found
+// by hash and verified by content) and all-zero pages aren't stored at all.
+// Pages live on the heap, or in blocks mapped from an unlinked file so that
+// stores larger than RAM are paged out to disk instead of swapped.
+// add() is thread-safe; page() must not race with add().
+class PageStore {
+public:
+    static constexpr uint32_t ZERO_PAGE = 0xFFFFFFFFu;
+    static constexpr uint32_t NO_PAGE = 0xFFFFFFFEu;
+    
+private:
+    static constexpr size_t PAGES_PER_BLOCK = 256;
+    
+    size_t pageBytes;
+    int backingFile;
+    std::mutex lock;
+    std::vector<uint8_t*> blocks;
+    std::vector<bool> mappedBlocks;
+    std::vector<uint64_t> hashes;
+    std::unordered_multimap<uint64_t, uint32_t> index;
+    uint32_t count;
+    
+    uint8_t* slot(uint32_t id) const {
+        return blocks[id / PAGES_PER_BLOCK] + (id % PAGES_PER_BLOCK) * pageBytes;
+    }
+    
+    size_t blockBytes() const { return PAGES_PER_BLOCK * pageBytes; }
+    
+    // Grow the file by one block and map it; a block that can't be mapped goes on the heap
+    void addBlock() {
+        if (backingFile >= 0) {
+            off_t offset = static_cast<off_t>(blocks.size() * blockBytes());
+            if (ftruncate(backingFile, offset + static_cast<off_t>(blockBytes())) == 0) {
+                void* mapped = mmap(nullptr, blockBytes(), PROT_READ | PROT_WRITE, MAP_SHARED, backingFile, offset);
+                if (mapped != MAP_FAILED) {
+                    blocks.push_back(static_cast<uint8_t*>(mapped));
+                    mappedBlocks.push_back(true);
+                    return;
+                }
+            }
+        }
+        blocks.push_back(new uint8_t[blockBytes()]);
+        mappedBlocks.push_back(false);
+    }
+    
+public:
+    explicit PageStore(size_t pageSize) : pageBytes(pageSize), backingFile(-1), count(0) {}
+    
+    ~PageStore() {
+        for (size_t i = 0; i < blocks.size(); i++) {
+            if (mappedBlocks[i]) {
+                munmap(blocks[i], blockBytes());
+            } else {
+                delete[] blocks[i];
+            }
+        }
+        if (backingFile >= 0) {
+            close(backingFile);
+        }
+    }
+    
+    PageStore(const PageStore&) = delete;
+    PageStore& operator=(const PageStore&) = delete;
+    
+    // Keep the pages in a file under directory; call before the first add(). The
+    // file is unlinked right away, so it goes away with the store (or the process).
+    bool backWithFile(const std::string& directory) {
+        std::string path = directory + "/macmemory-snapshot-XXXXXX";
+        std::vector<char> name(path.begin(), path.end());
+        name.push_back('\0');
+        int fd = mkstemp(name.data());
+        if (fd < 0) {
+            return false;
+        }
+        unlink(name.data());
+        backingFile = fd;
+        return true;
+    }
+    
+    bool fileBacked() const { return backingFile >= 0; }
+    
+    // Store one page and return its id
+    uint32_t add(const uint8_t* data) {
+        if (isZeroPage(data, pageBytes)) {
+            return ZERO_PAGE;
+        }
+        return addHashed(data, hashPage(data, pageBytes));
+    }
+    
+    // Store a non-zero page whose hash is already known (such as one carried
+    // over from an earlier snapshot)
+    uint32_t addHashed(const uint8_t* data, uint64_t hash) {
+        std::lock_guard<std::mutex> guard(lock);
+        
+        auto range = index.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (memcmp(slot(it->second), data, pageBytes) == 0) {
+                return it->second;
+            }
+        }
+        
+        if (count % PAGES_PER_BLOCK == 0) {
+            addBlock();
+        }
+        uint32_t id = count++;
+        memcpy(slot(id), data, pageBytes);
+        hashes.push_back(hash);
+        index.insert(std::make_pair(hash, id));
+        return id;
+    }
+    
+    uint64_t pageHash(uint32_t id) const { return hashes[id]; }
+    
+    // Page contents, or nullptr for ZERO_PAGE / NO_PAGE
+    const uint8_t* page(uint32_t id) const {
+        return id < count ? slot(id) : nullptr;
+    }
+    
+    size_t pageSize() const { return pageBytes; }
+    size_t storedPages() const { return count; }
+    size_t storedBytes() const { return static_cast<size_t>(count) * pageBytes; }
+};
+
+// Snapshot diffs compare pages in blocks of 64 bytes; a mask has one bit per byte,
+// set where the two pages differ
+const size_t DIFF_BLOCK = 64;
+
+inline void scalarDiffMasks(const uint8_t* a, const uint8_t* b, size_t size, uint64_t* masks) {
+    for (size_t block = 0; block * DIFF_BLOCK < size; block++) {
+        uint64_t mask = 0;
+        for (size_t word = 0; word < DIFF_BLOCK / 8; word++) {
+            size_t offset = block * DIFF_BLOCK + word * 8;
+            uint64_t x = loadValue<uint64_t>(a + offset) ^ loadValue<uint64_t>(b + offset);
+            for (size_t byte = 0; x != 0 && byte < 8; byte++, x >>= 8) {
+                if (x & 0xFF) {
+                    mask |= 1ull << (word * 8 + byte);
+                }
+            }
+        }
+        masks[block] = mask;
+    }
+}
+
+#if defined(__x86_64__)
+__attribute__((target("avx2")))
+inline void avx2DiffMasks(const uint8_t* a, const uint8_t* b, size_t size, uint64_t* masks) {
+    for (size_t block = 0; block * DIFF_BLOCK < size; block++) {
+        const uint8_t* left = a + block * DIFF_BLOCK;
+        const uint8_t* right = b + block * DIFF_BLOCK;
+        __m256i low = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(left)),
+                                        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(right)));
+        __m256i high = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(left + 32)),
+                                         _mm256_loadu_si256(reinterpret_cast<const __m256i*>(right + 32)));
+        uint64_t equal = static_cast<uint32_t>(_mm256_movemask_epi8(low)) |
+                         (static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(high))) << 32);
+        masks[block] = ~equal;
+    }
+}
+
+__attribute__((target("sse4.2")))
+inline void sse42DiffMasks(const uint8_t* a, const uint8_t* b, size_t size, uint64_t* masks) {
+    for (size_t block = 0; block * DIFF_BLOCK < size; block++) {
+        uint64_t equal = 0;
+        for (size_t lane = 0; lane < DIFF_BLOCK / 16; lane++) {
+            size_t offset = block * DIFF_BLOCK + lane * 16;
+            __m128i same = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + offset)),
+                                          _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + offset)));
+            equal |= static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(same))) << (lane * 16);
+        }
+        masks[block] = ~equal;
+    }
+}
+#elif defined(__aarch64__)
+inline void neonDiffMasks(const uint8_t* a, const uint8_t* b, size_t size, uint64_t* masks) {
+    for (size_t block = 0; block * DIFF_BLOCK < size; block++) {
+        uint64_t changed = 0;
+        for (size_t lane = 0; lane < DIFF_BLOCK / 16; lane++) {
+            size_t offset = block * DIFF_BLOCK + lane * 16;
+            uint8x16_t same = vceqq_u8(vld1q_u8(a + offset), vld1q_u8(b + offset));
+            // Most blocks of a changed page are still equal; skip the movemask for those
+            if (vminvq_u8(same) != 0xFF) {
+                changed |= static_cast<uint64_t>(neonMovemask(vmvnq_u8(same))) << (lane * 16);
+            }
+        }
+        masks[block] = changed;
+    }
+}
+#endif
+
+// Byte masks of two pages (size a multiple of DIFF_BLOCK), with the vector kernel when there is one
+inline void diffMasks(const uint8_t* a, const uint8_t* b, size_t size, uint64_t* masks, bool useSimd) {
+    if (useSimd) {
+#if defined(__x86_64__)
+        if (simdLevel() == SIMD_AVX2) {
+            avx2DiffMasks(a, b, size, masks);
+            return;
+        }
+        if (simdLevel() == SIMD_SSE42) {
+            sse42DiffMasks(a, b, size, masks);
+            return;
+        }
+#elif defined(__aarch64__)
+        neonDiffMasks(a, b, size, masks);
+        return;
+#endif
+    }
+    scalarDiffMasks(a, b, size, masks);
+}
+
+// Widen a byte mask to whole aligned values of width bytes (1, 2, 4 or 8): every
+// byte of a value is set if any of them is
+inline uint64_t widenDiffMask(uint64_t mask, size_t width) {
+    static const uint64_t lowBits[9] = { 0, ~0ull, 0x5555555555555555ull, 0, 0x1111111111111111ull, 0, 0, 0, 0x0101010101010101ull };
+    if (width <= 1) {
+        return mask;
+    }
+    for (size_t shift = 1; shift < width; shift <<= 1) {
+        mask |= mask >> shift;
+    }
+    return (mask & lowBits[width]) * ((1ull << width) - 1);
+}
+
+// A run of changed bytes between two snapshots
+struct DiffRange {
+    mach_vm_address_t start;
+    mach_vm_size_t size;
+};
+
+// The pages of one region in a snapshot
+struct SnapshotRegion {
+    mach_vm_address_t start;
+    mach_vm_size_t size;
+    uint32_t tags;
+    std::vector<uint32_t> pages;
+};
+
+// A copy of the selected regions at one point in time. All snapshots of a
+// session share one PageStore, so pages that didn't change between them are
+// stored once and compare equal by id.
+struct MemorySnapshot {
+    uint32_t id;
+    std::string name;
+    std::chrono::steady_clock::time_point taken;
+    std::vector<SnapshotRegion> regions;
+    uint64_t bytes;
+};
+
+// Candidates of an "unknown initial value" scan for one region: one bit per
+// aligned slot, plus the snapshot page ids the next pass compares against.
+struct CandidateRegion {
+    mach_vm_address_t start;
+    mach_vm_size_t size;
+    std::vector<uint64_t> bits;
+    std::vector<uint32_t> pages;
+    size_t candidates;
+};
+
+// Bitmap-based candidate set used until an unknown-value search gets small
+// enough to materialize as a ResultStore
+struct BitmapScan {
+    ValueType type;
+    size_t valueSize;
+    size_t alignment;
+    std::vector<CandidateRegion> regions;
+    std::unique_ptr<PageStore> snapshot;
+    size_t candidates;
+};
+
+// Number of aligned value slots in a region
+inline size_t candidateSlots(mach_vm_size_t size, size_t valueSize, size_t alignment) {
+    return size >= valueSize ? static_cast<size_t>((size - valueSize) / alignment + 1) : 0;
+}
+
+// Set or clear the bits [first, last)
+inline void fillBits(std::vector<uint64_t>& bits, size_t first, size_t last, bool value) {
+    for (size_t bit = first; bit < last; ) {
+        size_t word = bit / 64;
+        size_t low = bit % 64;
+        size_t high = std::min<size_t>(64, low + (last - bit));
+        uint64_t mask = (high == 64 ? ~0ull : ((1ull << high) - 1)) & ~((1ull << low) - 1);
+        if (value) {
+            bits[word] |= mask;
+        } else {
+            bits[word] &= ~mask;
+        }
+        bit += high - low;
+    }
+}
+
+// Visit each set bit in [first, last) and clear the ones keep() rejects.
+// Returns the number of bits still set.
+template<typename Keep>
+inline size_t filterBits(std::vector<uint64_t>& bits, size_t first, size_t last, Keep keep) {
+    size_t kept = 0;
+    for (size_t bit = first; bit < last; ) {
+        size_t word = bit / 64;
+        size_t low = bit % 64;
+        size_t high = std::min<size_t>(64, low + (last - bit));
+        uint64_t mask = (high == 64 ? ~0ull : ((1ull << high) - 1)) & ~((1ull << low) - 1);
+        uint64_t pending = bits[word] & mask;
+        while (pending) {
+            size_t index = word * 64 + __builtin_ctzll(pending);
+            pending &= pending - 1;
+            if (keep(index)) {
+                kept++;
+            } else {
+                bits[word] &= ~(1ull << (index % 64));
+            }
+        }
+        bit += high - low;
+    }
+    return kept;
+}
+
+inline size_t countBits(const std::vector<uint64_t>& bits) {
+    size_t count = 0;
+    for (uint64_t word : bits) {
+        count += __builtin_popcountll(word);
+    }
+    return count;
+}
+
+// How next scans over a candidate bitmap treat pages that didn't change since the
+// previous pass. RESCAN_DIRTY settles them from the snapshot (and skips reading
+// pages that were never touched); RESCAN_FULL compares every slot of every page.
+enum RescanMode {
+    RESCAN_DIRTY,
+    RESCAN_FULL
+};
+
+// Nearby pages that need reading are fetched together across gaps of this many pages
+const size_t RESCAN_MERGE_PAGES = 8;
+
+// Unknown-value searches switch to an address list below this many candidates
+const size_t BITMAP_LIST_THRESHOLD = 1 << 20;
+
+// Largest value a watch can hold (string watches cover this many bytes)
+const size_t WATCH_VALUE_MAX = 32;
+
+// freeze all refuses result sets larger than this
+const size_t FREEZE_RESULTS_MAX = 100000;
+
+// Single-producer/single-consumer ring buffer. push() and pop() never block;
+// push() fails when the ring is full.
+template <typename T, size_t Capacity>
+class SpscRing {
+    static_assert((Capacity & (Capacity - 1)) == 0, "ring capacity must be a power of two");
+    
+private:
+    std::unique_ptr<T[]> items;
+    std::atomic<size_t> head;
+    std::atomic<size_t> tail;
+    
+public:
+    SpscRing() : items(new T[Capacity]), head(0), tail(0) {}
+    
+    bool push(const T& item) {
+        size_t position = tail.load(std::memory_order_relaxed);
+        if (position - head.load(std::memory_order_acquire) == Capacity) {
+            return false;
+        }
+        items[position & (Capacity - 1)] = item;
+        tail.store(position + 1, std::memory_order_release);
+        return true;
+    }
+    
+    bool pop(T& item) {
+        size_t position = head.load(std::memory_order_relaxed);
+        if (position == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = items[position & (Capacity - 1)];
+        head.store(position + 1, std::memory_order_release);
+        return true;
+    }
+};
+
+// A watched address as reported to the CLI
+struct WatchInfo {
+    uint32_t id;
+    mach_vm_address_t address;
+    ValueType type;
+    size_t size;
+    double intervalMs;
+    uint8_t value[WATCH_VALUE_MAX];
+    bool readable;
+    uint64_t changes;
+};
+
+// A value change seen by the watch engine
+struct WatchEvent {
+    uint32_t id;
+    mach_vm_address_t address;
+    ValueType type;
+    size_t size;
+    uint8_t oldValue[WATCH_VALUE_MAX];
+    uint8_t newValue[WATCH_VALUE_MAX];
+    bool readable;
+};
+
+// A value held in place by the freeze engine
+struct FreezeInfo {
+    uint32_t id;
+    mach_vm_address_t address;
+    ValueType type;
+    size_t size;
+    uint8_t value[WATCH_VALUE_MAX];
+    uint64_t rewrites;
+};
+
+// Polls a set of watched addresses on a background thread. Each tick, due watches
+// on the same or adjacent pages are fetched with one read; changes are pushed to
+// an event ring the CLI drains between commands.
+// The same thread keeps frozen values in place: at the freeze rate all of them
+// are read the same way, and only the ones that drifted are written back, one
+// write per page.
+// The thread reads and writes copies of the due entries without holding the
+// lock, so watch and freeze calls don't wait for a pass, and merges them back.
+// An entry removed meanwhile may see one last read or write.
+class WatchEngine {
+private:
+    struct Watch {
+        WatchInfo info;
+        std::chrono::steady_clock::duration interval;
+        std::chrono::steady_clock::time_point due;
+    };
+    
+    struct Freeze {
+        FreezeInfo info;
+    };
+    
+    // Waits shorter than this are spun instead of slept, for sub-millisecond intervals
+    static constexpr int64_t SPIN_WAIT_NS = 200000;
+    // Adjacent due pages are read together up to this many bytes
+    static constexpr size_t MAX_READ_SPAN = 64 * 1024;
+    static constexpr size_t EVENT_CAPACITY = 4096;
+    
+    task_t task;
+    std::vector<Watch> watches;
+    std::vector<Freeze> freezes;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::thread thread;
+    bool stopping;
+    uint32_t nextId;
+    uint32_t nextFreezeId;
+    std::chrono::steady_clock::duration freezeInterval;
+    std::chrono::steady_clock::time_point freezeDue;
+    SpscRing<WatchEvent, EVENT_CAPACITY> events;
+    std::atomic<size_t> dropped;
+    std::atomic<uint64_t> freezeWrites;
+    // Bumped whenever a watch or freeze is added or removed
+    uint64_t generation;
+    // Owned by the thread: the copies of one pass and where they came from
+    task_t tickTask;
+    std::vector<Watch> tickWatches;
+    std::vector<Freeze> tickFreezes;
+    std::vector<size_t> tickPositions;
+    std::vector<uint8_t> buffer;
+    std::vector<size_t> due;
+    std::vector<ValueWrite> pendingWrites;
+    std::vector<uint8_t> writeScratch;
+    
+    bool readBlock(mach_vm_address_t address, uint8_t* data, size_t size) {
+        mach_vm_size_t dataSize = 0;
+        kern_return_t kr = mach_vm_read_overwrite(tickTask, address, size, (mach_vm_address_t)data, &dataSize);
+        return kr == KERN_SUCCESS && dataSize == size;
+    }
+    
+    void startThread() {
+        if (!thread.joinable()) {
+            stopping = false;
+            thread = std::thread(&WatchEngine::loop, this);
+        }
+        wake.notify_one();
+    }
+    
+    void loop() {
+        std::unique_lock<std::mutex> guard(lock);
+        while (!stopping) {
+            if (watches.empty() && freezes.empty()) {
+                wake.wait(guard);
+                continue;
+            }
+            
+            std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            tickWatches.clear();
+            tickPositions.clear();
+            for (size_t i = 0; i < watches.size(); i++) {
+                if (watches[i].due <= now) {
+                    tickWatches.push_back(watches[i]);
+                    tickPositions.push_back(i);
+                }
+            }
+            bool freezing = !freezes.empty() && freezeDue <= now;
+            tickFreezes.clear();
+            if (freezing) {
+                tickFreezes = freezes;
+                freezeDue += freezeInterval;
+                if (freezeDue <= now) {
+                    freezeDue = now + freezeInterval;
+                }
+            }
+            tickTask = task;
+            uint64_t seen = generation;
+            
+            guard.unlock();
+            tick(now);
+            if (freezing) {
+                freezeTick();
+            }
+            guard.lock();
+            
+            merge(watches, tickWatches, &tickPositions, seen);
+            if (freezing) {
+                merge(freezes, tickFreezes, nullptr, seen);
+            }
+            
+            std::chrono::steady_clock::time_point next = freezes.empty() ? std::chrono::steady_clock::time_point::max() : freezeDue;
+            for (const Watch& watch : watches) {
+                next = std::min(next, watch.due);
+            }
+            
+            auto wait = next - std::chrono::steady_clock::now();
+            if (wait > std::chrono::nanoseconds(SPIN_WAIT_NS)) {
+                wake.wait_until(guard, next);
+            } else if (wait > std::chrono::steady_clock::duration::zero()) {
+                guard.unlock();
+                while (std::chrono::steady_clock::now() < next) {
+                    std::this_thread::yield();
+                }
+                guard.lock();
+            }
+        }
+    }
+    
+    // Read the entries due lists (indices into entries, which are sorted by
+    // address) with one read per span of touching pages, and call
+    // fn(entry, current bytes or nullptr if unreadable) for each
+    template <typename Entry, typename Fn>
+    void readDue(std::vector<Entry>& entries, Fn fn) {
+        mach_vm_address_t pageSize = vm_page_size;
+        
+        // Entries are sorted by address, so due entries on touching pages are adjacent
+        for (size_t first = 0; first < due.size(); ) {
+            const auto& head = entries[due[first]].info;
+            mach_vm_address_t start = head.address & ~(pageSize - 1);
+            mach_vm_address_t end = (head.address + head.size + pageSize - 1) & ~(pageSize - 1);
+            size_t last = first + 1;
+            for (; last < due.size(); last++) {
+                const auto& info = entries[due[last]].info;
+                mach_vm_address_t pageEnd = (info.address + info.size + pageSize - 1) & ~(pageSize - 1);
+                if ((info.address & ~(pageSize - 1)) > end || pageEnd - start > MAX_READ_SPAN) {
+                    break;
+                }
+                end = std::max(end, pageEnd);
+            }
+            
+            buffer.resize(static_cast<size_t>(end - start));
+            bool spanRead = readBlock(start, buffer.data(), buffer.size());
+            for (size_t i = first; i < last; i++) {
+                Entry& entry = entries[due[i]];
+                uint8_t* current = buffer.data() + (entry.info.address - start);
+                bool readable = spanRead || readBlock(entry.info.address, current, entry.info.size);
+                fn(entry, readable ? current : nullptr);
+            }
+            first = last;
+        }
+    }
+    
+    // Put the copies of a pass back in place: at the positions they were copied
+    // from (all of entries when positions is null), or by id when watches or
+    // freezes came or went during the pass
+    template <typename Entry>
+    void merge(std::vector<Entry>& entries, const std::vector<Entry>& copies, const std::vector<size_t>* positions, uint64_t seen) {
+        if (generation == seen) {
+            for (size_t i = 0; i < copies.size(); i++) {
+                entries[positions ? (*positions)[i] : i] = copies[i];
+            }
+            return;
+        }
+        std::unordered_map<uint32_t, size_t> byId;
+        for (size_t i = 0; i < entries.size(); i++) {
+            byId[entries[i].info.id] = i;
+        }
+        for (const Entry& copy : copies) {
+            auto it = byId.find(copy.info.id);
+            if (it != byId.end()) {
+                entries[it->second] = copy;
+            }
+        }
+    }
+    
+    // Read the copied due watches and report the ones that changed
+    void tick(std::chrono::steady_clock::time_point now) {
+        due.resize(tickWatches.size());
+        for (size_t i = 0; i < due.size(); i++) {
+            due[i] = i;
+        }
+        
+        readDue(tickWatches, [&](Watch& watch, const uint8_t* current) {
+            update(watch, current);
+            
+            // Skip missed ticks instead of bursting to catch up
+            watch.due += watch.interval;
+            if (watch.due <= now) {
+                watch.due = now + watch.interval;
+            }
+        });
+    }
+    
+    // Read the copied frozen values and write back the ones that drifted.
+    // Unreadable values are left alone until their page is readable again.
+    void freezeTick() {
+        due.resize(tickFreezes.size());
+        for (size_t i = 0; i < due.size(); i++) {
+            due[i] = i;
+        }
+        
+        pendingWrites.clear();
+        readDue(tickFreezes, [&](Freeze& freeze, const uint8_t* current) {
+            if (current && memcmp(current, freeze.info.value, freeze.info.size) != 0) {
+                pendingWrites.push_back({ freeze.info.address, freeze.info.value, freeze.info.size });
+                freeze.info.rewrites++;
+            }
+        });
+        
+        size_t calls = 0;
+        writeTargetValues(tickTask, pendingWrites, writeScratch, calls);
+        freezeWrites.fetch_add(calls, std::memory_order_relaxed);
+    }
+    
+    void update(Watch& watch, const uint8_t* current) {
+        WatchInfo& info = watch.info;
+        bool readable = current != nullptr;
+        if (readable == info.readable && (!readable || memcmp(info.value, current, info.size) == 0)) {
+            return;
+        }
+        
+        WatchEvent event;
+        event.id = info.id;
+        event.address = info.address;
+        event.type = info.type;
+        event.size = info.size;
+        event.readable = readable;
+        memcpy(event.oldValue, info.value, info.size);
+        if (readable) {
+            memcpy(event.newValue, current, info.size);
+            memcpy(info.value, current, info.size);
+        } else {
+            memset(event.newValue, 0, info.size);
+        }
+        info.readable = readable;
+        info.changes++;
+        
+        if (!events.push(event)) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    
+public:
+    WatchEngine() : task(MACH_PORT_NULL), stopping(false), nextId(1), nextFreezeId(1),
+                    freezeInterval(std::chrono::milliseconds(100)), dropped(0), freezeWrites(0), generation(0),
+                    tickTask(MACH_PORT_NULL) {}
+    
+    ~WatchEngine() {
+        stop();
+    }
+    
+    WatchEngine(const WatchEngine&) = delete;
+    WatchEngine& operator=(const WatchEngine&) = delete;
+    
+    // Start watching size bytes at address, starting from initial. Returns the watch id.
+    uint32_t add(task_t targetTask, mach_vm_address_t address, ValueType type, size_t size,
+                 const uint8_t* initial, double intervalMs) {
+        std::lock_guard<std::mutex> guard(lock);
+        task = targetTask;
+        
+        Watch watch;
+        watch.info.id = nextId++;
+        watch.info.address = address;
+        watch.info.type = type;
+        watch.info.size = std::min(size, WATCH_VALUE_MAX);
+        watch.info.intervalMs = intervalMs;
+        memcpy(watch.info.value, initial, watch.info.size);
+        watch.info.readable = true;
+        watch.info.changes = 0;
+        watch.interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double, std::milli>(intervalMs));
+        watch.due = std::chrono::steady_clock::now() + watch.interval;
+        
+        auto position = std::upper_bound(watches.begin(), watches.end(), address,
+            [](mach_vm_address_t value, const Watch& other) { return value < other.info.address; });
+        watches.insert(position, watch);
+        generation++;
+        startThread();
+        return watch.info.id;
+    }
+    
+    bool remove(uint32_t id) {
+        std::lock_guard<std::mutex> guard(lock);
+        for (auto it = watches.begin(); it != watches.end(); ++it) {
+            if (it->info.id == id) {
+                watches.erase(it);
+                generation++;
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    size_t removeAll() {
+        std::lock_guard<std::mutex> guard(lock);
+        size_t count = watches.size();
+        watches.clear();
+        generation++;
+        return count;
+    }
+    
+    std::vector<WatchInfo> list() {
+        std::lock_guard<std::mutex> guard(lock);
+        std::vector<WatchInfo> infos;
+        for (const Watch& watch : watches) {
+            infos.push_back(watch.info);
+        }
+        std::sort(infos.begin(), infos.end(), [](const WatchInfo& a, const WatchInfo& b) { return a.id < b.id; });
+        return infos;
+    }
+    
+    // Hold size bytes at address at value. Returns the freeze id.
+    uint32_t freeze(task_t targetTask, mach_vm_address_t address, ValueType type, size_t size, const uint8_t* value) {
+        std::lock_guard<std::mutex> guard(lock);
+        task = targetTask;
+        
+        Freeze freeze;
+        freeze.info.id = nextFreezeId++;
+        freeze.info.address = address;
+        freeze.info.type = type;
+        freeze.info.size = std::min(size, WATCH_VALUE_MAX);
+        memcpy(freeze.info.value, value, freeze.info.size);
+        freeze.info.rewrites = 0;
+        
+        auto position = std::upper_bound(freezes.begin(), freezes.end(), address,
+            [](mach_vm_address_t value, const Freeze& other) { return value < other.info.address; });
+        freezes.insert(position, freeze);
+        generation++;
+        
+        // A new freeze takes hold right away
+        freezeDue = std::chrono::steady_clock::now();
+        startThread();
+        return freeze.info.id;
+    }
+    
+    bool unfreeze(uint32_t id) {
+        std::lock_guard<std::mutex> guard(lock);
+        for (auto it = freezes.begin(); it != freezes.end(); ++it) {
+            if (it->info.id == id) {
+                freezes.erase(it);
+                generation++;
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    size_t unfreezeAll() {
+        std::lock_guard<std::mutex> guard(lock);
+        size_t count = freezes.size();
+        freezes.clear();
+        generation++;
+        return count;
+    }
+    
+    std::vector<FreezeInfo> listFreezes() {
+        std::lock_guard<std::mutex> guard(lock);
+        std::vector<FreezeInfo> infos;
+        for (const Freeze& freeze : freezes) {
+            infos.push_back(freeze.info);
+        }
+        std::sort(infos.begin(), infos.end(), [](const FreezeInfo& a, const FreezeInfo& b) { return a.id < b.id; });
+        return infos;
+    }
+    
+    // How often frozen values are checked
+    void setFreezeInterval(double intervalMs) {
+        std::lock_guard<std::mutex> guard(lock);
+        freezeInterval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double, std::milli>(intervalMs));
+        freezeDue = std::chrono::steady_clock::now();
+        wake.notify_one();
+    }
+    
+    double getFreezeInterval() {
+        std::lock_guard<std::mutex> guard(lock);
+        return std::chrono::duration<double, std::milli>(freezeInterval).count();
+    }
+    
+    // mach_vm_write calls the freeze engine has made
+    uint64_t freezeWriteCalls() const { return freezeWrites.load(std::memory_order_relaxed); }
+    
+    // Take the next pending change event, if any. Only one thread may call this.
+    bool poll(WatchEvent& event) {
+        return events.pop(event);
+    }
+    
+    // Number of events lost to a full ring since the last call
+    size_t takeDropped() {
+        return dropped.exchange(0, std::memory_order_relaxed);
+    }
+    
+    // Stop the thread and forget every watch and freeze
+    void stop() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+            watches.clear();
+            freezes.clear();
+            generation++;
+        }
+        wake.notify_one();
+        if (thread.joinable()) {
+            thread.join();
+        }
+        
+        WatchEvent event;
+        while (events.pop(event)) {}
+        task = MACH_PORT_NULL;
+    }
+};
+
+// Byte signature such as "48 8B ?? ?? 89". mask is 0 for wildcard bytes; the
+// anchor is the longest run of fixed bytes, which the matcher searches for.
+struct BytePattern {
+    std::string name;
+    std::vector<uint8_t> bytes;
+    std::vector<uint8_t> mask;
+    size_t anchor;
+    size_t anchorLength;
+};
+
+// Parse space-separated hex bytes with ? or ?? wildcards. A pattern needs at
+// least one fixed byte.
+inline bool parseBytePattern(const std::string& text, BytePattern& pattern) {
+    pattern.bytes.clear();
+    pattern.mask.clear();
+    
+    std::istringstream tokens(text);
+    std::string token;
+    while (tokens >> token) {
+        if (token == "?" || token == "??") {
+            pattern.bytes.push_back(0);
+            pattern.mask.push_back(0);
+            continue;
+        }
+        if (token.size() != 2 || !isxdigit(static_cast<unsigned char>(token[0])) ||
+            !isxdigit(static_cast<unsigned char>(token[1]))) {
+            return false;
+        }
+        pattern.bytes.push_back(static_cast<uint8_t>(std::stoul(token, nullptr, 16)));
+        pattern.mask.push_back(1);
+    }
+    
+    pattern.anchor = 0;
+    pattern.anchorLength = 0;
+    for (size_t i = 0; i < pattern.mask.size(); ) {
+        if (!pattern.mask[i]) {
+            i++;
+            continue;
+        }
+        size_t end = i;
+        while (end < pattern.mask.size() && pattern.mask[end]) {
+            end++;
+        }
+        if (end - i > pattern.anchorLength) {
+            pattern.anchor = i;
+            pattern.anchorLength = end - i;
+        }
+        i = end;
+    }
+    return pattern.anchorLength > 0;
+}
+
+// Pattern in canonical form ("48 8B ?? ?? 89")
+inline std::string formatBytePattern(const BytePattern& pattern) {
+    std::stringstream ss;
+    for (size_t i = 0; i < pattern.bytes.size(); i++) {
+        if (i > 0) {
+            ss << " ";
+        }
+        if (pattern.mask[i]) {
+            ss << std::hex << std::uppercase << std::setw(2) << std::setfill('0') << static_cast<int>(pattern.bytes[i]);
+        } else {
+            ss << "??";
+        }
+    }
+    return ss.str();
+}
+
+// Finds a set of byte patterns in a buffer. A single pattern is searched with a
+// Boyer-Moore-Horspool skip table over its anchor; several are matched in one
+// pass with an Aho-Corasick automaton built from all their anchors. Each anchor
+// hit is then checked against the full pattern, wildcards included.
+class PatternMatcher {
+private:
+    static constexpr uint32_t NO_STATE = UINT32_MAX;
+    
+    std::vector<BytePattern> patterns;
+    size_t longest;
+    size_t skip[256];
+    // Dense goto table (256 entries per state) and, per state, the patterns whose
+    // anchor ends there (including those matched through suffix links)
+    std::vector<uint32_t> transitions;
+    std::vector<std::vector<uint32_t>> outputs;
+    
+    // Report pattern index if its anchor, found at anchorStart, is part of a full match
+    template <typename Fn>
+    void confirm(uint32_t index, const uint8_t* data, size_t length, size_t startLimit, size_t anchorStart,
+                 mach_vm_address_t base, Fn& fn) const {
+        const BytePattern& pattern = patterns[index];
+        if (anchorStart < pattern.anchor) {
+            return;
+        }
+        size_t start = anchorStart - pattern.anchor;
+        if (start >= startLimit || start + pattern.bytes.size() > length) {
+            return;
+        }
+        for (size_t i = 0; i < pattern.bytes.size(); i++) {
+            if (pattern.mask[i] && data[start + i] != pattern.bytes[i]) {
+                return;
+            }
+        }
+        fn(index, base + start);
+    }
+    
+    void buildSkipTable() {
+        const BytePattern& pattern = patterns[0];
+        const uint8_t* anchor = pattern.bytes.data() + pattern.anchor;
+        size_t length = pattern.anchorLength;
+        std::fill(skip, skip + 256, length);
+        for (size_t i = 0; i + 1 < length; i++) {
+            skip[anchor[i]] = length - 1 - i;
+        }
+    }
+    
+    void buildAutomaton() {
+        transitions.assign(256, NO_STATE);
+        outputs.assign(1, std::vector<uint32_t>());
+        for (uint32_t index = 0; index < patterns.size(); index++) {
+            const BytePattern& pattern = patterns[index];
+            uint32_t state = 0;
+            for (size_t i = 0; i < pattern.anchorLength; i++) {
+                uint32_t& next = transitions[state * 256 + pattern.bytes[pattern.anchor + i]];
+                if (next == NO_STATE) {
+                    next = static_cast<uint32_t>(outputs.size());
+                    outputs.push_back(std::vector<uint32_t>());
+                    transitions.resize(transitions.size() + 256, NO_STATE);
+                }
+                // resize may have moved the table; index it again
+                state = transitions[state * 256 + pattern.bytes[pattern.anchor + i]];
+            }
+            outputs[state].push_back(index);
+        }
+        
+        // Breadth-first, so a state's suffix link is complete before its children use it
+        std::vector<uint32_t> fail(outputs.size(), 0);
+        std::deque<uint32_t> queue;
+        for (size_t c = 0; c < 256; c++) {
+            uint32_t& next = transitions[c];
+            if (next == NO_STATE) {
+                next = 0;
+            } else {
+                queue.push_back(next);
+            }
+        }
+        while (!queue.empty()) {
+            uint32_t state = queue.front();
+            queue.pop_front();
+            for (size_t c = 0; c < 256; c++) {
+                uint32_t next = transitions[state * 256 + c];
+                uint32_t fallback = transitions[fail[state] * 256 + c];
+                if (next == NO_STATE) {
+                    transitions[state * 256 + c] = fallback;
+                    continue;
+                }
+                fail[next] = fallback;
+                outputs[next].insert(outputs[next].end(), outputs[fallback].begin(), outputs[fallback].end());
+                queue.push_back(next);
+            }
+        }
+    }
+    
+public:
+    PatternMatcher() : longest(0) {}
+    
+    void compile(const std::vector<BytePattern>& source) {
+        patterns = source;
+        longest = 0;
+        transitions.clear();
+        outputs.clear();
+        for (const BytePattern& pattern : patterns) {
+            longest = std::max(longest, pattern.bytes.size());
+        }
+        if (patterns.size() == 1) {
+            buildSkipTable();
+        } else if (!patterns.empty()) {
+            buildAutomaton();
+        }
+    }
+    
+    bool empty() const { return patterns.empty(); }
+    size_t size() const { return patterns.size(); }
+    size_t maxLength() const { return longest; }
+    const BytePattern& operator[](size_t index) const { return patterns[index]; }
+    
+    // Call fn(pattern, address) for each match starting in the first startLimit bytes
+    template <typename Fn>
+    void search(const uint8_t* data, size_t length, size_t startLimit, mach_vm_address_t base, Fn&& fn) const {
+        if (patterns.empty()) {
+            return;
+        }
+        
+        // An anchor ending past this can't belong to a match that starts in range
+        size_t end = std::min(length, startLimit + longest);
+        
+        if (patterns.size() == 1) {
+            const BytePattern& pattern = patterns[0];
+            const uint8_t* anchor = pattern.bytes.data() + pattern.anchor;
+            size_t anchorLength = pattern.anchorLength;
+            uint8_t last = anchor[anchorLength - 1];
+            for (size_t position = 0; position + anchorLength <= end; ) {
+                uint8_t current = data[position + anchorLength - 1];
+                if (current == last && memcmp(data + position, anchor, anchorLength - 1) == 0) {
+                    confirm(0, data, length, startLimit, position, base, fn);
+                }
+                position += skip[current];
+            }
+            return;
+        }
+        
+        uint32_t state = 0;
+        for (size_t i = 0; i < end; i++) {
+            state = transitions[state * 256 + data[i]];
+            for (uint32_t index : outputs[state]) {
+                confirm(index, data, length, startLimit, i + 1 - patterns[index].anchorLength, base, fn);
+            }
+        }
+    }
+};
+
+// One match of a byte pattern
+struct PatternHit {
+    uint32_t pattern;
+    mach_vm_address_t address;
+    
+    bool operator<(const PatternHit& other) const {
+        return pattern < other.pattern || (pattern == other.pattern && address < other.address);
+    }
+};
+
+// Pattern scans list at most this many matches per pattern
+const size_t PATTERN_DISPLAY_LIMIT = 10;
+
+// Process information
+struct ProcessInfo {
+    pid_t pid;
+    pid_t parent;
+    std::string name;
+};
+
+// Which processes listProcesses returns: name is a case-insensitive part of the
+// name, pattern a shell pattern for the whole name ("Google Chrome*"), and tree
+// keeps only that process and its descendants. Empty fields match everything.
+struct ProcessFilter {
+    std::string name;
+    std::string pattern;
+    pid_t tree;
+    
+    ProcessFilter() : tree(0) {}
+    
+    bool matchesName(const std::string& processName) const {
+        if (!pattern.empty() && fnmatch(pattern.c_str(), processName.c_str(), FNM_CASEFOLD) != 0) {
+            return false;
+        }
+        if (name.empty()) {
+            return true;
+        }
+        auto lower = [](std::string text) {
+            std::transform(text.begin(), text.end(), text.begin(), ::tolower);
+            return text;
+        };
+        return lower(processName).find(lower(name)) != std::string::npos;
+    }
+};
+
+// Work-stealing thread pool used by the scan engine
+class WorkerPool {
+private:
+    struct WorkQueue {
+        std::mutex lock;
+        std::deque<size_t> tasks;
+    };
+    
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    std::mutex stateLock;
+    std::condition_variable wakeCondition;
+    std::condition_variable doneCondition;
+    const std::function<void(size_t, size_t)>* job;
+    std::exception_ptr jobError;
+    uint64_t generation;
+    size_t activeWorkers;
+    bool stopping;
+    
+    // Take the next task from our own queue, or steal one from the back of another
+    bool takeTask(size_t worker, size_t& task) {
+        {
+            WorkQueue& own = *queues[worker];
+            std::lock_guard<std::mutex> guard(own.lock);
+            if (!own.tasks.empty()) {
+                task = own.tasks.front();
+                own.tasks.pop_front();
+                return true;
+            }
+        }
+        
+        for (size_t i = 1; i < queues.size(); i++) {
+            WorkQueue& victim = *queues[(worker + i) % queues.size()];
+            std::lock_guard<std::mutex> guard(victim.lock);
+            if (!victim.tasks.empty()) {
+                task = victim.tasks.back();
+                victim.tasks.pop_back();
+                return true;
+            }
+        }
+        
+        return false;
+    }
+    
+    void workerLoop(size_t worker) {
+        uint64_t seenGeneration = 0;
+        
+        while (true) {
+            const std::function<void(size_t, size_t)>* currentJob = nullptr;
+            {
+                std::unique_lock<std::mutex> guard(stateLock);
+                wakeCondition.wait(guard, [&] { return stopping || generation != seenGeneration; });
+                if (stopping) {
+                    return;
+                }
+                seenGeneration = generation;
+                currentJob = job;
+            }
+            
+            size_t task = 0;
+            while (takeTask(worker, task)) {
+                try {
+                    (*currentJob)(worker, task);
+                } catch (...) {
+                    std::lock_guard<std::mutex> guard(stateLock);
+                    if (!jobError) {
+                        jobError = std::current_exception();
+                    }
+                }
+            }
+            
+            std::lock_guard<std::mutex> guard(stateLock);
+            if (--activeWorkers == 0) {
+                doneCondition.notify_all();
+            }
+        }
+    }
+    
+    void startWorkers(size_t threadCount) {
+        stopping = false;
+        for (size_t i = 0; i < threadCount; i++) {
+            queues.push_back(std::unique_ptr<WorkQueue>(new WorkQueue()));
+        }
+        for (size_t i = 0; i < threadCount; i++) {
+            workers.push_back(std::thread(&WorkerPool::workerLoop, this, i));
+        }
+    }
+    
+    void stopWorkers() {
+        {
+            std::lock_guard<std::mutex> guard(stateLock);
+            stopping = true;
+        }
+        wakeCondition.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        workers.clear();
+        queues.clear();
+    }
+    
+public:
+    explicit WorkerPool(size_t threadCount = 0)
+        : job(nullptr), generation(0), activeWorkers(0), stopping(false) {
+        startWorkers(threadCount > 0 ? threadCount : defaultThreadCount());
+    }
+    
+    ~WorkerPool() {
+        stopWorkers();
+    }
+    
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+    
+    static size_t defaultThreadCount() {
+        size_t cores = std::thread::hardware_concurrency();
+        return cores > 0 ? cores : 1;
+    }
+    
+    size_t size() const { return workers.size(); }
+    
+    // Change the number of worker threads (0 = one per core)
+    void resize(size_t threadCount) {
+        if (threadCount == 0) {
+            threadCount = defaultThreadCount();
+        }
+        if (threadCount == workers.size()) {
+            return;
+        }
+        stopWorkers();
+        startWorkers(threadCount);
+    }
+    
+    // Run fn(worker, task) for every task in [0, taskCount) and block until all are done.
+    // Tasks are dealt out in contiguous blocks so each worker starts on neighbouring
+    // chunks; idle workers steal from the far end of busy queues. While waiting, the
+    // calling thread invokes onWait periodically (used for progress output).
+    void run(size_t taskCount, const std::function<void(size_t, size_t)>& fn,
+             const std::function<void()>& onWait = nullptr) {
+        if (taskCount == 0) {
+            return;
+        }
+        
+        size_t workerCount = workers.size();
+        size_t perWorker = (taskCount + workerCount - 1) / workerCount;
+        for (size_t i = 0; i < workerCount; i++) {
+            std::lock_guard<std::mutex> guard(queues[i]->lock);
+            queues[i]->tasks.clear();
+            for (size_t task = i * perWorker; task < std::min(taskCount, (i + 1) * perWorker); task++) {
+                queues[i]->tasks.push_back(task);
+            }
+        }
+        
+        std::unique_lock<std::mutex> guard(stateLock);
+        job = &fn;
+        jobError = nullptr;
+        activeWorkers = workerCount;
+        generation++;
+        wakeCondition.notify_all();
+        
+        while (activeWorkers > 0) {
+            doneCondition.wait_for(guard, std::chrono::milliseconds(100));
+            if (onWait && activeWorkers > 0) {
+                guard.unlock();
+                onWait();
+                guard.lock();
+            }
+        }
+        job = nullptr;
+        
+        if (jobError) {
+            std::exception_ptr error = jobError;
+            jobError = nullptr;
+            std::rethrow_exception(error);
+        }
+    }
+};
+
+// Blocking queue with a fixed capacity, connecting the stages of a scan
+// pipeline. After close() pushes fail and pop() drains what is left.
+template <typename T>
+class BoundedQueue {
+private:
+    std::mutex lock;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+    std::deque<T> items;
+    size_t capacity;
+    bool closed;
+    
+public:
+    explicit BoundedQueue(size_t limit) : capacity(limit), closed(false) {}
+    
+    bool push(T item) {
+        std::unique_lock<std::mutex> guard(lock);
+        notFull.wait(guard, [&] { return closed || items.size() < capacity; });
+        if (closed) {
+            return false;
+        }
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+        return true;
+    }
+    
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> guard(lock);
+        notEmpty.wait(guard, [&] { return closed || !items.empty(); });
+        if (items.empty()) {
+            return false;
+        }
+        item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+    
+    void close() {
+        std::lock_guard<std::mutex> guard(lock);
+        closed = true;
+        notEmpty.notify_all();
+        notFull.notify_all();
+    }
+};
+
+// A fixed set of scan windows handed back and forth between the pipeline
+// stages, so buffers are recycled rather than allocated per read. acquire()
+// blocks until a buffer is free; it returns null once the arena is closed.
+class BufferArena {
+private:
+    std::vector<std::unique_ptr<uint8_t[]>> storage;
+    BoundedQueue<uint8_t*> freeBuffers;
+    
+public:
+    BufferArena(size_t count, size_t size) : freeBuffers(count) {
+        for (size_t i = 0; i < count; i++) {
+            storage.emplace_back(new uint8_t[size]);
+            freeBuffers.push(storage.back().get());
+        }
+    }
+    
+    uint8_t* acquire() {
+        uint8_t* buffer = nullptr;
+        return freeBuffers.pop(buffer) ? buffer : nullptr;
+    }
+    
+    void release(uint8_t* buffer) { freeBuffers.push(buffer); }
+    void close() { freeBuffers.close(); }
+};
+
+// One window of a pipelined scan: read length bytes at address, matches may
+// start in the first step bytes
+struct PipelineWindow {
+    mach_vm_address_t address;
+    size_t length;
+    size_t step;
+};
+
+// Split [start, start + size) into windows that carry overlap bytes past their
+// step (never past readEnd), like RegionReader::stream does
+inline void appendPipelineWindows(std::vector<PipelineWindow>& windows, mach_vm_address_t start, mach_vm_size_t size,
+                                  mach_vm_address_t readEnd, size_t overlap) {
+    mach_vm_address_t end = start + size;
+    for (mach_vm_address_t position = start; position < end; ) {
+        PipelineWindow window;
+        window.address = position;
+        window.step = static_cast<size_t>(std::min<mach_vm_address_t>(SCAN_WINDOW_SIZE - overlap, end - position));
+        window.length = static_cast<size_t>(std::min<mach_vm_address_t>(window.step + overlap, readEnd - position));
+        windows.push_back(window);
+        position += window.step;
+    }
+}
+
+// Read-ahead scan pipeline. Reader threads copy windows of target memory into
+// arena buffers in window order while the worker pool matches the windows
+// already read, so Mach reads and matching overlap instead of alternating.
+// fn(worker, window, data, length, startLimit, address) is called for every
+// readable run of every window; windows reach the workers out of order, so fn
+// gets the window index to put its results back in order. Once stopRequested
+// returns true no further windows are read or matched.
+template <typename Fn>
+void runPipeline(task_t task, WorkerPool& pool, size_t readerCount, const std::vector<PipelineWindow>& windows,
+                 Fn&& fn, const std::function<void()>& onWait = nullptr,
+                 const std::function<bool()>& stopRequested = nullptr) {
+    struct Run {
+        size_t offset;
+        size_t length;
+        size_t startLimit;
+    };
+    struct Block {
+        size_t window;
+        uint8_t* buffer;
+        std::vector<Run> runs;
+    };
+    
+    // Every worker can hold a buffer while each reader fills one and has one queued
+    readerCount = std::max<size_t>(1, std::min(readerCount, windows.size()));
+    BufferArena arena(pool.size() + 2 * readerCount, SCAN_WINDOW_SIZE);
+    BoundedQueue<Block> ready(pool.size() + readerCount);
+    std::atomic<size_t> nextWindow(0);
+    std::atomic<size_t> readersLeft(readerCount);
+    
+    std::vector<std::thread> readers;
+    for (size_t r = 0; r < readerCount; r++) {
+        readers.push_back(std::thread([&]() {
+            RegionReader reader(task, false, 0);
+            for (size_t index = nextWindow++; index < windows.size(); index = nextWindow++) {
+                if (stopRequested && stopRequested()) {
+                    break;
+                }
+                const PipelineWindow& window = windows[index];
+                Block block = { index, arena.acquire(), std::vector<Run>() };
+                if (!block.buffer) {
+                    break;
+                }
+                {
+                    StatTimer timer(STAT_COUNT, "read", window.address, window.length);
+                    reader.fetch(block.buffer, window.address, window.length, window.step,
+                        [&](const uint8_t* data, size_t length, size_t startLimit, mach_vm_address_t) {
+                            block.runs.push_back({ static_cast<size_t>(data - block.buffer), length, startLimit });
+                        });
+                }
+                uint8_t* buffer = block.buffer;
+                if (!ready.push(std::move(block))) {
+                    arena.release(buffer);
+                    break;
+                }
+            }
+            if (--readersLeft == 0) {
+                ready.close();
+            }
+        }));
+    }
+    
+    auto stop = [&]() {
+        ready.close();
+        arena.close();
+        for (std::thread& reader : readers) {
+            reader.join();
+        }
+    };
+    
+    try {
+        pool.run(pool.size(), [&](size_t worker, size_t) {
+            Block block;
+            while (ready.pop(block)) {
+                const PipelineWindow& window = windows[block.window];
+                if (stopRequested && stopRequested()) {
+                    block.runs.clear();
+                }
+                for (const Run& run : block.runs) {
+                    fn(worker, block.window, block.buffer + run.offset, run.length, run.startLimit, window.address + run.offset);
+                }
+                arena.release(block.buffer);
+            }
+        }, onWait);
+    } catch (...) {
+        stop();
+        throw;
+    }
+    stop();
+}
+
+// Hits of a running scan that results shows before it finishes
+const size_t JOB_PREVIEW_LIMIT = 1000;
+
+// The scan in flight. Scans report the bytes they have covered and the hits
+// they have found here and check cancelled() between chunks. A background scan
+// runs on the job thread and writes its messages to a log, which the CLI prints
+// once the scan has finished.
+class ScanJob {
+private:
+    std::thread thread;
+    std::atomic<bool> active;
+    std::atomic<bool> finished;
+    std::atomic<bool> stopRequested;
+    std::atomic<uint64_t> bytesDone;
+    std::atomic<uint64_t> bytesTotal;
+    std::atomic<uint64_t> hitCount;
+    std::chrono::steady_clock::time_point startTime;
+    std::string name;
+    bool background;
+    std::ostream* output;
+    std::ostream* errorOutput;
+    std::ostringstream log;
+    std::mutex previewLock;
+    ResultStore preview;
+    
+public:
+    ScanJob() : active(false), finished(false), stopRequested(false), bytesDone(0), bytesTotal(0), hitCount(0), background(false),
+                output(&std::cout), errorOutput(&std::cerr) {}
+    
+    ~ScanJob() {
+        cancel();
+        wait();
+    }
+    
+    ScanJob(const ScanJob&) = delete;
+    ScanJob& operator=(const ScanJob&) = delete;
+    
+    // Run fn as the current job: right away, or on the job thread in the background.
+    // A finished background job must have been collected first.
+    void start(const std::string& description, bool inBackground, const std::function<void()>& fn) {
+        wait();
+        name = description;
+        background = inBackground;
+        stopRequested = false;
+        bytesDone = 0;
+        bytesTotal = 0;
+        hitCount = 0;
+        startTime = std::chrono::steady_clock::now();
+        log.str("");
+        {
+            std::lock_guard<std::mutex> guard(previewLock);
+            preview.clear();
+        }
+        finished = false;
+        active = true;
+        
+        if (!background) {
+            try {
+                fn();
+            } catch (...) {
+                active = false;
+                throw;
+            }
+            active = false;
+            return;
+        }
+        thread = std::thread([this, fn]() {
+            try {
+                fn();
+            } catch (const std::exception& e) {
+                log << Color::RED << "Scan failed: " << e.what() << Color::RESET << std::endl;
+            }
+            finished = true;
+        });
+    }
+    
+    // Messages of the scan go to the terminal, or to the log in the background
+    std::ostream& console() { return background ? static_cast<std::ostream&>(log) : *output; }
+    std::ostream& errorConsole() { return background ? static_cast<std::ostream&>(log) : *errorOutput; }
+    void setOutput(std::ostream& messages, std::ostream& errors) {
+        output = &messages;
+        errorOutput = &errors;
+    }
+    bool inBackground() const { return background; }
+    
+    bool running() const { return active; }
+    bool finishedRunning() const { return finished; }
+    bool cancelled() const { return stopRequested.load(std::memory_order_relaxed); }
+    void cancel() { stopRequested = true; }
+    
+    // Block until a background job is done (its messages stay until collected)
+    void wait() {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+    
+    // Take the messages of a finished background job
+    bool collect(std::string& messages) {
+        if (!active || !background || !finished) {
+            return false;
+        }
+        wait();
+        messages = log.str();
+        background = false;
+        active = false;
+        return true;
+    }
+    
+    void setTotal(uint64_t bytes) { bytesTotal = bytes; }
+    void advance(uint64_t bytes) { bytesDone.fetch_add(bytes, std::memory_order_relaxed); }
+    uint64_t bytesScanned() const { return bytesDone.load(); }
+    uint64_t bytesToScan() const { return bytesTotal.load(); }
+    uint64_t hits() const { return hitCount.load(); }
+    const std::string& description() const { return name; }
+    
+    // Count rows [first, last) of a worker's hits, keeping the first few for the preview
+    void addHits(const ResultStore& hits, size_t first, size_t last) {
+        hitCount.fetch_add(last - first, std::memory_order_relaxed);
+        if (!background || last == first) {
+            return;
+        }
+        std::lock_guard<std::mutex> guard(previewLock);
+        if (preview.empty()) {
+            preview.reset(hits.type, hits.valueSize);
+        }
+        if (preview.size() < JOB_PREVIEW_LIMIT) {
+            preview.append(hits, first, std::min(last, first + JOB_PREVIEW_LIMIT - preview.size()));
+        }
+    }
+    
+    // The hits previewed so far, in address order
+    ResultStore previewResults() {
+        ResultStore copy;
+        std::lock_guard<std::mutex> guard(previewLock);
+        copy.reset(preview.type, preview.valueSize);
+        copy.append(preview, 0, preview.size());
+        copy.sortByAddress();
+        return copy;
+    }
+    
+    // "42.0% of 3.1 GB, 850.2 MB/s, 2.3s left"
+    std::string progressText() const {
+        uint64_t done = bytesDone.load();
+        uint64_t total = bytesTotal.load();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        double rate = seconds > 0 ? static_cast<double>(done) / seconds : 0;
+        
+        std::stringstream text;
+        text << std::fixed << std::setprecision(1)
+             << (total > 0 ? static_cast<double>(done) * 100.0 / static_cast<double>(total) : 100.0) << "% of ";
+        if (total >= 1024ull * 1024 * 1024) {
+            text << static_cast<double>(total) / (1024.0 * 1024 * 1024) << " GB";
+        } else {
+            text << static_cast<double>(total) / (1024.0 * 1024) << " MB";
+        }
+        text << ", " << rate / (1024.0 * 1024) << " MB/s";
+        if (rate > 0 && done < total) {
+            text << ", " << static_cast<double>(total - done) / rate << "s left";
+        }
+        return text.str();
+    }
+};
+
+// Main class for memory operations
+class MemoryScanner {
+private:
+    task_t targetTask;
+    pid_t targetPid;
+    std::string targetName;
+    RegionIndex memoryRegions;
+    ModuleMap moduleMap;
+    ResultStore scanResults;
+    PodBuffer<mach_vm_address_t> rootAddresses;
+    PodBuffer<uint8_t> rootTypes;
+    PodBuffer<size_t> resultIndices;
+    std::vector<ScanGeneration> scanHistory;
+    std::unique_ptr<BitmapScan> bitmapScan;
+    ScanKernel stringSearch;
+    std::vector<ValueType> anyTypes;
+    std::vector<PointerPath> pointerPaths;
+    mach_vm_address_t pointerTarget;
+    PatternMatcher loadedPatterns;
+    std::shared_ptr<WorkerPool> workerPool;
+    WatchEngine watchEngine;
+    std::unique_ptr<PageStore> snapshotStore;
+    std::vector<MemorySnapshot> snapshots;
+    uint32_t nextSnapshotId;
+    std::string snapshotDirectory;
+    bool zeroCopy;
+    bool useSimd;
+    size_t alignment;
+    RescanMode rescanMode;
+    bool pipelined;
+    size_t readerThreads;
+    bool refreshEachScan;
+    bool showProgress;
+    bool isAttached;
+    std::ostream* output;
+    std::ostream* errorOutput;
+    std::function<void(uint64_t, uint64_t, uint64_t)> progressCallback;
+    ScanJob scanJob;
+    
+    // Where messages go: the terminal for the CLI, a buffer for the library
+    std::ostream& out() { return *output; }
+    std::ostream& err() { return *errorOutput; }
+
+public:
+    // Scanners of a session share one worker pool; a lone scanner makes its own
+    explicit MemoryScanner(std::shared_ptr<WorkerPool> pool = nullptr)
+        : targetTask(MACH_PORT_NULL), targetPid(0), pointerTarget(0), workerPool(pool ? pool : std::make_shared<WorkerPool>()),
+          nextSnapshotId(1), zeroCopy(false), useSimd(true), alignment(0), rescanMode(RESCAN_DIRTY),
+          pipelined(true), readerThreads(0), refreshEachScan(true), showProgress(true), isAttached(false),
+          output(&std::cout), errorOutput(&std::cerr) {
+        anyTypes = { ValueType::INT32, ValueType::INT64, ValueType::FLOAT, ValueType::DOUBLE };
+        const char* temporary = getenv("TMPDIR");
+        snapshotDirectory = temporary && *temporary ? temporary : "/tmp";
+    }
+    
+    ~MemoryScanner() {
+        scanJob.cancel();
+        scanJob.wait();
+        if (isAttached) {
+            detachProcess();
+        }
+    }
+    
+    // List the processes that pass the filter. One short BSD info call per PID
+    // gives the parent and the command name; that name is cut at MAXCOMLEN - 1
+    // characters, so proc_name is only asked for the full one when it may have been.
+    static std::vector<ProcessInfo> listProcesses(const ProcessFilter& filter = ProcessFilter()) {
+        std::vector<ProcessInfo> processes;
+        int cntp = proc_listpids(PROC_ALL_PIDS, 0, NULL, 0);
+        std::vector<pid_t> pids(cntp);
+        
+        proc_listpids(PROC_ALL_PIDS, 0, pids.data(), sizeof(pid_t) * cntp);
+        
+        std::vector<ProcessInfo> candidates;
+        std::vector<bool> truncated;
+        for (int i = 0; i < cntp; i++) {
+            if (pids[i] == 0) continue;
+            
+            struct proc_bsdshortinfo info;
+            ProcessInfo candidate;
+            candidate.pid = pids[i];
+            candidate.parent = 0;
+            if (proc_pidinfo(pids[i], PROC_PIDT_SHORTBSDINFO, 0, &info, sizeof(info)) == static_cast<int>(sizeof(info))) {
+                candidate.parent = static_cast<pid_t>(info.pbsi_ppid);
+                candidate.name.assign(info.pbsi_comm, strnlen(info.pbsi_comm, sizeof(info.pbsi_comm)));
+            }
+            candidates.push_back(candidate);
+            truncated.push_back(candidate.name.empty() || candidate.name.size() >= MAXCOMLEN - 1);
+        }
+        
+        std::unordered_map<pid_t, pid_t> parents;
+        if (filter.tree > 0) {
+            for (const ProcessInfo& candidate : candidates) {
+                parents[candidate.pid] = candidate.parent;
+            }
+        }
+        
+        // Walk up from pid until the root of the tree or launchd
+        auto inTree = [&](pid_t pid) {
+            for (size_t depth = 0; pid > 0 && depth < parents.size(); depth++) {
+                if (pid == filter.tree) {
+                    return true;
+                }
+                auto parent = parents.find(pid);
+                pid = parent != parents.end() ? parent->second : 0;
+            }
+            return false;
+        };
+        
+        for (size_t i = 0; i < candidates.size(); i++) {
+            ProcessInfo& candidate = candidates[i];
+            if (filter.tree > 0 && !inTree(candidate.pid)) continue;
+            
+            if (truncated[i]) {
+                // Filter on the full name, which may match where the cut one doesn't
+                char name[PROC_PIDPATHINFO_MAXSIZE];
+                if (proc_name(candidate.pid, name, sizeof(name)) <= 0) continue;
+                candidate.name = name;
+            }
+            if (filter.matchesName(candidate.name)) {
+                processes.push_back(candidate);
+            }
+        }
+        
+        return processes;
+    }
+    
+    // Attach to a process
+    bool attachProcess(pid_t pid) {
+        kern_return_t kr = task_for_pid(mach_task_self(), pid, &targetTask);
+        if (kr != KERN_SUCCESS) {
+            err() << "Failed to attach to process. Error: " << mach_error_string(kr) << std::endl;
+            err() << "Note: On macOS, this may require running as root or with special permissions." << std::endl;
+            return false;
+        }
+        
+        targetPid = pid;
+        char name[PROC_PIDPATHINFO_MAXSIZE];
+        if (proc_name(targetPid, name, sizeof(name)) > 0) {
+            targetName = name;
+        } else {
+            targetName = "Unknown";
+        }
+        
+        isAttached = true;
+        memoryRegions.clear();
+        moduleMap.clear();
+        clearResults();
+        pointerPaths.clear();
+        
+        out() << "Successfully attached to process: " << targetName << " (PID: " << targetPid << ")" << std::endl;
+        
+        // Load memory regions
+        refreshMemoryRegions();
+        out() << "Found " << memoryRegions.size() << " memory regions" << std::endl;
+        
+        return true;
+    }
+    
+    // Detach from process
+    void detachProcess() {
+        if (isAttached) {
+            watchEngine.stop();
+            mach_port_deallocate(mach_task_self(), targetTask);
+            targetTask = MACH_PORT_NULL;
+            targetPid = 0;
+            targetName = "";
+            isAttached = false;
+            memoryRegions.clear();
+            moduleMap.clear();
+            clearResults();
+            pointerPaths.clear();
+            snapshots.clear();
+            snapshotStore.reset();
+            out() << "Detached from process" << std::endl;
+        }
+    }
+    
+    // Refresh memory regions
+    RegionDiff refreshMemoryRegions() {
+        std::vector<MemoryRegion> regions;
+        
+        // Walk the map recursively so shared submaps (such as the shared cache) are
+        // reported as their individual mappings
+        mach_vm_address_t address = 0;
+        mach_vm_size_t size = 0;
+        natural_t depth = 0;
+        
+        while (true) {
+            vm_region_submap_info_data_64_t info;
+            mach_msg_type_number_t count = VM_REGION_SUBMAP_INFO_COUNT_64;
+            kern_return_t kr = mach_vm_region_recurse(targetTask, &address, &size, &depth,
+                                                      (vm_region_recurse_info_t)&info, &count);
+            
+            if (kr != KERN_SUCCESS) {
+                break;
+            }
+            
+            if (info.is_submap) {
+                depth++;
+                continue;
+            }
+            
+            MemoryRegion region;
+            region.start = address;
+            region.size = size;
+            region.protection = info.protection;
+            region.readable = (info.protection & VM_PROT_READ) != 0;
+            region.writable = (info.protection & VM_PROT_WRITE) != 0;
+            region.executable = (info.protection & VM_PROT_EXECUTE) != 0;
+            region.userTag = info.user_tag;
+            region.shareMode = info.share_mode;
+            region.objectId = info.object_id;
+            region.depth = depth;
+            region.tags = 0;
+            
+            // Get region name/type
+            if (info.protection == 0) {
+                region.name = "No access";
+            } else {
+                std::stringstream ss;
+                ss << (region.readable ? "R" : "-")
+                   << (region.writable ? "W" : "-")
+                   << (region.executable ? "X" : "-");
+                region.name = ss.str();
+            }
+            
+            regions.push_back(region);
+            address += size;
+        }
+        
+        RegionDiff diff = memoryRegions.update(std::move(regions));
+        
+        // Loaded images only change along with the map
+        if (!diff.empty() || moduleMap.empty()) {
+            moduleMap.load(targetTask);
+        }
+        memoryRegions.retag([this](const MemoryRegion& region) { return regionTags(region); });
+        
+        invalidateScanState(diff);
+        return diff;
+    }
+    
+    // Region map for a scan: walked again unless the map is kept between scans
+    void prepareMemoryRegions() {
+        if (refreshEachScan || memoryRegions.empty()) {
+            refreshMemoryRegions();
+        }
+    }
+    
+    uint32_t regionTags(const MemoryRegion& region) const {
+        uint32_t tags = 0;
+        switch (region.userTag) {
+            case VM_MEMORY_MALLOC_TINY:
+                tags |= TAG_MALLOC | TAG_MALLOC_TINY;
+                break;
+            case VM_MEMORY_MALLOC_SMALL:
+                tags |= TAG_MALLOC | TAG_MALLOC_SMALL;
+                break;
+            case VM_MEMORY_MALLOC_LARGE:
+            case VM_MEMORY_MALLOC_LARGE_REUSABLE:
+            case VM_MEMORY_MALLOC_LARGE_REUSED:
+            case VM_MEMORY_MALLOC_HUGE:
+                tags |= TAG_MALLOC | TAG_MALLOC_LARGE;
+                break;
+            case VM_MEMORY_MALLOC:
+            case VM_MEMORY_MALLOC_NANO:
+            case VM_MEMORY_MALLOC_MEDIUM:
+            case VM_MEMORY_REALLOC:
+                tags |= TAG_MALLOC;
+                break;
+            case VM_MEMORY_STACK:
+                tags |= TAG_STACK;
+                break;
+            case VM_MEMORY_GUARD:
+                tags |= TAG_GUARD;
+                break;
+            default:
+                break;
+        }
+        
+#if defined(SHARED_REGION_BASE) && defined(SHARED_REGION_SIZE)
+        if (region.start >= SHARED_REGION_BASE && region.start - SHARED_REGION_BASE < SHARED_REGION_SIZE) {
+            tags |= TAG_SHARED_CACHE;
+        }
+#endif
+        
+        if (region.shareMode == SM_SHARED || region.shareMode == SM_TRUESHARED || region.shareMode == SM_SHARED_ALIASED) {
+            tags |= TAG_SHARED;
+        }
+        
+        tags |= moduleMap.tagsFor(region.start, region.start + region.size);
+        
+        if (tags == 0) {
+            tags = TAG_ANONYMOUS;
+        }
+        return tags;
+    }
+    
+    // Drop cached candidates in regions that went away or lost read access. Only
+    // the extents reported by the refresh are checked.
+    void invalidateScanState(const RegionDiff& diff) {
+        if (!bitmapScan || diff.invalidated.empty()) {
+            return;
+        }
+        
+        BitmapScan& state = *bitmapScan;
+        size_t pageSize = vm_page_size;
+        size_t slotsPerPage = pageSize / state.alignment;
+        for (CandidateRegion& candidates : state.regions) {
+            if (candidates.candidates == 0) {
+                continue;
+            }
+            size_t slots = candidateSlots(candidates.size, state.valueSize, state.alignment);
+            bool touched = false;
+            for (const auto& range : diff.invalidated) {
+                mach_vm_address_t first = std::max<mach_vm_address_t>(range.first, candidates.start);
+                mach_vm_address_t last = std::min<mach_vm_address_t>(range.second, candidates.start + candidates.size);
+                for (mach_vm_address_t page = first & ~(mach_vm_address_t)(pageSize - 1); page < last; page += pageSize) {
+                    if (memoryRegions.contains(page, pageSize, VM_PROT_READ)) {
+                        continue;
+                    }
+                    size_t pageIndex = static_cast<size_t>((page - candidates.start) / pageSize);
+                    candidates.pages[pageIndex] = PageStore::NO_PAGE;
+                    fillBits(candidates.bits, std::min(slots, pageIndex * slotsPerPage),
+                             std::min(slots, (pageIndex + 1) * slotsPerPage), false);
+                    touched = true;
+                }
+            }
+            if (touched) {
+                state.candidates -= candidates.candidates;
+                candidates.candidates = countBits(candidates.bits);
+                state.candidates += candidates.candidates;
+            }
+        }
+    }
+    
+    // Read memory
+    template <typename T>
+    bool readMemory(mach_vm_address_t address, T& value) {
+        return readTargetMemory(targetTask, address, &value, sizeof(T));
+    }
+    
+    // Read a block of memory
+    bool readMemoryBlock(mach_vm_address_t address, void* buffer, size_t size) {
+        return readTargetMemory(targetTask, address, buffer, size);
+    }
+    
+    // Write memory
+    template <typename T>
+    bool writeMemory(mach_vm_address_t address, const T& value) {
+        kern_return_t kr = mach_vm_write(targetTask, address, (vm_offset_t)&value, sizeof(T));
+        return (kr == KERN_SUCCESS);
+    }
+    
+    bool writeMemoryBlock(mach_vm_address_t address, const void* data, size_t size) {
+        kern_return_t kr = mach_vm_write(targetTask, address, (vm_offset_t)data, static_cast<mach_msg_type_number_t>(size));
+        return (kr == KERN_SUCCESS);
+    }
+    
+    // Encode a search value for the given type
+    bool parseValue(ValueType type, const std::string& value, std::vector<uint8_t>& encoded) {
+        switch (type) {
+            case ValueType::BYTE: {
+                uint8_t val = static_cast<uint8_t>(std::stoi(value));
+                encoded.resize(sizeof(val));
+                memcpy(encoded.data(), &val, sizeof(val));
+                return true;
+            }
+            case ValueType::INT16: {
+                int16_t val = static_cast<int16_t>(std::stoi(value));
+                encoded.resize(sizeof(val));
+                memcpy(encoded.data(), &val, sizeof(val));
+                return true;
+            }
+            case ValueType::INT32: {
+                int32_t val = static_cast<int32_t>(std::stoi(value));
+                encoded.resize(sizeof(val));
+                memcpy(encoded.data(), &val, sizeof(val));
+                return true;
+            }
+            case ValueType::INT64: {
+                int64_t val = static_cast<int64_t>(std::stoll(value));
+                encoded.resize(sizeof(val));
+                memcpy(encoded.data(), &val, sizeof(val));
+                return true;
+            }
+            case ValueType::FLOAT: {
+                float val = std::stof(value);
+                encoded.resize(sizeof(val));
+                memcpy(encoded.data(), &val, sizeof(val));
+                return true;
+            }
+            case ValueType::DOUBLE: {
+                double val = std::stod(value);
+                encoded.resize(sizeof(val));
+                memcpy(encoded.data(), &val, sizeof(val));
+                return true;
+            }
+            case ValueType::STRING: {
+                encoded.assign(value.begin(), value.end());
+                return !encoded.empty();
+            }
+            case ValueType::STRING16: {
+                encoded = utf8ToUtf16(value);
+                return !encoded.empty();
+            }
+            default:
+                return false;
+        }
+    }
+    
+    // Encode the operand of a comparison. between takes "lo hi" and approx takes
+    // "value epsilon"; both become the lower bound followed by the upper bound.
+    bool parseOperand(ValueType type, Comparison comparison, const std::string& value, std::vector<uint8_t>& encoded) {
+        if (!comparisonTakesRange(comparison)) {
+            return parseValue(type, value, encoded);
+        }
+        if (isStringType(type)) {
+            return false;
+        }
+        
+        std::istringstream parts(value);
+        std::string first;
+        std::string second;
+        std::vector<uint8_t> lower;
+        std::vector<uint8_t> upper;
+        if (!(parts >> first >> second) || !parseValue(type, first, lower)) {
+            return false;
+        }
+        
+        if (comparison == COMPARE_BETWEEN) {
+            if (!parseValue(type, second, upper)) {
+                return false;
+            }
+        } else {
+            double epsilon = std::stod(second);
+            if (!(epsilon >= 0)) {
+                return false;
+            }
+            switch (type) {
+                case ValueType::BYTE: approxBounds<uint8_t>(lower, upper, epsilon); break;
+                case ValueType::INT16: approxBounds<int16_t>(lower, upper, epsilon); break;
+                case ValueType::INT32: approxBounds<int32_t>(lower, upper, epsilon); break;
+                case ValueType::INT64: approxBounds<int64_t>(lower, upper, epsilon); break;
+                case ValueType::FLOAT: approxBounds<float>(lower, upper, epsilon); break;
+                case ValueType::DOUBLE: approxBounds<double>(lower, upper, epsilon); break;
+                default: return false;
+            }
+        }
+        
+        encoded = lower;
+        encoded.insert(encoded.end(), upper.begin(), upper.end());
+        return true;
+    }
+    
+    // Create description string for a value
+    std::string formatValue(const uint8_t* data, size_t size, ValueType type) {
+        std::stringstream ss;
+        switch (type) {
+            case ValueType::BYTE:
+                ss << static_cast<int>(loadValue<uint8_t>(data));
+                break;
+            case ValueType::INT16:
+                ss << loadValue<int16_t>(data);
+                break;
+            case ValueType::INT32:
+                ss << loadValue<int32_t>(data);
+                break;
+            case ValueType::INT64:
+                ss << loadValue<int64_t>(data);
+                break;
+            case ValueType::FLOAT:
+                ss << loadValue<float>(data);
+                break;
+            case ValueType::DOUBLE:
+                ss << loadValue<double>(data);
+                break;
+            case ValueType::STRING: {
+                std::string str(reinterpret_cast<const char*>(data), size);
+                ss << "\"" << str << "\"";
+                break;
+            }
+            case ValueType::STRING16:
+                ss << "\"" << utf16ToUtf8(data, size) << "\"";
+                break;
+            default:
+                ss << "Unknown";
+                break;
+        }
+        return ss.str();
+    }
+    
+    // Scan one buffer of target memory. Matches may only start inside the first
+    // startLimit bytes; the remainder is overlap with the next chunk so values that
+    // straddle the chunk boundary are still found.
+    void scanBuffer(const uint8_t* data, size_t length, size_t startLimit, mach_vm_address_t base,
+                    const ScanKernel& kernel, std::vector<size_t>& offsets, ResultStore& hits) {
+        size_t shortest = shortestMatch(kernel);
+        if (length < shortest) {
+            return;
+        }
+        
+        // Start at the first aligned address in the buffer
+        size_t count = std::min(startLimit, length - shortest + 1);
+        size_t skip = static_cast<size_t>((kernel.alignment - base % kernel.alignment) % kernel.alignment);
+        if (skip >= count) {
+            return;
+        }
+        data += skip;
+        base += skip;
+        
+        offsets.clear();
+        kernel.scan(kernel, data, count - skip, offsets);
+        
+        // A short needle near the end of a region has less than a full row behind it
+        size_t full = length - skip;
+        for (size_t offset : offsets) {
+            if (offset + kernel.valueSize <= full) {
+                hits.append(base + offset, data + offset);
+            } else {
+                hits.appendPadded(base + offset, data + offset, full - offset);
+            }
+        }
+    }
+    
+    // Scan one buffer with the kernel of every type of an any scan. The hits of
+    // all kernels are merged in address order and tagged with their type; an
+    // address that matches as several types gives one row per type.
+    void scanBufferAny(const uint8_t* data, size_t length, size_t startLimit, mach_vm_address_t base,
+                       const std::vector<ScanKernel>& kernels, const std::vector<ValueType>& types,
+                       std::vector<std::vector<size_t>>& offsets, ResultStore& hits) {
+        offsets.resize(kernels.size());
+        for (size_t k = 0; k < kernels.size(); k++) {
+            const ScanKernel& kernel = kernels[k];
+            offsets[k].clear();
+            if (length < kernel.valueSize) {
+                continue;
+            }
+            size_t count = std::min(startLimit, length - kernel.valueSize + 1);
+            size_t skip = static_cast<size_t>((kernel.alignment - base % kernel.alignment) % kernel.alignment);
+            if (skip >= count) {
+                continue;
+            }
+            kernel.scan(kernel, data + skip, count - skip, offsets[k]);
+            for (size_t& offset : offsets[k]) {
+                offset += skip;
+            }
+        }
+        
+        // Each list is already sorted; ties keep the order of the type list
+        size_t positions[ValueType::UNKNOWN] = {};
+        while (true) {
+            size_t best = kernels.size();
+            for (size_t k = 0; k < kernels.size(); k++) {
+                if (positions[k] < offsets[k].size() &&
+                    (best == kernels.size() || offsets[k][positions[k]] < offsets[best][positions[best]])) {
+                    best = k;
+                }
+            }
+            if (best == kernels.size()) {
+                break;
+            }
+            size_t offset = offsets[best][positions[best]++];
+            hits.append(base + offset, data + offset, types[best]);
+        }
+    }
+    
+    // Place the members of a group whose first value starts at `start`: each
+    // member takes the first matching position within its reach that doesn't
+    // overlap the members placed before it
+    static bool placeGroup(const uint8_t* data, size_t length, mach_vm_address_t base, size_t start,
+                           const std::vector<ScanKernel>& kernels, const std::vector<GroupMember>& members,
+                           std::vector<size_t>& positions) {
+        positions.assign(1, start);
+        for (size_t m = 1; m < kernels.size(); m++) {
+            const ScanKernel& kernel = kernels[m];
+            size_t low = start > members[m].within ? start - members[m].within : 0;
+            size_t high = std::min(start + members[m].within, length >= kernel.valueSize ? length - kernel.valueSize : 0);
+            low += static_cast<size_t>((kernel.alignment - (base + low) % kernel.alignment) % kernel.alignment);
+            
+            bool placed = false;
+            for (size_t position = low; position <= high && position + kernel.valueSize <= length && !placed; position += kernel.alignment) {
+                bool free = true;
+                for (size_t p = 0; p < positions.size() && free; p++) {
+                    free = position + kernel.valueSize <= positions[p] || positions[p] + kernels[p].valueSize <= position;
+                }
+                if (free && kernel.match(kernel, data + position, data + position)) {
+                    positions.push_back(position);
+                    placed = true;
+                }
+            }
+            if (!placed) {
+                return false;
+            }
+        }
+        return true;
+    }
+    
+    // Scan one buffer for groups. Only the anchor member (the rarest) goes
+    // through its vector kernel; around each of its hits the first member is
+    // tested, and around that the others, all in the buffer at hand. A group
+    // belongs to the buffer its first member starts in, counted from `window`
+    // bytes in so the members before it are in the buffer too (from 0 in the
+    // first buffer of a region); the overlap read past the buffer covers the
+    // members after it. Returns the number of groups.
+    size_t scanBufferGroup(const uint8_t* data, size_t length, size_t startLimit, mach_vm_address_t base, bool regionStart,
+                           const std::vector<ScanKernel>& kernels, const std::vector<GroupMember>& members,
+                           size_t anchor, size_t window, std::vector<size_t>& offsets, std::vector<size_t>& starts,
+                           std::vector<std::pair<size_t, size_t>>& rows, ResultStore& hits) {
+        const ScanKernel& anchorKernel = kernels[anchor];
+        const ScanKernel& firstKernel = kernels[0];
+        size_t first = regionStart ? 0 : window;
+        size_t last = std::min(startLimit + window, length);
+        if (length < anchorKernel.valueSize || length < firstKernel.valueSize || first >= last) {
+            return 0;
+        }
+        
+        size_t count = length - anchorKernel.valueSize + 1;
+        size_t skip = static_cast<size_t>((anchorKernel.alignment - base % anchorKernel.alignment) % anchorKernel.alignment);
+        if (skip >= count) {
+            return 0;
+        }
+        offsets.clear();
+        anchorKernel.scan(anchorKernel, data + skip, count - skip, offsets);
+        
+        // Starts of the first member that complete a group
+        std::vector<size_t> positions;
+        starts.clear();
+        for (size_t offset : offsets) {
+            size_t hit = offset + skip;
+            size_t reach = anchor == 0 ? 0 : members[anchor].within;
+            size_t low = std::max(first, hit > reach ? hit - reach : 0);
+            size_t high = std::min({ hit + reach, last - 1, length - firstKernel.valueSize });
+            low += static_cast<size_t>((firstKernel.alignment - (base + low) % firstKernel.alignment) % firstKernel.alignment);
+            for (size_t start = low; start <= high; start += firstKernel.alignment) {
+                if (firstKernel.match(firstKernel, data + start, data + start) &&
+                    placeGroup(data, length, base, start, kernels, members, positions)) {
+                    starts.push_back(start);
+                }
+            }
+        }
+        std::sort(starts.begin(), starts.end());
+        starts.erase(std::unique(starts.begin(), starts.end()), starts.end());
+        
+        // A group lists every value in reach that matches one of its members, not
+        // just the ones placed. Groups close together may share values; each is
+        // listed once.
+        rows.clear();
+        for (size_t start : starts) {
+            rows.push_back(std::make_pair(start, static_cast<size_t>(members[0].type)));
+            for (size_t m = 1; m < kernels.size(); m++) {
+                const ScanKernel& kernel = kernels[m];
+                size_t low = start > members[m].within ? start - members[m].within : 0;
+                low += static_cast<size_t>((kernel.alignment - (base + low) % kernel.alignment) % kernel.alignment);
+                for (size_t position = low; position <= start + members[m].within && position + kernel.valueSize <= length;
+                     position += kernel.alignment) {
+                    bool apart = position + kernel.valueSize <= start || start + firstKernel.valueSize <= position;
+                    if (apart && kernel.match(kernel, data + position, data + position)) {
+                        rows.push_back(std::make_pair(position, static_cast<size_t>(members[m].type)));
+                    }
+                }
+            }
+        }
+        std::sort(rows.begin(), rows.end());
+        rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+        for (const auto& row : rows) {
+            hits.append(base + row.first, data + row.first, static_cast<ValueType>(row.second));
+        }
+        return starts.size();
+    }
+    
+    // Kernels for the members of a group, and the one to run first: the member
+    // with the fewest hits in a sample of the chunks to scan
+    bool makeGroupKernels(const std::vector<GroupMember>& members, const std::vector<ScanChunk>& chunks,
+                          std::vector<ScanKernel>& kernels, size_t& anchor) {
+        for (const GroupMember& member : members) {
+            std::vector<uint8_t> operand;
+            ScanKernel kernel;
+            if (isStringType(member.type) || member.type == ValueType::ANY || comparisonNeedsPrevious(member.comparison) ||
+                member.comparison == COMPARE_NOCASE || !parseOperand(member.type, member.comparison, member.value, operand) ||
+                !makeScanKernel(member.type, member.comparison, operand, kernel, useSimd, alignment)) {
+                return false;
+            }
+            kernels.push_back(kernel);
+        }
+        
+        std::vector<size_t> counts(kernels.size(), 0);
+        std::vector<uint8_t> sample(GROUP_SAMPLE_BYTES);
+        std::vector<size_t> offsets;
+        size_t step = std::max<size_t>(1, chunks.size() / GROUP_SAMPLE_CHUNKS);
+        for (size_t i = 0; i < chunks.size(); i += step) {
+            size_t size = static_cast<size_t>(std::min<mach_vm_size_t>(GROUP_SAMPLE_BYTES, chunks[i].size));
+            if (!readTargetMemory(targetTask, chunks[i].start, sample.data(), size)) {
+                continue;
+            }
+            for (size_t k = 0; k < kernels.size(); k++) {
+                if (size >= kernels[k].valueSize) {
+                    offsets.clear();
+                    kernels[k].scan(kernels[k], sample.data(), size - kernels[k].valueSize + 1, offsets);
+                    counts[k] += offsets.size();
+                }
+            }
+        }
+        anchor = static_cast<size_t>(std::min_element(counts.begin(), counts.end()) - counts.begin());
+        return true;
+    }
+    
+    // Kernels for each of the given types that can represent the value. Integer
+    // types are left out for values that aren't whole numbers (the epsilon of
+    // approx may still be fractional).
+    bool makeAnyKernels(const std::vector<ValueType>& members, const std::string& value, Comparison comparison,
+                        std::vector<ScanKernel>& kernels, std::vector<ValueType>& types) {
+        std::istringstream parts(value);
+        std::string part;
+        bool whole = true;
+        for (size_t i = 0; parts >> part && !(comparison == COMPARE_APPROX && i > 0); i++) {
+            size_t used = 0;
+            try {
+                std::stoll(part, &used);
+            } catch (const std::exception&) {
+                used = 0;
+            }
+            whole = whole && used == part.size();
+        }
+        
+        for (ValueType member : members) {
+            std::vector<uint8_t> operand;
+            ScanKernel kernel;
+            if (isIntegerType(member) && !whole && !comparisonNeedsPrevious(comparison)) {
+                continue;
+            }
+            bool parsed = comparisonNeedsPrevious(comparison) ? parseValue(member, "0", operand)
+                                                              : parseOperand(member, comparison, value, operand);
+            if (parsed && makeScanKernel(member, comparison, operand, kernel, useSimd, alignment)) {
+                kernels.push_back(kernel);
+                types.push_back(member);
+            }
+        }
+        return !kernels.empty();
+    }
+    
+    // First scan - find values. With a group, type, value and comparison are
+    // ignored and the scan finds the members of the group instead (see firstScanGroup).
+    void firstScan(ValueType type, const std::string& value, Comparison comparison,
+                   const RegionFilter& filter = RegionFilter(), const std::vector<GroupMember>* group = nullptr) {
+        clearResults();
+        
+        std::vector<uint8_t> targetValue;
+        ScanKernel kernel;
+        std::vector<ScanKernel> anyKernels;
+        std::vector<ValueType> kernelTypes;
+        std::vector<ScanKernel> groupKernels;
+        size_t groupWindow = 0;
+        if (group) {
+            type = ValueType::ANY;
+            kernel.valueSize = 0;
+            for (const GroupMember& member : *group) {
+                kernel.valueSize = std::max(kernel.valueSize, valueTypeSize(member.type));
+                groupWindow = std::max(groupWindow, member.within);
+            }
+        } else if (type == ValueType::ANY) {
+            if (comparisonNeedsPrevious(comparison) || comparison == COMPARE_NOCASE ||
+                !makeAnyKernels(anyTypes, value, comparison, anyKernels, kernelTypes)) {
+                scanJob.errorConsole() << "Unsupported value type" << std::endl;
+                return;
+            }
+            kernel = anyKernels[0];
+            for (const ScanKernel& member : anyKernels) {
+                kernel.valueSize = std::max(kernel.valueSize, member.valueSize);
+            }
+        } else if (isStringType(type) && (comparison == COMPARE_EXACT || comparison == COMPARE_NOCASE)) {
+            // "a|b|c" looks for several strings in the same pass
+            std::vector<std::vector<uint8_t>> needles;
+            std::stringstream list(value);
+            std::string part;
+            while (std::getline(list, part, '|')) {
+                if (!parseValue(type, part, targetValue)) {
+                    scanJob.errorConsole() << "Empty string in search value" << std::endl;
+                    return;
+                }
+                needles.push_back(targetValue);
+            }
+            if (!makeStringKernel(type, needles, comparison == COMPARE_NOCASE, kernel, useSimd, alignment)) {
+                scanJob.errorConsole() << "A string scan takes 1 to " << STRING_NEEDLE_MAX << " strings" << std::endl;
+                return;
+            }
+            stringSearch = kernel;
+        } else if (!parseOperand(type, comparison, value, targetValue) || !makeScanKernel(type, comparison, targetValue, kernel, useSimd, alignment) || !kernel.scan) {
+            scanJob.errorConsole() << "Unsupported value type" << std::endl;
+            return;
+        }
+        size_t valueSize = kernel.valueSize;
+        
+        if (!group) {
+            scanJob.console() << "Starting first scan, please wait..." << std::endl;
+        }
+        prepareMemoryRegions();
+        
+        // Split readable regions into fixed-size chunks for the worker pool
+        std::vector<ScanChunk> chunks;
+        std::vector<mach_vm_address_t> regionStarts;
+        uint64_t totalBytes = 0;
+        for (size_t i = 0; i < memoryRegions.size(); i++) {
+            const MemoryRegion& region = memoryRegions[i];
+            
+            // Skip non-readable regions and the ones the filter leaves out
+            if (!region.readable || !filter.matches(region)) {
+                continue;
+            }
+            
+            for (mach_vm_size_t offset = 0; offset < region.size; offset += SCAN_CHUNK_SIZE) {
+                ScanChunk chunk;
+                chunk.region = i;
+                chunk.start = region.start + offset;
+                chunk.size = std::min<mach_vm_size_t>(SCAN_CHUNK_SIZE, region.size - offset);
+                chunks.push_back(chunk);
+            }
+            regionStarts.push_back(region.start);
+            totalBytes += region.size;
+        }
+        scanJob.setTotal(totalBytes);
+        
+        // Groups match their rarest member first, and read far enough past each
+        // window to see the members on either side of the first one
+        size_t anchor = 0;
+        size_t overlap = valueSize - 1;
+        if (group) {
+            if (!makeGroupKernels(*group, chunks, groupKernels, anchor)) {
+                scanJob.errorConsole() << "Unsupported group member" << std::endl;
+                return;
+            }
+            overlap = 2 * groupWindow + valueSize - 1;
+            const GroupMember& rarest = (*group)[anchor];
+            scanJob.console() << "Starting group scan for " << group->size() << " values, matching "
+                              << valueTypeKeyword(rarest.type) << " " << rarest.value << " first, please wait..." << std::endl;
+        }
+        
+        // Each worker collects hits into its own buffer and remembers which chunk
+        // (or pipeline window) produced which span, so the buffers can be stitched
+        // back in address order.
+        struct HitSpan {
+            size_t order;
+            size_t worker;
+            size_t first;
+            size_t last;
+        };
+        struct WorkerHits {
+            ResultStore hits;
+            std::vector<HitSpan> spans;
+            std::vector<size_t> offsets;
+            std::vector<std::vector<size_t>> typedOffsets;
+            std::vector<size_t> groupStarts;
+            std::vector<std::pair<size_t, size_t>> groupRows;
+            size_t groups;
+            std::unique_ptr<RegionReader> reader;
+            
+            WorkerHits() : groups(0) {}
+        };
+        std::vector<WorkerHits> workerHits(workerPool->size());
+        for (auto& local : workerHits) {
+            local.hits.reset(type, valueSize);
+        }
+        
+        auto scanData = [&](WorkerHits& local, const uint8_t* data, size_t length, size_t startLimit, mach_vm_address_t address) {
+            StatTimer timer(STAT_COMPARE_NANOS);
+            threadStats().add(STAT_COMPARE_BYTES, startLimit);
+            if (group) {
+                bool regionStart = std::binary_search(regionStarts.begin(), regionStarts.end(), address);
+                local.groups += scanBufferGroup(data, length, startLimit, address, regionStart, groupKernels, *group, anchor,
+                                                groupWindow, local.offsets, local.groupStarts, local.groupRows, local.hits);
+            } else if (anyKernels.empty()) {
+                scanBuffer(data, length, startLimit, address, kernel, local.offsets, local.hits);
+            } else {
+                scanBufferAny(data, length, startLimit, address, anyKernels, kernelTypes, local.typedOffsets, local.hits);
+            }
+        };
+        auto showProgress = [&]() { printProgress("Scanning"); };
+        auto stopRequested = [&]() { return scanJob.cancelled(); };
+        
+        // Read overlap bytes past each window so boundary matches aren't lost.
+        // Copied reads go through the read-ahead pipeline; a zero-copy mapping has
+        // no copy to overlap, so those workers map and match their own chunks.
+        if (pipelined && !zeroCopy) {
+            std::vector<PipelineWindow> windows;
+            for (const ScanChunk& chunk : chunks) {
+                const MemoryRegion& region = memoryRegions[chunk.region];
+                appendPipelineWindows(windows, chunk.start, chunk.size, region.start + region.size, overlap);
+            }
+            runPipeline(targetTask, *workerPool, getReaderThreads(), windows,
+                [&](size_t worker, size_t window, const uint8_t* data, size_t length, size_t startLimit, mach_vm_address_t address) {
+                    WorkerHits& local = workerHits[worker];
+                    HitSpan span = { window, worker, local.hits.size(), 0 };
+                    {
+                        StatTimer timer(STAT_COUNT, "match", address, startLimit);
+                        scanData(local, data, length, startLimit, address);
+                    }
+                    span.last = local.hits.size();
+                    if (span.last > span.first) {
+                        local.spans.push_back(span);
+                        scanJob.addHits(local.hits, span.first, span.last);
+                    }
+                    scanJob.advance(startLimit);
+                }, showProgress, stopRequested);
+        } else {
+            workerPool->run(chunks.size(), [&](size_t worker, size_t task) {
+                if (scanJob.cancelled()) {
+                    return;
+                }
+                const ScanChunk& chunk = chunks[task];
+                const MemoryRegion& region = memoryRegions[chunk.region];
+                WorkerHits& local = workerHits[worker];
+                if (!local.reader) {
+                    local.reader.reset(new RegionReader(targetTask, zeroCopy));
+                }
+                
+                HitSpan span = { task, worker, local.hits.size(), 0 };
+                {
+                    StatTimer timer(STAT_COUNT, "scan", chunk.start, chunk.size);
+                    local.reader->stream(chunk.start, chunk.size, region.start + region.size, overlap,
+                        [&](const uint8_t* data, size_t length, size_t startLimit, mach_vm_address_t address) {
+                            scanData(local, data, length, startLimit, address);
+                        });
+                }
+                span.last = local.hits.size();
+                if (span.last > span.first) {
+                    local.spans.push_back(span);
+                    scanJob.addHits(local.hits, span.first, span.last);
+                }
+                
+                scanJob.advance(chunk.size);
+            }, showProgress);
+        }
+        
+        // Merge worker buffers in chunk (and therefore address) order. The runs of
+        // one pipeline window share its index and are already in order.
+        std::vector<HitSpan> spans;
+        for (const auto& local : workerHits) {
+            spans.insert(spans.end(), local.spans.begin(), local.spans.end());
+        }
+        std::stable_sort(spans.begin(), spans.end(), [](const HitSpan& a, const HitSpan& b) { return a.order < b.order; });
+        
+        size_t totalHits = 0;
+        for (const auto& span : spans) {
+            totalHits += span.last - span.first;
+        }
+        
+        scanResults.reset(type, valueSize);
+        scanResults.addresses.reserve(totalHits);
+        scanResults.values.reserve(totalHits * valueSize);
+        if (!anyKernels.empty() || group) {
+            scanResults.types.reserve(totalHits);
+        }
+        for (const auto& span : spans) {
+            scanResults.append(workerHits[span.worker].hits, span.first, span.last);
+        }
+        
+        // Members after the first may lie in the next window, and groups on either
+        // side of a window edge may share one
+        if (group) {
+            size_t groups = 0;
+            for (const auto& local : workerHits) {
+                groups += local.groups;
+            }
+            scanResults.sortByAddress();
+            scanResults.removeDuplicates();
+            scanJob.console() << "\r" << Color::CLEAR_LINE << (scanJob.cancelled() ? "Scan cancelled. Found " : "Scan complete. Found ")
+                              << groups << " groups (" << scanResults.size() << " values)"
+                              << (scanJob.cancelled() ? " in the memory scanned so far." : ".") << std::endl;
+            return;
+        }
+        
+        // A cancelled scan keeps the hits of the memory it got through
+        if (scanJob.cancelled()) {
+            scanJob.console() << "\r" << Color::CLEAR_LINE << "Scan cancelled. Found " << scanResults.size() << " matches in the memory scanned so far." << std::endl;
+        } else {
+            scanJob.console() << "\r" << Color::CLEAR_LINE << "Scan complete. Found " << scanResults.size() << " matches." << std::endl;
+        }
+    }
+    
+    // Group scan: several values close together, such as the fields of a struct,
+    // found in a single pass instead of one scan per value and an intersection.
+    // The results are every member of every group, each tagged with its type.
+    void firstScanGroup(const std::vector<GroupMember>& members, const RegionFilter& filter = RegionFilter()) {
+        if (members.size() < 2 || members.size() > GROUP_MEMBERS_MAX) {
+            scanJob.errorConsole() << "A group scan takes 2 to " << GROUP_MEMBERS_MAX << " values" << std::endl;
+            return;
+        }
+        for (const GroupMember& member : members) {
+            if (member.within > GROUP_WITHIN_MAX) {
+                scanJob.errorConsole() << "Group members must be within " << GROUP_WITHIN_MAX << " bytes of the first" << std::endl;
+                return;
+            }
+        }
+        firstScan(ValueType::ANY, "", COMPARE_EXACT, filter, &members);
+    }
+    
+    // Progress of a running scan: the progress callback, and the progress line of
+    // a foreground scan (background scans are polled with status)
+    void printProgress(const char* activity) {
+        if (progressCallback) {
+            progressCallback(scanJob.bytesScanned(), scanJob.bytesToScan(), scanJob.hits());
+        }
+        if (showProgress && !scanJob.inBackground()) {
+            out() << "\r" << activity << "... " << scanJob.progressText() << Color::CLEAR_LINE << std::flush;
+        }
+    }
+    
+    // Next scan - filter existing results
+    void nextScan(ValueType type, const std::string& value, Comparison comparison) {
+        if (scanResults.empty() && !bitmapScan) {
+            scanJob.errorConsole() << "No previous scan results to filter" << std::endl;
+            return;
+        }
+        
+        // any keeps the type of the results. On the results of an any scan each row
+        // is filtered as its own type; naming a type keeps only the rows of that type.
+        if (type == ValueType::ANY && scanResults.type != ValueType::ANY) {
+            type = bitmapScan ? bitmapScan->type : scanResults.type;
+        }
+        bool typed = !bitmapScan && scanResults.type == ValueType::ANY;
+        ScanKernel kernel;
+        std::vector<ScanKernel> rowKernels(ValueType::UNKNOWN);
+        if (typed) {
+            std::vector<ValueType> members;
+            for (int member = ValueType::BYTE; member <= ValueType::DOUBLE; member++) {
+                if (type == ValueType::ANY || type == member) {
+                    members.push_back(static_cast<ValueType>(member));
+                }
+            }
+            std::vector<ScanKernel> kernels;
+            std::vector<ValueType> kernelTypes;
+            if (!makeAnyKernels(members, value, comparison, kernels, kernelTypes)) {
+                scanJob.errorConsole() << "Unsupported value type" << std::endl;
+                return;
+            }
+            for (size_t k = 0; k < kernels.size(); k++) {
+                rowKernels[kernelTypes[k]] = kernels[k];
+            }
+            type = ValueType::ANY;
+        } else {
+            // Parse search value; changed/unchanged compare against the previous value instead
+            std::vector<uint8_t> targetValue;
+            if (comparisonNeedsPrevious(comparison)) {
+                if (isStringType(type)) {
+                    targetValue.resize(scanResults.valueSize);
+                } else {
+                    parseValue(type, "0", targetValue);
+                }
+            } else if (!parseOperand(type, comparison, value, targetValue)) {
+                scanJob.errorConsole() << "Unsupported value type" << std::endl;
+                return;
+            }
+            if (!makeScanKernel(type, comparison, targetValue, kernel)) {
+                scanJob.errorConsole() << "Unsupported value type" << std::endl;
+                return;
+            }
+        }
+        size_t valueSize = typed ? scanResults.valueSize : kernel.valueSize;
+        
+        if (bitmapScan) {
+            prepareMemoryRegions();
+            nextScanBitmap(kernel);
+            return;
+        }
+        
+        // Previous values of a different width can't be compared
+        if (valueSize != scanResults.valueSize) {
+            scanJob.errorConsole() << "Value size doesn't match the previous scan (" << scanResults.valueSize << " bytes)" << std::endl;
+            return;
+        }
+        
+        // Pick up region map changes before reading anything
+        prepareMemoryRegions();
+        
+        // Filter into a new store; the current one becomes the undo generation
+        bool atRoot = scanHistory.empty();
+        if (atRoot) {
+            scanResults.sortByAddress();
+        }
+        const ResultStore& previous = scanResults;
+        
+        // Rows of an any scan are read and compared at the width of their own type
+        auto rowKernel = [&](size_t row) -> const ScanKernel* {
+            if (!typed) {
+                return &kernel;
+            }
+            const ScanKernel& member = rowKernels[previous.rowType(row)];
+            return member.match ? &member : nullptr;
+        };
+        
+        scanJob.console() << "Starting next scan, filtering " << previous.size() << " addresses..." << std::endl;
+        
+        // Group nearby candidates so each group is fetched with a single read
+        struct ReadGroup {
+            size_t first;
+            size_t last;
+            mach_vm_address_t start;
+            mach_vm_address_t end;
+        };
+        std::vector<ReadGroup> groups;
+        uint64_t groupBytes = 0;
+        const PodBuffer<mach_vm_address_t>& addresses = previous.addresses;
+        
+        // Candidates that are no longer mapped readable drop out without a read.
+        // Addresses are sorted, so the region lookup is only redone on leaving it.
+        const MemoryRegion* region = nullptr;
+        auto readable = [&](mach_vm_address_t address, size_t width) {
+            if (!region || address < region->start || address - region->start >= region->size) {
+                region = memoryRegions.find(address);
+            }
+            if (!region || !region->readable) {
+                return false;
+            }
+            return address + width <= region->start + region->size || memoryRegions.contains(address, width);
+        };
+        
+        for (size_t i = 0; i < previous.size(); ) {
+            if (!rowKernel(i) || !readable(addresses[i], previous.rowSize(i))) {
+                i++;
+                continue;
+            }
+            
+            // A group stays inside one region so its read can't hit an unmapped gap
+            mach_vm_address_t regionEnd = region->start + region->size;
+            ReadGroup group = { i, i + 1, addresses[i], addresses[i] + previous.rowSize(i) };
+            while (group.last < previous.size()) {
+                mach_vm_address_t next = addresses[group.last];
+                size_t width = previous.rowSize(group.last);
+                if (next > group.end + READ_GROUP_GAP || next + width - group.start > SCAN_WINDOW_SIZE ||
+                    next + width > regionEnd) {
+                    break;
+                }
+                group.end = std::max<mach_vm_address_t>(group.end, next + width);
+                group.last++;
+            }
+            groups.push_back(group);
+            groupBytes += group.end - group.start;
+            i = group.last;
+        }
+        scanJob.setTotal(groupBytes);
+        
+        struct MatchSpan {
+            size_t group;
+            size_t worker;
+            size_t first;
+            size_t last;
+        };
+        struct WorkerMatches {
+            ResultStore matches;
+            PodBuffer<size_t> indices;
+            std::vector<MatchSpan> spans;
+            std::unique_ptr<RegionReader> reader;
+        };
+        std::vector<WorkerMatches> workerMatches(workerPool->size());
+        
+        workerPool->run(groups.size(), [&](size_t worker, size_t task) {
+            const ReadGroup& group = groups[task];
+            WorkerMatches& local = workerMatches[worker];
+            if (!local.reader) {
+                local.reader.reset(new RegionReader(targetTask, zeroCopy));
+                local.matches.reset(type, valueSize);
+            }
+            MatchSpan span = { task, worker, local.matches.size(), 0 };
+            
+            // After a cancel the groups not compared yet keep their rows as they are
+            if (scanJob.cancelled()) {
+                local.matches.append(previous, group.first, group.last);
+                for (size_t row = group.first; row < group.last; row++) {
+                    local.indices.push_back(atRoot ? row : resultIndices[row]);
+                }
+                span.last = local.matches.size();
+                local.spans.push_back(span);
+                return;
+            }
+            
+            // Unreadable pages are skipped; candidates on them simply drop out
+            StatTimer timer(STAT_COUNT, "rescan", group.start, group.end - group.start);
+            size_t cursor = group.first;
+            local.reader->stream(group.start, group.end - group.start, group.end, 0,
+                [&](const uint8_t* data, size_t length, size_t, mach_vm_address_t address) {
+                    StatTimer compareTimer(STAT_COMPARE_NANOS);
+                    threadStats().add(STAT_COMPARE_BYTES, length);
+                    while (cursor < group.last && addresses[cursor] < address) {
+                        cursor++;
+                    }
+                    for (; cursor < group.last && addresses[cursor] + previous.rowSize(cursor) <= address + length; cursor++) {
+                        const ScanKernel* match = rowKernel(cursor);
+                        const uint8_t* current = data + (addresses[cursor] - address);
+                        if (!match || !match->match(*match, current, previous.value(cursor))) {
+                            continue;
+                        }
+                        if (typed) {
+                            local.matches.append(addresses[cursor], current, previous.rowType(cursor));
+                        } else {
+                            local.matches.append(addresses[cursor], current);
+                        }
+                        local.indices.push_back(atRoot ? cursor : resultIndices[cursor]);
+                    }
+                });
+            span.last = local.matches.size();
+            if (span.last > span.first) {
+                local.spans.push_back(span);
+                scanJob.addHits(local.matches, span.first, span.last);
+            }
+            scanJob.advance(group.end - group.start);
+        }, [&]() {
+            printProgress("Filtering");
+        });
+        
+        // Stitch worker buffers back together in address order
+        std::vector<MatchSpan> spans;
+        for (const auto& local : workerMatches) {
+            spans.insert(spans.end(), local.spans.begin(), local.spans.end());
+        }
+        std::sort(spans.begin(), spans.end(), [](const MatchSpan& a, const MatchSpan& b) { return a.group < b.group; });
+        
+        ResultStore filtered;
+        PodBuffer<size_t> filteredIndices;
+        filtered.reset(type, valueSize);
+        for (const auto& span : spans) {
+            filtered.append(workerMatches[span.worker].matches, span.first, span.last);
+            filteredIndices.append(workerMatches[span.worker].indices.data() + span.first, span.last - span.first);
+        }
+        
+        // Keep the previous step for undo. Only its values and first-scan row
+        // indices are kept; the addresses of the first scan are kept once.
+        ScanGeneration generation;
+        generation.type = scanResults.type;
+        generation.valueSize = scanResults.valueSize;
+        std::swap(generation.indices, resultIndices);
+        std::swap(generation.values, scanResults.values);
+        if (atRoot) {
+            std::swap(rootAddresses, scanResults.addresses);
+            std::swap(rootTypes, scanResults.types);
+        }
+        scanHistory.push_back(std::move(generation));
+        
+        std::swap(scanResults, filtered);
+        std::swap(resultIndices, filteredIndices);
+        
+        if (scanJob.cancelled()) {
+            scanJob.console() << "\r" << Color::CLEAR_LINE << "Filtering cancelled. Kept " << scanResults.size()
+                              << " results; the ones not compared yet are unchanged." << std::endl;
+        } else {
+            scanJob.console() << "\r" << Color::CLEAR_LINE << "Filtering complete. Found " << scanResults.size() << " matches." << std::endl;
+        }
+    }
+    
+    // Step back to the results before the last next scan
+    bool undoScan() {
+        if (scanHistory.empty()) {
+            err() << "Nothing to undo" << std::endl;
+            return false;
+        }
+        
+        ScanGeneration& generation = scanHistory.back();
+        ResultStore restored;
+        restored.reset(generation.type, generation.valueSize);
+        if (scanHistory.size() == 1) {
+            std::swap(restored.addresses, rootAddresses);
+            std::swap(restored.types, rootTypes);
+        } else {
+            restored.addresses.reserve(generation.indices.size());
+            for (size_t i = 0; i < generation.indices.size(); i++) {
+                restored.addresses.push_back(rootAddresses[generation.indices[i]]);
+                if (!rootTypes.empty()) {
+                    restored.types.push_back(rootTypes[generation.indices[i]]);
+                }
+            }
+        }
+        std::swap(restored.values, generation.values);
+        std::swap(resultIndices, generation.indices);
+        std::swap(scanResults, restored);
+        scanHistory.pop_back();
+        
+        out() << "Restored " << scanResults.size() << " results (" << scanHistory.size() << " more undo steps)" << std::endl;
+        return true;
+    }
+    
+    // Drop all results, candidates and undo history
+    void clearResults() {
+        scanResults.clear();
+        rootAddresses.clear();
+        rootTypes.clear();
+        resultIndices.clear();
+        scanHistory.clear();
+        bitmapScan.reset();
+        stringSearch.needles.clear();
+    }
+    
+    // Results of a multi-string scan are as wide as the longest string; show each
+    // as the string it matched (while it still does)
+    size_t resultDisplaySize(size_t index) const {
+        const uint8_t* value = scanResults.value(index);
+        if (stringSearch.needles.size() > 1) {
+            for (const StringNeedle& needle : stringSearch.needles) {
+                if (stringNeedleMatches(stringSearch, needle, value)) {
+                    return needle.bytes.size();
+                }
+            }
+        }
+        return scanResults.rowSize(index);
+    }
+    
+    // First scan for an unknown initial value. Every aligned slot of every readable
+    // region becomes a candidate, tracked as one bit in a per-region bitmap, and the
+    // memory itself is kept as a deduplicated page snapshot for the next comparison.
+    void firstScanUnknown(ValueType type, const RegionFilter& filter = RegionFilter()) {
+        clearResults();
+        
+        std::vector<uint8_t> zero;
+        if (isStringType(type) || !parseValue(type, "0", zero)) {
+            scanJob.errorConsole() << "Unknown value scans need a numeric type" << std::endl;
+            return;
+        }
+        
+        // Slots never straddle a page when aligned to at least the value size
+        std::unique_ptr<BitmapScan> scan(new BitmapScan());
+        scan->type = type;
+        scan->valueSize = zero.size();
+        scan->alignment = std::max(alignment, naturalAlignment(type));
+        scan->snapshot.reset(new PageStore(vm_page_size));
+        scan->candidates = 0;
+        
+        scanJob.console() << "Starting unknown value scan, please wait..." << std::endl;
+        prepareMemoryRegions();
+        
+        std::vector<ScanChunk> chunks;
+        uint64_t totalBytes = 0;
+        for (const MemoryRegion& region : memoryRegions) {
+            if (!region.readable || !filter.matches(region)) {
+                continue;
+            }
+            addCandidateRegion(*scan, region.start, region.size, chunks);
+            totalBytes += region.size;
+        }
+        
+        scanJob.setTotal(totalBytes);
+        std::vector<std::unique_ptr<RegionReader>> readers(workerPool->size());
+        BitmapScan& state = *scan;
+        size_t pageSize = vm_page_size;
+        size_t slotsPerPage = pageSize / state.alignment;
+        
+        // Chunks left after a cancel aren't tracked
+        workerPool->run(chunks.size(), [&](size_t worker, size_t task) {
+            if (scanJob.cancelled()) {
+                return;
+            }
+            const ScanChunk& chunk = chunks[task];
+            CandidateRegion& candidates = state.regions[chunk.region];
+            if (!readers[worker]) {
+                readers[worker].reset(new RegionReader(targetTask, zeroCopy));
+            }
+            size_t slots = candidateSlots(candidates.size, state.valueSize, state.alignment);
+            std::vector<uint8_t> tail;
+            
+            StatTimer timer(STAT_COUNT, "snapshot", chunk.start, chunk.size);
+            readers[worker]->stream(chunk.start, chunk.size, chunk.start + chunk.size, 0,
+                [&](const uint8_t* data, size_t length, size_t, mach_vm_address_t address) {
+                    StatTimer compareTimer(STAT_COMPARE_NANOS);
+                    threadStats().add(STAT_COMPARE_BYTES, length);
+                    for (size_t offset = 0; offset < length; offset += pageSize) {
+                        const uint8_t* page = pagePointer(data + offset, length - offset, tail);
+                        size_t pageIndex = static_cast<size_t>((address + offset - candidates.start) / pageSize);
+                        candidates.pages[pageIndex] = state.snapshot->add(page);
+                        fillBits(candidates.bits, std::min(slots, pageIndex * slotsPerPage),
+                                 std::min(slots, (pageIndex + 1) * slotsPerPage), true);
+                    }
+                });
+            scanJob.advance(chunk.size);
+        }, [&]() {
+            printProgress("Scanning");
+        });
+        
+        for (CandidateRegion& candidates : state.regions) {
+            candidates.candidates = countBits(candidates.bits);
+            state.candidates += candidates.candidates;
+        }
+        
+        scanJob.console() << "\r" << Color::CLEAR_LINE << (scanJob.cancelled() ? "Scan cancelled" : "Scan complete")
+                          << ". Tracking " << state.candidates << " candidates ("
+                          << state.snapshot->storedBytes() / (1024 * 1024) << " MB snapshot)." << std::endl;
+        
+        bitmapScan = std::move(scan);
+        if (bitmapScan->candidates <= BITMAP_LIST_THRESHOLD) {
+            materializeBitmap();
+        }
+    }
+    
+    // Register one region (and its scan chunks) with a bitmap scan
+    void addCandidateRegion(BitmapScan& scan, mach_vm_address_t start, mach_vm_size_t size, std::vector<ScanChunk>& chunks) {
+        size_t pageSize = vm_page_size;
+        CandidateRegion candidates;
+        candidates.start = start;
+        candidates.size = size;
+        candidates.bits.assign((candidateSlots(size, scan.valueSize, scan.alignment) + 63) / 64, 0);
+        candidates.pages.assign(static_cast<size_t>((size + pageSize - 1) / pageSize), PageStore::NO_PAGE);
+        candidates.candidates = 0;
+        
+        for (mach_vm_size_t offset = 0; offset < size; offset += SCAN_CHUNK_SIZE) {
+            ScanChunk chunk;
+            chunk.region = scan.regions.size();
+            chunk.start = start + offset;
+            chunk.size = std::min<mach_vm_size_t>(SCAN_CHUNK_SIZE, size - offset);
+            chunks.push_back(chunk);
+        }
+        scan.regions.push_back(std::move(candidates));
+    }
+    
+    // A full page at data, zero-padding a short tail into scratch
+    static const uint8_t* pagePointer(const uint8_t* data, size_t available, std::vector<uint8_t>& scratch) {
+        size_t pageSize = vm_page_size;
+        if (available >= pageSize) {
+            return data;
+        }
+        scratch.assign(pageSize, 0);
+        memcpy(scratch.data(), data, available);
+        return scratch.data();
+    }
+    
+    // Next scan over a bitmap candidate set. Each surviving page is compared slot by
+    // slot against its snapshot page and re-snapshotted only if candidates remain.
+    void nextScanBitmap(const ScanKernel& kernel) {
+        BitmapScan& state = *bitmapScan;
+        if (kernel.valueSize != state.valueSize) {
+            scanJob.errorConsole() << "Value size doesn't match the previous scan (" << state.valueSize << " bytes)" << std::endl;
+            return;
+        }
+        
+        scanJob.console() << "Starting next scan, filtering " << state.candidates << " candidates..." << std::endl;
+        
+        size_t pageSize = vm_page_size;
+        size_t slotsPerPage = pageSize / state.alignment;
+        std::unique_ptr<PageStore> snapshot(new PageStore(pageSize));
+        std::vector<uint8_t> zeroPage(pageSize, 0);
+        
+        // Only chunks that still hold candidates need reading
+        std::vector<ScanChunk> chunks;
+        std::vector<std::vector<uint32_t>> newPages(state.regions.size());
+        uint64_t totalBytes = 0;
+        for (size_t i = 0; i < state.regions.size(); i++) {
+            CandidateRegion& candidates = state.regions[i];
+            newPages[i].assign(candidates.pages.size(), PageStore::NO_PAGE);
+            if (candidates.candidates == 0) {
+                continue;
+            }
+            for (mach_vm_size_t offset = 0; offset < candidates.size; offset += SCAN_CHUNK_SIZE) {
+                ScanChunk chunk;
+                chunk.region = i;
+                chunk.start = candidates.start + offset;
+                chunk.size = std::min<mach_vm_size_t>(SCAN_CHUNK_SIZE, candidates.size - offset);
+                chunks.push_back(chunk);
+                totalBytes += chunk.size;
+            }
+        }
+        scanJob.setTotal(totalBytes);
+        
+        std::atomic<uint64_t> pagesRead(0);
+        std::atomic<uint64_t> pagesUnchanged(0);
+        std::vector<std::unique_ptr<RegionReader>> readers(workerPool->size());
+        bool dirtyOnly = rescanMode == RESCAN_DIRTY;
+        
+        workerPool->run(chunks.size(), [&](size_t worker, size_t task) {
+            const ScanChunk& chunk = chunks[task];
+            CandidateRegion& candidates = state.regions[chunk.region];
+            std::vector<uint32_t>& pages = newPages[chunk.region];
+            if (!readers[worker]) {
+                readers[worker].reset(new RegionReader(targetTask, zeroCopy));
+            }
+            size_t slots = candidateSlots(candidates.size, state.valueSize, state.alignment);
+            size_t firstPage = static_cast<size_t>((chunk.start - candidates.start) / pageSize);
+            size_t lastPage = static_cast<size_t>((chunk.start + chunk.size - candidates.start + pageSize - 1) / pageSize);
+            std::vector<uint8_t> tail;
+            
+            // After a cancel the chunks not compared yet carry their pages over as they are
+            if (scanJob.cancelled()) {
+                for (size_t pageIndex = firstPage; pageIndex < lastPage; pageIndex++) {
+                    uint32_t previousId = candidates.pages[pageIndex];
+                    if (previousId == PageStore::NO_PAGE || previousId == PageStore::ZERO_PAGE) {
+                        pages[pageIndex] = previousId;
+                    } else {
+                        pages[pageIndex] = snapshot->addHashed(state.snapshot->page(previousId), state.snapshot->pageHash(previousId));
+                    }
+                }
+                return;
+            }
+            
+            // Filter the candidates of one page given its current and previous contents
+            auto filterPage = [&](size_t pageIndex, const uint8_t* page, const uint8_t* previous) {
+                size_t firstSlot = std::min(slots, pageIndex * slotsPerPage);
+                size_t lastSlot = std::min(slots, (pageIndex + 1) * slotsPerPage);
+                return filterBits(candidates.bits, firstSlot, lastSlot, [&](size_t slot) {
+                    size_t position = (slot - pageIndex * slotsPerPage) * state.alignment;
+                    return kernel.match(kernel, page + position, previous + position);
+                });
+            };
+            
+            // A page whose contents are the same as in the snapshot: comparisons
+            // against the previous value are decided without looking at the slots
+            auto settleUnchanged = [&](size_t pageIndex, uint32_t previousId, const uint8_t* previous) {
+                size_t kept = 0;
+                switch (kernel.comparison) {
+                    case COMPARE_UNCHANGED:
+                        kept = 1;
+                        break;
+                    case COMPARE_CHANGED:
+                    case COMPARE_INCREASED:
+                    case COMPARE_DECREASED:
+                        kept = 0;
+                        break;
+                    default:
+                        kept = filterPage(pageIndex, previous, previous);
+                        break;
+                }
+                if (kept > 0) {
+                    pages[pageIndex] = previousId == PageStore::ZERO_PAGE ? PageStore::ZERO_PAGE :
+                        snapshot->addHashed(previous, state.snapshot->pageHash(previousId));
+                }
+                pagesUnchanged.fetch_add(1, std::memory_order_relaxed);
+            };
+            
+            StatTimer timer(STAT_COUNT, "rescan", chunk.start, chunk.size);
+            
+            // Decide which pages need reading. Pages without candidates never do; in
+            // dirty mode neither do zero pages the target hasn't touched since.
+            std::vector<uint8_t> needsRead(lastPage - firstPage, 0);
+            for (size_t pageIndex = firstPage; pageIndex < lastPage; pageIndex++) {
+                needsRead[pageIndex - firstPage] = candidates.pages[pageIndex] != PageStore::NO_PAGE;
+            }
+            if (dirtyOnly) {
+                std::vector<int> dispositions(lastPage - firstPage, 0);
+                mach_vm_size_t dispositionCount = dispositions.size();
+                kern_return_t kr = mach_vm_page_range_query(targetTask, chunk.start, chunk.size,
+                                                            (mach_vm_address_t)dispositions.data(), &dispositionCount);
+                if (kr == KERN_SUCCESS) {
+                    for (size_t i = 0; i < dispositionCount && i < dispositions.size(); i++) {
+                        size_t pageIndex = firstPage + i;
+                        bool untouched = (dispositions[i] & (VM_PAGE_QUERY_PAGE_PRESENT | VM_PAGE_QUERY_PAGE_PAGED_OUT)) == 0;
+                        if (needsRead[i] && untouched && candidates.pages[pageIndex] == PageStore::ZERO_PAGE) {
+                            needsRead[i] = 0;
+                            settleUnchanged(pageIndex, PageStore::ZERO_PAGE, zeroPage.data());
+                        }
+                    }
+                }
+            }
+            
+            // Read runs of pages that need it, bridging short gaps
+            for (size_t run = 0; run < needsRead.size(); ) {
+                if (!needsRead[run]) {
+                    run++;
+                    continue;
+                }
+                size_t runEnd = run + 1;
+                for (size_t next = runEnd; next < needsRead.size() && next - runEnd <= RESCAN_MERGE_PAGES; next++) {
+                    if (needsRead[next]) {
+                        runEnd = next + 1;
+                    }
+                }
+                
+                mach_vm_address_t runStart = candidates.start + (firstPage + run) * pageSize;
+                mach_vm_address_t runLimit = std::min<mach_vm_address_t>(candidates.start + (firstPage + runEnd) * pageSize,
+                                                                         chunk.start + chunk.size);
+                readers[worker]->stream(runStart, runLimit - runStart, runLimit, 0,
+                    [&](const uint8_t* data, size_t length, size_t, mach_vm_address_t address) {
+                        StatTimer compareTimer(STAT_COMPARE_NANOS);
+                        threadStats().add(STAT_COMPARE_BYTES, length);
+                        for (size_t offset = 0; offset < length; offset += pageSize) {
+                            size_t pageIndex = static_cast<size_t>((address + offset - candidates.start) / pageSize);
+                            if (!needsRead[pageIndex - firstPage]) {
+                                continue;
+                            }
+                            uint32_t previousId = candidates.pages[pageIndex];
+                            const uint8_t* page = pagePointer(data + offset, length - offset, tail);
+                            const uint8_t* previous = previousId == PageStore::ZERO_PAGE ? zeroPage.data() : state.snapshot->page(previousId);
+                            pagesRead.fetch_add(1, std::memory_order_relaxed);
+                            
+                            if (dirtyOnly && memcmp(page, previous, pageSize) == 0) {
+                                settleUnchanged(pageIndex, previousId, previous);
+                            } else if (filterPage(pageIndex, page, previous) > 0) {
+                                pages[pageIndex] = snapshot->add(page);
+                            }
+                        }
+                    });
+                run = runEnd;
+            }
+            
+            // Pages that failed to read or lost every candidate drop out
+            for (size_t pageIndex = firstPage; pageIndex < lastPage; pageIndex++) {
+                if (pages[pageIndex] == PageStore::NO_PAGE) {
+                    fillBits(candidates.bits, std::min(slots, pageIndex * slotsPerPage),
+                             std::min(slots, (pageIndex + 1) * slotsPerPage), false);
+                }
+            }
+            scanJob.advance(chunk.size);
+        }, [&]() {
+            printProgress("Filtering");
+        });
+        
+        state.candidates = 0;
+        for (size_t i = 0; i < state.regions.size(); i++) {
+            CandidateRegion& candidates = state.regions[i];
+            candidates.pages.swap(newPages[i]);
+            candidates.candidates = candidates.candidates > 0 ? countBits(candidates.bits) : 0;
+            state.candidates += candidates.candidates;
+        }
+        state.snapshot = std::move(snapshot);
+        
+        scanJob.console() << "\r" << Color::CLEAR_LINE << (scanJob.cancelled() ? "Filtering cancelled" : "Filtering complete")
+                          << ". Tracking " << state.candidates << " candidates"
+                          << (scanJob.cancelled() ? " (the ones not compared yet are unchanged)." : ".") << std::endl;
+        if (dirtyOnly) {
+            scanJob.console() << "Read " << pagesRead.load() << " pages, " << pagesUnchanged.load() << " unchanged since the last pass" << std::endl;
+        }
+        if (state.candidates <= BITMAP_LIST_THRESHOLD) {
+            materializeBitmap();
+        }
+    }
+    
+    // Visit bitmap candidates in address order with their snapshot values
+    template<typename Fn>
+    void forEachCandidate(Fn fn) const {
+        const BitmapScan& state = *bitmapScan;
+        size_t pageSize = vm_page_size;
+        std::vector<uint8_t> zeroPage(pageSize, 0);
+        for (const CandidateRegion& candidates : state.regions) {
+            for (size_t word = 0; word < candidates.bits.size(); word++) {
+                uint64_t pending = candidates.bits[word];
+                while (pending) {
+                    size_t slot = word * 64 + __builtin_ctzll(pending);
+                    pending &= pending - 1;
+                    size_t position = slot * state.alignment;
+                    uint32_t id = candidates.pages[position / pageSize];
+                    const uint8_t* page = id == PageStore::ZERO_PAGE ? zeroPage.data() : state.snapshot->page(id);
+                    if (!fn(candidates.start + position, page + position % pageSize)) {
+                        return;
+                    }
+                }
+            }
+        }
+    }
+    
+    // Turn a small enough bitmap candidate set into a regular result list
+    void materializeBitmap() {
+        scanResults.reset(bitmapScan->type, bitmapScan->valueSize);
+        scanResults.addresses.reserve(bitmapScan->candidates);
+        scanResults.values.reserve(bitmapScan->candidates * bitmapScan->valueSize);
+        forEachCandidate([&](mach_vm_address_t address, const uint8_t* value) {
+            scanResults.append(address, value);
+            return true;
+        });
+        bitmapScan.reset();
+    }
+    
+    // Display scan results
+    void displayResults(size_t limit = 20) {
+        if (scanJob.running()) {
+            displayJobPreview(limit);
+            return;
+        }
+        StatTimer timer(STAT_FORMAT_NANOS);
+        if (bitmapScan) {
+            displayCandidates(limit);
+            return;
+        }
+        if (scanResults.empty()) {
+            out() << "No scan results to display" << std::endl;
+            return;
+        }
+        
+        out() << Color::BOLD << "Scan Results (" << scanResults.size() << " total):" << Color::RESET << std::endl;
+        out() << "───────────────────────────────────────────────────────────────" << std::endl;
+        out() << Color::BOLD << std::left << std::setw(5) << "ID" 
+                  << std::setw(18) << "Address" 
+                  << std::setw(18) << "Type" 
+                  << "Value" << Color::RESET << std::endl;
+        out() << "───────────────────────────────────────────────────────────────" << std::endl;
+        
+        size_t count = 0;
+        for (size_t i = 0; i < scanResults.size() && count < limit; i++) {
+            std::stringstream addr;
+            addr << "0x" << std::hex << std::setw(16) << std::setfill('0') << scanResults.addresses[i];
+            
+            ValueType rowType = scanResults.rowType(i);
+            out() << std::left << std::setw(5) << i 
+                      << std::setw(18) << addr.str() 
+                      << std::setw(18) << valueTypeNames[rowType] 
+                      << formatValue(scanResults.value(i), resultDisplaySize(i), rowType) << std::endl;
+            count++;
+        }
+        
+        if (scanResults.size() > limit) {
+            out() << "... and " << (scanResults.size() - limit) << " more results" << std::endl;
+        }
+        
+        out() << "───────────────────────────────────────────────────────────────" << std::endl;
+    }
+    
+    // The first rows of the results tagged with the PID, for the results of a
+    // process set; returns how many were shown
+    size_t displayTaggedResults(size_t limit) {
+        if (bitmapScan) {
+            out() << std::left << std::setw(8) << targetPid << getResultCount() << " candidates of an unknown scan (narrow them with multi next)" << std::endl;
+            return 0;
+        }
+        
+        size_t count = std::min(limit, scanResults.size());
+        for (size_t i = 0; i < count; i++) {
+            std::stringstream addr;
+            addr << "0x" << std::hex << std::setw(16) << std::setfill('0') << scanResults.addresses[i];
+            
+            ValueType rowType = scanResults.rowType(i);
+            out() << std::left << std::setw(8) << targetPid
+                      << std::setw(18) << addr.str()
+                      << std::setw(18) << valueTypeNames[rowType]
+                      << formatValue(scanResults.value(i), resultDisplaySize(i), rowType) << std::endl;
+        }
+        return count;
+    }
+    
+    // Display the first candidates of an unknown-value scan with their snapshot values
+    void displayCandidates(size_t limit) {
+        const BitmapScan& state = *bitmapScan;
+        out() << Color::BOLD << "Scan Candidates (" << state.candidates << " total):" << Color::RESET << std::endl;
+        out() << "───────────────────────────────────────────────────────────────" << std::endl;
+        out() << Color::BOLD << std::left << std::setw(5) << "ID" 
+                  << std::setw(18) << "Address" 
+                  << std::setw(18) << "Type" 
+                  << "Value" << Color::RESET << std::endl;
+        out() << "───────────────────────────────────────────────────────────────" << std::endl;
+        
+        size_t count = 0;
+        forEachCandidate([&](mach_vm_address_t address, const uint8_t* value) {
+            if (count >= limit) {
+                return false;
+            }
+            std::stringstream addr;
+            addr << "0x" << std::hex << std::setw(16) << std::setfill('0') << address;
+            
+            out() << std::left << std::setw(5) << count 
+                      << std::setw(18) << addr.str() 
+                      << std::setw(18) << valueTypeNames[state.type] 
+                      << formatValue(value, state.valueSize, state.type) << std::endl;
+            count++;
+            return true;
+        });
+        
+        if (state.candidates > limit) {
+            out() << "... and " << (state.candidates - limit) << " more candidates" << std::endl;
+        }
+        
+        out() << "───────────────────────────────────────────────────────────────" << std::endl;
+    }
+    
+    // Modify a value at a specific address
+    template <typename T>
+    bool modifyValue(mach_vm_address_t address, T value) {
+        return writeMemory(address, value);
+    }
+    
+    // Start watching an address on the background watch engine. Returns the watch id, or 0.
+    uint32_t addWatch(mach_vm_address_t address, ValueType type, double intervalMs = 1000) {
+        if (!isAttached) {
+            err() << "Not attached to any process" << std::endl;
+            return 0;
+        }
+        
+        // Strings are watched over a fixed window
+        size_t valueSize = isStringType(type) ? WATCH_VALUE_MAX : valueTypeSize(type);
+        if (valueSize == 0) {
+            err() << "A watch needs a single value type" << std::endl;
+            return 0;
+        }
+        
+        uint8_t value[WATCH_VALUE_MAX];
+        if (!memoryRegions.contains(address, valueSize, VM_PROT_READ) || !readMemoryBlock(address, value, valueSize)) {
+            err() << "Failed to read initial value at address 0x" 
+                      << std::hex << address << std::dec << std::endl;
+            return 0;
+        }
+        
+        uint32_t id = watchEngine.add(targetTask, address, type, valueSize, value, intervalMs);
+        out() << "Watch #" << id << " on 0x" << std::hex << address << std::dec 
+                  << " (Type: " << valueTypeNames[type] << ", every " << intervalMs << " ms)" << std::endl;
+        out() << "Initial value: " << formatWatchValue(value, valueSize, type) << std::endl;
+        return id;
+    }
+    
+    bool removeWatch(uint32_t id) {
+        return watchEngine.remove(id);
+    }
+    
+    size_t removeAllWatches() {
+        return watchEngine.removeAll();
+    }
+    
+    // List active watches with their latest values
+    void listWatches() {
+        std::vector<WatchInfo> watches = watchEngine.list();
+        if (watches.empty()) {
+            out() << "No active watches" << std::endl;
+            return;
+        }
+        
+        out() << Color::BOLD << "Watches (" << watches.size() << " active):" << Color::RESET << std::endl;
+        out() << "───────────────────────────────────────────────────────────────" << std::endl;
+        out() << Color::BOLD << std::left << std::setw(5) << "ID" 
+                  << std::setw(20) << "Address" 
+                  << std::setw(16) << "Type" 
+                  << std::setw(12) << "Interval" 
+                  << std::setw(9) << "Changes" 
+                  << "Value" << Color::RESET << std::endl;
+        out() << "───────────────────────────────────────────────────────────────" << std::endl;
+        
+        for (const WatchInfo& watch : watches) {
+            std::stringstream addr;
+            addr << "0x" << std::hex << std::setw(16) << std::setfill('0') << watch.address;
+            std::stringstream interval;
+            interval << watch.intervalMs << " ms";
+            
+            out() << std::left << std::setw(5) << watch.id 
+                      << std::setw(20) << addr.str() 
+                      << std::setw(16) << valueTypeNames[watch.type] 
+                      << std::setw(12) << interval.str() 
+                      << std::setw(9) << watch.changes 
+                      << (watch.readable ? formatWatchValue(watch.value, watch.size, watch.type) : "<unreadable>") << std::endl;
+        }
+        
+        out() << "───────────────────────────────────────────────────────────────" << std::endl;
+    }
+    
+    // Show the value at an address (strings: up to their terminator)
+    void readValue(mach_vm_address_t address, ValueType type) {
+        if (!isAttached) {
+            err() << "Not attached to any process" << std::endl;
+            return;
+        }
+        
+        size_t size = isStringType(type) ? WATCH_VALUE_MAX : valueTypeSize(type);
+        if (size == 0) {
+            err() << "Reading needs a single value type" << std::endl;
+            return;
+        }
+        
+        uint8_t value[WATCH_VALUE_MAX];
+        if (!readMemoryBlock(address, value, size)) {
+            err() << "Failed to read memory at address 0x" << std::hex << address << std::dec << std::endl;
+            return;
+        }
+        out() << "0x" << std::hex << address << std::dec << " (" << valueTypeNames[type] << "): "
+                  << formatWatchValue(value, size, type) << std::endl;
+    }
+    
+    bool writeValue(mach_vm_address_t address, ValueType type, const std::string& value) {
+        if (!isAttached) {
+            err() << "Not attached to any process" << std::endl;
+            return false;
+        }
+        
+        std::vector<uint8_t> encoded;
+        if (type == ValueType::ANY || !parseValue(type, value, encoded)) {
+            err() << "Invalid value for " << valueTypeNames[type] << std::endl;
+            return false;
+        }
+        if (!writeMemoryBlock(address, encoded.data(), encoded.size())) {
+            err() << "Failed to write memory at address 0x" << std::hex << address << std::dec << std::endl;
+            return false;
+        }
+        out() << "Wrote " << value << " to 0x" << std::hex << address << std::dec << std::endl;
+        return true;
+    }
+    
+    // Gather the current results, in address order, as writes of value (or of their
+    // own last values if value is empty) and the type of each. Rows of an any scan
+    // are written as their own type; encoded holds the encodings the writes point into.
+    bool resultWrites(const std::string& value, std::vector<std::vector<uint8_t>>& encoded,
+                      std::vector<ValueWrite>& writes, std::vector<ValueType>& types) {
+        if (!isAttached) {
+            err() << "Not attached to any process" << std::endl;
+            return false;
+        }
+        if (bitmapScan) {
+            err() << "Narrow the unknown scan down with next first (" << bitmapScan->candidates << " candidates)" << std::endl;
+            return false;
+        }
+        if (scanResults.empty()) {
+            err() << "No scan results" << std::endl;
+            return false;
+        }
+        
+        // Loaded sessions may not be in address order
+        std::vector<size_t> order(scanResults.size());
+        for (size_t i = 0; i < order.size(); i++) {
+            order[i] = i;
+        }
+        if (!std::is_sorted(scanResults.addresses.data(), scanResults.addresses.data() + scanResults.size())) {
+            std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) { return scanResults.addresses[a] < scanResults.addresses[b]; });
+        }
+        
+        encoded.assign(ValueType::UNKNOWN, std::vector<uint8_t>());
+        writes.clear();
+        writes.reserve(order.size());
+        types.clear();
+        types.reserve(order.size());
+        for (size_t i : order) {
+            ValueType type = scanResults.rowType(i);
+            if (value.empty()) {
+                writes.push_back({ scanResults.addresses[i], scanResults.value(i), resultDisplaySize(i) });
+            } else {
+                if (encoded[type].empty() && !parseValue(type, value, encoded[type])) {
+                    err() << "Invalid value for " << valueTypeNames[type] << std::endl;
+                    return false;
+                }
+                writes.push_back({ scanResults.addresses[i], encoded[type].data(), encoded[type].size() });
+            }
+            types.push_back(type);
+        }
+        return true;
+    }
+    
+    // Write value to every result, with one mach_vm_write per page of results
+    void writeAll(const std::string& value) {
+        std::vector<std::vector<uint8_t>> encoded;
+        std::vector<ValueWrite> writes;
+        std::vector<ValueType> types;
+        if (!resultWrites(value, encoded, writes, types)) {
+            return;
+        }
+        
+        std::vector<uint8_t> scratch;
+        size_t calls = 0;
+        size_t written = writeTargetValues(targetTask, writes, scratch, calls);
+        out() << "Wrote " << value << " to " << written << " of " << writes.size() << " results ("
+                  << calls << " writes)" << std::endl;
+        if (written < writes.size()) {
+            out() << Color::YELLOW << (writes.size() - written) << " results could not be written (read-only or unmapped)" << Color::RESET << std::endl;
+        }
+    }
+    
+    // Hold the value at address, at value or (if value is empty) at what it is now
+    uint32_t freezeValue(mach_vm_address_t address, ValueType type, const std::string& value) {
+        if (!isAttached) {
+            err() << "Not attached to any process" << std::endl;
+            return 0;
+        }
+        
+        std::vector<uint8_t> encoded;
+        if (value.empty()) {
+            encoded.resize(valueTypeSize(type));
+            if (encoded.empty()) {
+                err() << "Freezing a string needs its value" << std::endl;
+                return 0;
+            }
+            if (!readMemoryBlock(address, encoded.data(), encoded.size())) {
+                err() << "Failed to read memory at address 0x" << std::hex << address << std::dec << std::endl;
+                return 0;
+            }
+        } else if (type == ValueType::ANY || !parseValue(type, value, encoded)) {
+            err() << "Invalid value for " << valueTypeNames[type] << std::endl;
+            return 0;
+        }
+        if (encoded.size() > WATCH_VALUE_MAX) {
+            err() << "Frozen values are at most " << WATCH_VALUE_MAX << " bytes" << std::endl;
+            return 0;
+        }
+        
+        uint32_t id = watchEngine.freeze(targetTask, address, type, encoded.size(), encoded.data());
+        out() << "Freeze #" << id << " on 0x" << std::hex << address << std::dec
+                  << " (Type: " << valueTypeNames[type] << "): " << formatWatchValue(encoded.data(), encoded.size(), type) << std::endl;
+        return id;
+    }
+    
+    // Freeze every result, at value or at its value from the last scan
+    void freezeResults(const std::string& value) {
+        std::vector<std::vector<uint8_t>> encoded;
+        std::vector<ValueWrite> writes;
+        std::vector<ValueType> types;
+        if (!resultWrites(value, encoded, writes, types)) {
+            return;
+        }
+        if (writes.size() > FREEZE_RESULTS_MAX) {
+            err() << "Too many results to freeze (" << writes.size() << "); narrow them down to "
+                      << FREEZE_RESULTS_MAX << " or fewer first" << std::endl;
+            return;
+        }
+        
+        for (size_t i = 0; i < writes.size(); i++) {
+            watchEngine.freeze(targetTask, writes[i].address, types[i], std::min(writes[i].size, WATCH_VALUE_MAX), writes[i].data);
+        }
+        out() << "Froze " << writes.size() << " results, checked every " << watchEngine.getFreezeInterval() << " ms" << std::endl;
+    }
+    
+    bool removeFreeze(uint32_t id) {
+        return watchEngine.unfreeze(id);
+    }
+    
+    size_t removeAllFreezes() {
+        return watchEngine.unfreezeAll();
+    }
+    
+    void setFreezeInterval(double intervalMs) { watchEngine.setFreezeInterval(intervalMs); }
+    double getFreezeInterval() { return watchEngine.getFreezeInterval(); }
+    
+    // List frozen values with how often each had to be written back
+    void listFreezes() {
+        std::vector<FreezeInfo> freezes = watchEngine.listFreezes();
+        if (freezes.empty()) {
+            out() << "No frozen values" << std::endl;
+            return;
+        }
+        
+        out() << Color::BOLD << "Frozen values (" << freezes.size() << ", checked every " << watchEngine.getFreezeInterval()
+                  << " ms, " << watchEngine.freezeWriteCalls() << " writes so far):" << Color::RESET << std::endl;
+        out() << "───────────────────────────────────────────────────────────────" << std::endl;
+        out() << Color::BOLD << std::left << std::setw(5) << "ID" 
+                  << std::setw(20) << "Address" 
+                  << std::setw(16) << "Type" 
+                  << std::setw(10) << "Rewrites" 
+                  << "Value" << Color::RESET << std::endl;
+        out() << "───────────────────────────────────────────────────────────────" << std::endl;
+        
+        for (const FreezeInfo& freeze : freezes) {
+            std::stringstream addr;
+            addr << "0x" << std::hex << std::setw(16) << std::setfill('0') << freeze.address;
+            
+            out() << std::left << std::setw(5) << freeze.id 
+                      << std::setw(20) << addr.str() 
+                      << std::setw(16) << valueTypeNames[freeze.type] 
+                      << std::setw(10) << freeze.rewrites 
+                      << formatWatchValue(freeze.value, freeze.size, freeze.type) << std::endl;
+        }
+        
+        out() << "───────────────────────────────────────────────────────────────" << std::endl;
+    }
+    
+    // Copy the selected readable regions into the snapshot store. Pages are
+    // deduplicated against every snapshot taken before, so a snapshot of memory
+    // that barely changed costs little more than its page table.
+    void takeSnapshot(const std::string& name, const RegionFilter& filter = RegionFilter()) {
+        if (!isAttached) {
+            scanJob.errorConsole() << "Not attached to any process" << std::endl;
+            return;
+        }
+        
+        size_t pageSize = vm_page_size;
+        if (!snapshotStore) {
+            snapshotStore.reset(new PageStore(pageSize));
+            if (!snapshotDirectory.empty() && !snapshotStore->backWithFile(snapshotDirectory)) {
+                scanJob.console() << Color::YELLOW << "Can't create a snapshot file in " << snapshotDirectory
+                                  << "; keeping snapshots in memory" << Color::RESET << std::endl;
+            }
+        }
+        
+        scanJob.console() << "Taking snapshot, please wait..." << std::endl;
+        prepareMemoryRegions();
+        
+        MemorySnapshot snapshot;
+        snapshot.id = nextSnapshotId;
+        snapshot.name = name;
+        snapshot.bytes = 0;
+        std::vector<ScanChunk> chunks;
+        for (const MemoryRegion& region : memoryRegions) {
+            if (!region.readable || !filter.matches(region)) {
+                continue;
+            }
+            SnapshotRegion pages;
+            pages.start = region.start;
+            pages.size = region.size;
+            pages.tags = region.tags;
+            pages.pages.assign(static_cast<size_t>((region.size + pageSize - 1) / pageSize), PageStore::NO_PAGE);
+            for (mach_vm_size_t offset = 0; offset < region.size; offset += SCAN_CHUNK_SIZE) {
+                ScanChunk chunk;
+                chunk.region = snapshot.regions.size();
+                chunk.start = region.start + offset;
+                chunk.size = std::min<mach_vm_size_t>(SCAN_CHUNK_SIZE, region.size - offset);
+                chunks.push_back(chunk);
+            }
+            snapshot.regions.push_back(std::move(pages));
+            snapshot.bytes += region.size;
+        }
+        
+        scanJob.setTotal(snapshot.bytes);
+        size_t storedBefore = snapshotStore->storedBytes();
+        std::vector<std::unique_ptr<RegionReader>> readers(workerPool->size());
+        PageStore& store = *snapshotStore;
+        
+        // Pages that can't be read stay NO_PAGE
+        workerPool->run(chunks.size(), [&](size_t worker, size_t task) {
+            if (scanJob.cancelled()) {
+                return;
+            }
+            const ScanChunk& chunk = chunks[task];
+            SnapshotRegion& region = snapshot.regions[chunk.region];
+            if (!readers[worker]) {
+                readers[worker].reset(new RegionReader(targetTask, zeroCopy));
+            }
+            std::vector<uint8_t> tail;
+            
+            StatTimer timer(STAT_COUNT, "snapshot", chunk.start, chunk.size);
+            readers[worker]->stream(chunk.start, chunk.size, chunk.start + chunk.size, 0,
+                [&](const uint8_t* data, size_t length, size_t, mach_vm_address_t address) {
+                    for (size_t offset = 0; offset < length; offset += pageSize) {
+                        size_t pageIndex = static_cast<size_t>((address + offset - region.start) / pageSize);
+                        region.pages[pageIndex] = store.add(pagePointer(data + offset, length - offset, tail));
+                    }
+                });
+            scanJob.advance(chunk.size);
+        }, [&]() {
+            printProgress("Snapshotting");
+        });
+        
+        if (scanJob.cancelled()) {
+            scanJob.console() << "\r" << Color::CLEAR_LINE << "Snapshot cancelled." << std::endl;
+            return;
+        }
+        
+        nextSnapshotId++;
+        snapshot.taken = std::chrono::steady_clock::now();
+        scanJob.console() << "\r" << Color::CLEAR_LINE << "Snapshot #" << snapshot.id
+                          << (snapshot.name.empty() ? "" : " (" + snapshot.name + ")") << ": "
+                          << snapshot.bytes / (1024 * 1024) << " MB in " << snapshot.regions.size() << " regions, "
+                          << (store.storedBytes() - storedBefore) / (1024 * 1024) << " MB of new pages ("
+                          << store.storedBytes() / (1024 * 1024) << " MB stored in all)." << std::endl;
+        snapshots.push_back(std::move(snapshot));
+    }
+    
+    const MemorySnapshot* findSnapshot(uint32_t id) const {
+        for (const MemorySnapshot& snapshot : snapshots) {
+            if (snapshot.id == id) {
+                return &snapshot;
+            }
+        }
+        return nullptr;
+    }
+    
+    // Page of a snapshot holding address: its contents, or nullptr if it wasn't read
+    const uint8_t* snapshotPage(const MemorySnapshot& snapshot, mach_vm_address_t address, const std::vector<uint8_t>& zeroPage) const {
+        size_t pageSize = vm_page_size;
+        for (const SnapshotRegion& region : snapshot.regions) {
+            if (address >= region.start && address < region.start + region.size) {
+                uint32_t id = region.pages[static_cast<size_t>((address - region.start) / pageSize)];
+                return id == PageStore::ZERO_PAGE ? zeroPage.data() : snapshotStore->page(id);
+            }
+        }
+        return nullptr;
+    }
+    
+    // Compare two snapshots and report the ranges that changed, widened to whole
+    // aligned values of type. Pages with the same id are equal without looking at
+    // them; the rest go through the vector diff kernel.
+    void diffSnapshots(uint32_t firstId, uint32_t secondId, ValueType type, size_t limit) {
+        const MemorySnapshot* first = findSnapshot(firstId);
+        const MemorySnapshot* second = findSnapshot(secondId);
+        if (!first || !second) {
+            scanJob.errorConsole() << "No snapshot #" << (first ? secondId : firstId) << " (see snapshots)" << std::endl;
+            return;
+        }
+        size_t width = valueTypeSize(type);
+        if (width == 0) {
+            scanJob.errorConsole() << "Diffs compare byte, short, int, long, float or double values" << std::endl;
+            return;
+        }
+        
+        // The two region lists are sorted by address; compare where they overlap
+        struct DiffTask {
+            const SnapshotRegion* left;
+            const SnapshotRegion* right;
+            mach_vm_address_t start;
+            mach_vm_address_t end;
+        };
+        struct DiffResult {
+            std::vector<DiffRange> ranges;
+            DiffRange firstRange;
+            DiffRange lastRange;
+            uint64_t rangeCount;
+            uint64_t changedBytes;
+            uint64_t changedPages;
+            uint64_t samePages;
+            uint64_t unreadablePages;
+        };
+        std::vector<DiffTask> tasks;
+        uint64_t overlapBytes = 0;
+        for (size_t i = 0, j = 0; i < first->regions.size() && j < second->regions.size(); ) {
+            const SnapshotRegion& left = first->regions[i];
+            const SnapshotRegion& right = second->regions[j];
+            mach_vm_address_t start = std::max(left.start, right.start);
+            mach_vm_address_t end = std::min(left.start + left.size, right.start + right.size);
+            for (mach_vm_address_t chunk = start; chunk < end; chunk += SCAN_CHUNK_SIZE) {
+                tasks.push_back({ &left, &right, chunk, std::min<mach_vm_address_t>(end, chunk + SCAN_CHUNK_SIZE) });
+            }
+            overlapBytes += end > start ? end - start : 0;
+            if (left.start + left.size <= right.start + right.size) {
+                i++;
+            } else {
+                j++;
+            }
+        }
+        
+        scanJob.console() << "Comparing snapshot #" << first->id << " with #" << second->id << "..." << std::endl;
+        scanJob.setTotal(overlapBytes);
+        
+        size_t pageSize = vm_page_size;
+        std::vector<uint8_t> zeroPage(pageSize, 0);
+        std::vector<DiffResult> results(tasks.size());
+        workerPool->run(tasks.size(), [&](size_t, size_t index) {
+            const DiffTask& task = tasks[index];
+            DiffResult& result = results[index];
+            result.rangeCount = result.changedBytes = result.changedPages = result.samePages = result.unreadablePages = 0;
+            if (scanJob.cancelled()) {
+                return;
+            }
+            std::vector<uint64_t> masks(pageSize / DIFF_BLOCK);
+            
+            // Runs continue across blocks and pages; only the first limit are kept
+            auto addRun = [&](mach_vm_address_t start, mach_vm_size_t size) {
+                result.changedBytes += size;
+                if (result.rangeCount > 0 && result.lastRange.start + result.lastRange.size == start) {
+                    if (result.ranges.size() == result.rangeCount) {
+                        result.ranges.back().size += size;
+                    }
+                    result.lastRange.size += size;
+                    return;
+                }
+                result.rangeCount++;
+                result.lastRange = { start, size };
+                if (result.rangeCount == 1) {
+                    result.firstRange = result.lastRange;
+                }
+                if (result.ranges.size() + 1 == result.rangeCount && result.ranges.size() < limit) {
+                    result.ranges.push_back(result.lastRange);
+                }
+            };
+            
+            StatTimer timer(STAT_COUNT, "diff", task.start, task.end - task.start);
+            StatTimer compareTimer(STAT_COMPARE_NANOS);
+            for (mach_vm_address_t page = task.start; page < task.end; page += pageSize) {
+                uint32_t leftId = task.left->pages[static_cast<size_t>((page - task.left->start) / pageSize)];
+                uint32_t rightId = task.right->pages[static_cast<size_t>((page - task.right->start) / pageSize)];
+                if (leftId == PageStore::NO_PAGE || rightId == PageStore::NO_PAGE) {
+                    result.unreadablePages++;
+                    continue;
+                }
+                if (leftId == rightId) {
+                    result.samePages++;
+                    continue;
+                }
+                
+                const uint8_t* left = leftId == PageStore::ZERO_PAGE ? zeroPage.data() : snapshotStore->page(leftId);
+                const uint8_t* right = rightId == PageStore::ZERO_PAGE ? zeroPage.data() : snapshotStore->page(rightId);
+                diffMasks(left, right, pageSize, masks.data(), useSimd);
+                threadStats().add(STAT_COMPARE_BYTES, pageSize);
+                result.changedPages++;
+                
+                for (size_t block = 0; block < masks.size(); block++) {
+                    uint64_t mask = widenDiffMask(masks[block], width);
+                    while (mask != 0) {
+                        size_t bit = __builtin_ctzll(mask);
+                        uint64_t rest = ~(mask >> bit);
+                        size_t run = rest == 0 ? 64 - bit : std::min<size_t>(64 - bit, __builtin_ctzll(rest));
+                        addRun(page + block * DIFF_BLOCK + bit, run);
+                        mask = run + bit >= 64 ? 0 : mask & ~(((1ull << run) - 1) << bit);
+                    }
+                }
+            }
+            scanJob.advance(task.end - task.start);
+        }, [&]() {
+            printProgress("Comparing");
+        });
+        
+        // Join the tasks, merging runs that cross from one into the next
+        std::vector<DiffRange> ranges;
+        uint64_t rangeCount = 0;
+        uint64_t changedBytes = 0;
+        uint64_t changedPages = 0;
+        uint64_t samePages = 0;
+        uint64_t unreadablePages = 0;
+        bool haveLast = false;
+        bool lastKept = true;
+        DiffRange last = { 0, 0 };
+        for (const DiffResult& result : results) {
+            changedBytes += result.changedBytes;
+            changedPages += result.changedPages;
+            samePages += result.samePages;
+            unreadablePages += result.unreadablePages;
+            if (result.rangeCount == 0) {
+                continue;
+            }
+            size_t skip = 0;
+            rangeCount += result.rangeCount;
+            if (haveLast && last.start + last.size == result.firstRange.start) {
+                rangeCount--;
+                skip = 1;
+                if (lastKept && !ranges.empty() && !result.ranges.empty()) {
+                    ranges.back().size += result.ranges[0].size;
+                }
+            }
+            lastKept = result.ranges.size() == result.rangeCount && (ranges.size() + result.ranges.size() - skip) <= limit;
+            for (size_t i = skip; i < result.ranges.size() && ranges.size() < limit; i++) {
+                ranges.push_back(result.ranges[i]);
+            }
+            last = result.lastRange;
+            haveLast = true;
+        }
+        
+        scanJob.console() << "\r" << Color::CLEAR_LINE;
+        if (scanJob.cancelled()) {
+            scanJob.console() << Color::YELLOW << "Diff cancelled; the counts below cover part of the memory" << Color::RESET << std::endl;
+        }
+        scanJob.console() << Color::BOLD << "Snapshot #" << first->id << " → #" << second->id << " ("
+                          << valueTypeNames[type] << " values):" << Color::RESET << std::endl;
+        scanJob.console() << "  " << rangeCount << " changed ranges, " << changedBytes / width << " changed values ("
+                          << changedBytes << " bytes) in " << changedPages << " pages" << std::endl;
+        scanJob.console() << "  " << samePages << " pages identical, " << unreadablePages << " unreadable in either snapshot" << std::endl;
+        scanJob.console() << "  " << (first->bytes - std::min(first->bytes, overlapBytes)) / 1024 << " KB only in #" << first->id << ", "
+                          << (second->bytes - std::min(second->bytes, overlapBytes)) / 1024 << " KB only in #" << second->id << std::endl;
+        if (ranges.empty()) {
+            return;
+        }
+        
+        scanJob.console() << "───────────────────────────────────────────────────────────────" << std::endl;
+        scanJob.console() << Color::BOLD << std::left << std::setw(20) << "Address" 
+                          << std::setw(10) << "Bytes" 
+                          << "First value" << Color::RESET << std::endl;
+        scanJob.console() << "───────────────────────────────────────────────────────────────" << std::endl;
+        for (const DiffRange& range : ranges) {
+            std::stringstream addr;
+            addr << "0x" << std::hex << std::setw(16) << std::setfill('0') << range.start;
+            
+            const uint8_t* before = snapshotPage(*first, range.start, zeroPage);
+            const uint8_t* after = snapshotPage(*second, range.start, zeroPage);
+            size_t offset = static_cast<size_t>(range.start % pageSize);
+            std::string change = before && after ? formatValue(before + offset, width, type) + " → " + formatValue(after + offset, width, type) : "";
+            scanJob.console() << std::left << std::setw(20) << addr.str() 
+                              << std::setw(10) << range.size 
+                              << change << std::endl;
+        }
+        if (rangeCount > ranges.size()) {
+            scanJob.console() << "... and " << (rangeCount - ranges.size()) << " more ranges" << std::endl;
+        }
+        scanJob.console() << "───────────────────────────────────────────────────────────────" << std::endl;
+    }
+    
+    void listSnapshots() {
+        if (snapshots.empty()) {
+            out() << "No snapshots" << std::endl;
+            return;
+        }
+        
+        out() << Color::BOLD << "Snapshots (" << snapshots.size() << ", " << snapshotStore->storedBytes() / (1024 * 1024)
+                  << " MB of pages " << (snapshotStore->fileBacked() ? "in " + snapshotDirectory : "in memory") << "):" << Color::RESET << std::endl;
+        out() << "───────────────────────────────────────────────────────────────" << std::endl;
+        out() << Color::BOLD << std::left << std::setw(5) << "ID" 
+                  << std::setw(18) << "Name" 
+                  << std::setw(12) << "Taken" 
+                  << std::setw(10) << "Regions" 
+                  << "Memory" << Color::RESET << std::endl;
+        out() << "───────────────────────────────────────────────────────────────" << std::endl;
+        
+        auto now = std::chrono::steady_clock::now();
+        for (const MemorySnapshot& snapshot : snapshots) {
+            std::stringstream age;
+            age << std::fixed << std::setprecision(1) << std::chrono::duration<double>(now - snapshot.taken).count() << "s ago";
+            out() << std::left << std::setw(5) << snapshot.id 
+                      << std::setw(18) << snapshot.name 
+                      << std::setw(12) << age.str() 
+                      << std::setw(10) << snapshot.regions.size() 
+                      << snapshot.bytes / (1024 * 1024) << " MB" << std::endl;
+        }
+        
+        out() << "───────────────────────────────────────────────────────────────" << std::endl;
+    }
+    
+    // Pages are shared between snapshots, so the store is only freed with the last one
+    bool deleteSnapshot(uint32_t id) {
+        for (auto it = snapshots.begin(); it != snapshots.end(); ++it) {
+            if (it->id == id) {
+                snapshots.erase(it);
+                if (snapshots.empty()) {
+                    snapshotStore.reset();
+                }
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    size_t deleteAllSnapshots() {
+        size_t count = snapshots.size();
+        snapshots.clear();
+        snapshotStore.reset();
+        return count;
+    }
+    
+    // Where the snapshot store keeps its pages (empty = in memory); used from the next new store
+    void setSnapshotDirectory(const std::string& directory) { snapshotDirectory = directory; }
+    const std::string& getSnapshotDirectory() const { return snapshotDirectory; }
+    
+    // Run a scan as the current job, on the job thread if background is set
+    void startJob(const std::string& description, bool background, const std::function<void()>& fn) {
+        scanJob.start(description, background, [description, fn]() {
+            scanStats.begin(description);
+            fn();
+            scanStats.end();
+        });
+        if (background) {
+            out() << "Running " << description << " in the background (status, results, cancel, wait)" << std::endl;
+        }
+    }
+    
+    bool jobRunning() const { return scanJob.running(); }
+    
+    // Run fn as this scanner's job inside the job of another scanner (a process
+    // set scan); the outer job keeps the stats
+    void runNestedJob(const std::string& description, const std::function<void()>& fn) {
+        scanJob.start(description, false, fn);
+    }
+    
+    // The current job as seen by work that runs on it for other scanners
+    std::ostream& jobConsole() { return scanJob.console(); }
+    std::ostream& jobErrorConsole() { return scanJob.errorConsole(); }
+    bool jobCancelled() const { return scanJob.cancelled(); }
+    bool jobInBackground() const { return scanJob.inBackground(); }
+    void addJobProgress(uint64_t bytes, uint64_t total) {
+        scanJob.advance(bytes);
+        scanJob.setTotal(total);
+    }
+    
+    // Ask the running scan to stop; unlike cancelJob() this prints nothing, so
+    // it can be called from another thread
+    void requestCancel() { scanJob.cancel(); }
+    
+    void cancelJob() {
+        if (!scanJob.running()) {
+            out() << "No scan is running" << std::endl;
+            return;
+        }
+        scanJob.cancel();
+        out() << "Cancelling " << scanJob.description() << "..." << std::endl;
+    }
+    
+    // Block until the background scan is done, showing its progress
+    void waitForJob() {
+        if (!scanJob.running()) {
+            out() << "No scan is running" << std::endl;
+            return;
+        }
+        while (!scanJob.finishedRunning()) {
+            out() << "\r" << scanJob.description() << ": " << scanJob.progressText() << Color::CLEAR_LINE << std::flush;
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+        out() << "\r" << Color::CLEAR_LINE << std::flush;
+        printJobMessages();
+    }
+    
+    // Show what a finished background scan had to say
+    void printJobMessages() {
+        std::string messages;
+        if (scanJob.collect(messages)) {
+            out() << Color::CYAN << "[" << scanJob.description() << " finished]" << Color::RESET << std::endl << messages;
+        }
+    }
+    
+    void displayJobStatus() {
+        if (!scanJob.running()) {
+            out() << "No scan is running" << std::endl;
+            return;
+        }
+        out() << scanJob.description() << (scanJob.cancelled() ? " (cancelling)" : "") << ": "
+                  << scanJob.progressText() << ", " << scanJob.hits() << " hits so far" << std::endl;
+    }
+    
+    // The first hits of the scan in flight, in address order
+    void displayJobPreview(size_t limit) {
+        ResultStore preview = scanJob.previewResults();
+        out() << Color::BOLD << "Partial Results (" << scanJob.hits() << " so far, " << scanJob.progressText() << "):" << Color::RESET << std::endl;
+        out() << "───────────────────────────────────────────────────────────────" << std::endl;
+        out() << Color::BOLD << std::left << std::setw(5) << "ID" 
+                  << std::setw(18) << "Address" 
+                  << std::setw(18) << "Type" 
+                  << "Value" << Color::RESET << std::endl;
+        out() << "───────────────────────────────────────────────────────────────" << std::endl;
+        
+        for (size_t i = 0; i < preview.size() && i < limit; i++) {
+            std::stringstream addr;
+            addr << "0x" << std::hex << std::setw(16) << std::setfill('0') << preview.addresses[i];
+            
+            ValueType rowType = preview.rowType(i);
+            out() << std::left << std::setw(5) << i 
+                      << std::setw(18) << addr.str() 
+                      << std::setw(18) << valueTypeNames[rowType] 
+                      << formatValue(preview.value(i), preview.rowSize(i), rowType) << std::endl;
+        }
+        if (scanJob.hits() > std::min<uint64_t>(limit, preview.size())) {
+            out() << "... the full results are shown once the scan finishes" << std::endl;
+        }
+        out() << "───────────────────────────────────────────────────────────────" << std::endl;
+    }
+    
+    // Breakdown of the last scan: Mach reads, compare time, result buffer
+    // growth and display time, then the regions that took the most thread time
+    void displayStats(size_t regionLimit = 10) {
+        uint64_t elapsed = scanStats.elapsed();
+        if (elapsed == 0) {
+            out() << "No scan has run yet" << std::endl;
+            return;
+        }
+        
+        auto seconds = [](uint64_t nanos) { return static_cast<double>(nanos) / 1e9; };
+        auto sizeText = [](uint64_t bytes) {
+            std::stringstream text;
+            text << std::fixed << std::setprecision(1);
+            if (bytes >= 1024ull * 1024 * 1024) {
+                text << static_cast<double>(bytes) / (1024.0 * 1024 * 1024) << " GB";
+            } else {
+                text << static_cast<double>(bytes) / (1024.0 * 1024) << " MB";
+            }
+            return text.str();
+        };
+        auto rate = [&](uint64_t bytes, uint64_t nanos) {
+            std::stringstream text;
+            text << std::fixed << std::setprecision(2)
+                 << (nanos > 0 ? static_cast<double>(bytes) / (1024.0 * 1024 * 1024) / seconds(nanos) : 0.0) << " GB/s";
+            return text.str();
+        };
+        
+        uint64_t readBytes = scanStats.total(STAT_READ_BYTES);
+        uint64_t readNanos = scanStats.total(STAT_READ_NANOS);
+        uint64_t compareBytes = scanStats.total(STAT_COMPARE_BYTES);
+        uint64_t compareNanos = scanStats.total(STAT_COMPARE_NANOS);
+        
+        out() << std::fixed << std::setprecision(3);
+        out() << Color::BOLD << "Last scan: " << scanStats.description() << " (" << seconds(elapsed) << "s"
+                  << (scanJob.running() ? ", running" : "") << ")" << Color::RESET << std::endl;
+        out() << "  Mach reads:  " << scanStats.total(STAT_READ_CALLS) << " calls, " << sizeText(readBytes) << ", "
+                  << scanStats.total(STAT_READ_FAILURES) << " failed, " << seconds(readNanos) << "s ("
+                  << rate(readBytes, readNanos) << ")" << std::endl;
+        out() << "  Remaps:      " << scanStats.total(STAT_REMAP_CALLS) << std::endl;
+        out() << "  Compare:     " << sizeText(compareBytes) << " in " << seconds(compareNanos) << "s ("
+                  << rate(compareBytes, compareNanos) << ")" << std::endl;
+        out() << "  Allocations: " << scanStats.total(STAT_BUFFER_ALLOCATIONS) << " buffer growths, "
+                  << sizeText(scanStats.total(STAT_BUFFER_BYTES)) << std::endl;
+        out() << "  Formatting:  " << seconds(scanStats.total(STAT_FORMAT_NANOS)) << "s" << std::endl;
+        
+        // Thread time per region, summed over the spans that fall in it
+        struct RegionTime {
+            const MemoryRegion* region;
+            uint64_t nanos;
+        };
+        std::unordered_map<mach_vm_address_t, RegionTime> regionTimes;
+        for (const TraceSpan& span : scanStats.spans()) {
+            const MemoryRegion* region = memoryRegions.find(span.address);
+            if (region) {
+                RegionTime& time = regionTimes.emplace(region->start, RegionTime{ region, 0 }).first->second;
+                time.nanos += span.duration;
+            }
+        }
+        std::vector<RegionTime> slowest;
+        for (const auto& entry : regionTimes) {
+            slowest.push_back(entry.second);
+        }
+        std::sort(slowest.begin(), slowest.end(), [](const RegionTime& a, const RegionTime& b) { return a.nanos > b.nanos; });
+        if (slowest.size() > regionLimit) {
+            slowest.resize(regionLimit);
+        }
+        
+        if (!slowest.empty()) {
+            out() << Color::BOLD << "  Slowest regions (thread time):" << Color::RESET << std::endl;
+            for (const RegionTime& time : slowest) {
+                std::stringstream addr;
+                addr << "0x" << std::hex << std::setw(16) << std::setfill('0') << time.region->start;
+                out() << "    " << std::left << std::setw(20) << addr.str() << std::right << std::setw(10)
+                          << sizeText(time.region->size) << "  " << std::setw(8) << seconds(time.nanos) << "s  "
+                          << formatRegionTags(time.region->tags) << std::endl;
+            }
+            out() << std::left;
+        }
+        out().unsetf(std::ios::floatfield);
+        out() << std::setprecision(6);
+    }
+    
+    // Write the spans of the last scan in the Chrome trace event format, which
+    // Perfetto (ui.perfetto.dev) and chrome://tracing open
+    bool writeTrace(const std::string& filename) {
+        uint64_t started = scanStats.startTime();
+        if (started == 0) {
+            out() << "No scan has run yet" << std::endl;
+            return false;
+        }
+        
+        std::ofstream file(filename);
+        if (!file) {
+            err() << "Failed to open file: " << filename << std::endl;
+            return false;
+        }
+        
+        std::vector<TraceSpan> spans = scanStats.spans();
+        
+        // The whole scan is its own track above the worker threads
+        const uint32_t scanTrack = 0xFFFF;
+        std::unordered_set<uint32_t> threads;
+        file << std::fixed << std::setprecision(3);
+        file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [" << std::endl;
+        file << "{\"name\": " << jsonQuote(scanStats.description()) << ", \"cat\": \"scan\", \"ph\": \"X\", \"ts\": 0, \"dur\": "
+             << static_cast<double>(scanStats.elapsed()) / 1000.0 << ", \"pid\": " << targetPid << ", \"tid\": " << scanTrack << "}";
+        for (const TraceSpan& span : spans) {
+            threads.insert(span.thread);
+            file << "," << std::endl << "{\"name\": \"" << span.name << "\", \"cat\": \"scan\", \"ph\": \"X\", \"ts\": "
+                 << static_cast<double>(span.start - started) / 1000.0 << ", \"dur\": " << static_cast<double>(span.duration) / 1000.0
+                 << ", \"pid\": " << targetPid << ", \"tid\": " << span.thread << ", \"args\": {\"address\": \"0x"
+                 << std::hex << span.address << std::dec << "\", \"bytes\": " << span.bytes << "}}";
+        }
+        file << "," << std::endl << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": " << targetPid << ", \"tid\": " << scanTrack
+             << ", \"args\": {\"name\": \"scan\"}}";
+        for (uint32_t thread : threads) {
+            file << "," << std::endl << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": " << targetPid << ", \"tid\": " << thread
+                 << ", \"args\": {\"name\": \"thread " << thread << "\"}}";
+        }
+        file << std::endl << "]}" << std::endl;
+        
+        out() << "Wrote " << spans.size() << " spans to " << filename << std::endl;
+        return true;
+    }
+    
+    // The first limit results as a JSON array, for batch output. Candidates of an
+    // unknown value scan have no list yet, so they come out empty.
+    std::string resultsJson(size_t limit) {
+        std::stringstream json;
+        json << "[";
+        for (size_t i = 0; !bitmapScan && i < scanResults.size() && i < limit; i++) {
+            std::stringstream addr;
+            addr << "0x" << std::hex << scanResults.addresses[i];
+            ValueType rowType = scanResults.rowType(i);
+            json << (i > 0 ? ", " : "") << "{\"address\": " << jsonQuote(addr.str())
+                 << ", \"type\": " << jsonQuote(valueTypeKeyword(rowType))
+                 << ", \"value\": " << jsonQuote(formatValue(scanResults.value(i), resultDisplaySize(i), rowType)) << "}";
+        }
+        json << "]";
+        return json.str();
+    }
+    
+    // The counters of the last scan as a JSON object, for batch output
+    std::string statsJson() {
+        auto seconds = [](uint64_t nanos) { return static_cast<double>(nanos) / 1e9; };
+        std::stringstream json;
+        json << std::fixed << std::setprecision(6)
+             << "{\"scan\": " << jsonQuote(scanStats.description())
+             << ", \"seconds\": " << seconds(scanStats.elapsed())
+             << ", \"read_calls\": " << scanStats.total(STAT_READ_CALLS)
+             << ", \"read_bytes\": " << scanStats.total(STAT_READ_BYTES)
+             << ", \"read_failures\": " << scanStats.total(STAT_READ_FAILURES)
+             << ", \"read_seconds\": " << seconds(scanStats.total(STAT_READ_NANOS))
+             << ", \"remap_calls\": " << scanStats.total(STAT_REMAP_CALLS)
+             << ", \"compare_bytes\": " << scanStats.total(STAT_COMPARE_BYTES)
+             << ", \"compare_seconds\": " << seconds(scanStats.total(STAT_COMPARE_NANOS))
+             << ", \"buffer_allocations\": " << scanStats.total(STAT_BUFFER_ALLOCATIONS)
+             << ", \"buffer_bytes\": " << scanStats.total(STAT_BUFFER_BYTES)
+             << ", \"format_seconds\": " << seconds(scanStats.total(STAT_FORMAT_NANOS)) << "}";
+        return json.str();
+    }
+    
+    bool pollWatchEvent(WatchEvent& event) { return watchEngine.poll(event); }
+    
+    // Print the changes the watch engine has seen since the last call
+    void printWatchEvents() {
+        WatchEvent event;
+        while (watchEngine.poll(event)) {
+            out() << Color::CYAN << "[watch #" << event.id << "] " << Color::RESET
+                      << "0x" << std::hex << event.address << std::dec << ": "
+                      << formatWatchValue(event.oldValue, event.size, event.type) << " → ";
+            if (event.readable) {
+                out() << formatWatchValue(event.newValue, event.size, event.type) << std::endl;
+            } else {
+                out() << "<unreadable>" << std::endl;
+            }
+        }
+        
+        size_t dropped = watchEngine.takeDropped();
+        if (dropped > 0) {
+            out() << Color::YELLOW << "[watch] " << dropped << " changes not shown (event buffer full)" << Color::RESET << std::endl;
+        }
+    }
+    
+    // Watched strings are shown up to their terminator
+    std::string formatWatchValue(const uint8_t* data, size_t size, ValueType type) {
+        if (type == ValueType::STRING) {
+            size = strnlen(reinterpret_cast<const char*>(data), size);
+        } else if (type == ValueType::STRING16) {
+            size_t length = 0;
+            while (length + 1 < size && (data[length] != 0 || data[length + 1] != 0)) {
+                length += 2;
+            }
+            size = length;
+        }
+        return formatValue(data, size, type);
+    }
+    
+    // Print a value based on type
+    void printValue(const void* data, ValueType type) {
+        switch (type) {
+            case ValueType::BYTE:
+                out() << static_cast<int>(*reinterpret_cast<const uint8_t*>(data));
+                break;
+            case ValueType::INT16:
+                out() << *reinterpret_cast<const int16_t*>(data);
+                break;
+            case ValueType::INT32:
+                out() << *reinterpret_cast<const int32_t*>(data);
+                break;
+            case ValueType::INT64:
+                out() << *reinterpret_cast<const int64_t*>(data);
+                break;
+            case ValueType::FLOAT:
+                out() << *reinterpret_cast<const float*>(data);
+                break;
+            case ValueType::DOUBLE:
+                out() << *reinterpret_cast<const double*>(data);
+                break;
+            case ValueType::STRING: {
+                std::string str(reinterpret_cast<const char*>(data));
+                out() << "\"" << str << "\"";
+                break;
+            }
+            default:
+                out() << "Unknown";
+                break;
+        }
+    }
+    
+    // Build the reverse pointer index in one parallel pass over writable regions:
+    // every aligned pointer-sized value that points into readable memory becomes
+    // an entry. Each worker's entries are sorted in parallel, then the sorted runs
+    // are merged pairwise.
+    void buildPointerIndex(PodBuffer<PointerSlot>& index) {
+        index.clear();
+        
+        // Ranges a pointer may point into (adjacent readable regions merged) and the
+        // chunks of writable memory that may hold pointers
+        std::vector<std::pair<mach_vm_address_t, mach_vm_address_t>> readable;
+        std::vector<ScanChunk> chunks;
+        uint64_t totalBytes = 0;
+        for (size_t i = 0; i < memoryRegions.size(); i++) {
+            const MemoryRegion& region = memoryRegions[i];
+            if (!region.readable) {
+                continue;
+            }
+            if (!readable.empty() && readable.back().second == region.start) {
+                readable.back().second = region.start + region.size;
+            } else {
+                readable.push_back(std::make_pair(region.start, region.start + region.size));
+            }
+            
+            if (!region.writable || (region.tags & TAG_GUARD)) {
+                continue;
+            }
+            for (mach_vm_size_t offset = 0; offset < region.size; offset += SCAN_CHUNK_SIZE) {
+                ScanChunk chunk;
+                chunk.region = i;
+                chunk.start = region.start + offset;
+                chunk.size = std::min<mach_vm_size_t>(SCAN_CHUNK_SIZE, region.size - offset);
+                chunks.push_back(chunk);
+            }
+            totalBytes += region.size;
+        }
+        if (readable.empty()) {
+            return;
+        }
+        mach_vm_address_t lowest = readable.front().first;
+        mach_vm_address_t highest = readable.back().second;
+        
+        struct WorkerSlots {
+            PodBuffer<PointerSlot> slots;
+            std::unique_ptr<RegionReader> reader;
+        };
+        std::vector<WorkerSlots> workerSlots(workerPool->size());
+        std::atomic<uint64_t> bytesScanned(0);
+        
+        workerPool->run(chunks.size(), [&](size_t worker, size_t task) {
+            const ScanChunk& chunk = chunks[task];
+            WorkerSlots& local = workerSlots[worker];
+            if (!local.reader) {
+                local.reader.reset(new RegionReader(targetTask, zeroCopy));
+            }
+            
+            // Regions are page aligned, so every delivery starts on a pointer boundary.
+            // Neighbouring slots tend to point into the same range; check it first.
+            size_t range = 0;
+            local.reader->stream(chunk.start, chunk.size, chunk.start + chunk.size, 0,
+                [&](const uint8_t* data, size_t length, size_t, mach_vm_address_t address) {
+                    for (size_t offset = 0; offset + sizeof(mach_vm_address_t) <= length; offset += sizeof(mach_vm_address_t)) {
+                        mach_vm_address_t value = loadValue<mach_vm_address_t>(data + offset);
+                        if (value < lowest || value >= highest) {
+                            continue;
+                        }
+                        if (value < readable[range].first || value >= readable[range].second) {
+                            auto it = std::upper_bound(readable.begin(), readable.end(), value,
+                                [](mach_vm_address_t v, const std::pair<mach_vm_address_t, mach_vm_address_t>& r) { return v < r.first; });
+                            if (it == readable.begin() || value >= std::prev(it)->second) {
+                                continue;
+                            }
+                            range = static_cast<size_t>(std::prev(it) - readable.begin());
+                        }
+                        PointerSlot entry = { value, address + offset };
+                        local.slots.push_back(entry);
+                    }
+                });
+            
+            bytesScanned.fetch_add(chunk.size, std::memory_order_relaxed);
+        }, [&]() {
+            float progress = totalBytes > 0 ? static_cast<float>(bytesScanned.load()) / static_cast<float>(totalBytes) * 100.0f : 100.0f;
+            out() << "\rIndexing pointers... " << std::fixed << std::setprecision(1) << progress << "% complete" << std::flush;
+        });
+        
+        workerPool->run(workerSlots.size(), [&](size_t, size_t task) {
+            PodBuffer<PointerSlot>& slots = workerSlots[task].slots;
+            std::sort(slots.data(), slots.data() + slots.size());
+        });
+        
+        size_t total = 0;
+        for (const WorkerSlots& local : workerSlots) {
+            total += local.slots.size();
+        }
+        index.reserve(total);
+        std::vector<size_t> bounds(1, 0);
+        for (WorkerSlots& local : workerSlots) {
+            index.append(local.slots.data(), local.slots.size());
+            bounds.push_back(index.size());
+            local.slots = PodBuffer<PointerSlot>();
+        }
+        
+        // Merge neighbouring runs until one is left; the merges of a round run in parallel
+        while (bounds.size() > 2) {
+            size_t pairs = (bounds.size() - 1) / 2;
+            workerPool->run(pairs, [&](size_t, size_t pair) {
+                PointerSlot* first = index.data() + bounds[pair * 2];
+                std::inplace_merge(first, index.data() + bounds[pair * 2 + 1], index.data() + bounds[pair * 2 + 2]);
+            });
+            std::vector<size_t> merged;
+            for (size_t i = 0; i < bounds.size(); i += 2) {
+                merged.push_back(bounds[i]);
+            }
+            if (merged.back() != bounds.back()) {
+                merged.push_back(bounds.back());
+            }
+            bounds.swap(merged);
+        }
+    }
+    
+    // Find static pointer paths to target. After indexing, walk back from the
+    // target one level at a time: the slots pointing at most maxOffset bytes
+    // below a node become nodes of the next level, and a slot that lies in a
+    // loaded image ends a path with that image as its base. Each slot is only
+    // visited once, at the shallowest depth it is reached.
+    void pointerScan(mach_vm_address_t target, size_t maxDepth, uint64_t maxOffset) {
+        if (!isAttached) {
+            err() << "Not attached to any process" << std::endl;
+            return;
+        }
+        
+        out() << "Starting pointer scan, please wait..." << std::endl;
+        prepareMemoryRegions();
+        if (moduleMap.empty()) {
+            err() << "No loaded images found to use as static bases" << std::endl;
+            return;
+        }
+        
+        PodBuffer<PointerSlot> index;
+        buildPointerIndex(index);
+        out() << "\rIndexed " << index.size() << " pointers.                " << std::endl;
+        
+        struct PointerNode {
+            mach_vm_address_t address;
+            size_t parent;
+            int64_t offset;
+        };
+        std::vector<PointerNode> nodes;
+        PointerNode root = { target, 0, 0 };
+        nodes.push_back(root);
+        std::unordered_set<mach_vm_address_t> visited;
+        std::vector<PointerPath> paths;
+        const PointerSlot* indexBegin = index.data();
+        const PointerSlot* indexEnd = indexBegin + index.size();
+        
+        size_t levelStart = 0;
+        size_t levelEnd = 1;
+        bool truncated = false;
+        for (size_t depth = 1; depth <= maxDepth && levelStart < levelEnd && !truncated; depth++) {
+            for (size_t n = levelStart; n < levelEnd && !truncated; n++) {
+                mach_vm_address_t address = nodes[n].address;
+                PointerSlot lowest = { address > maxOffset ? address - maxOffset : 0, 0 };
+                for (const PointerSlot* it = std::lower_bound(indexBegin, indexEnd, lowest);
+                     it != indexEnd && it->value <= address; ++it) {
+                    if (!visited.insert(it->slot).second) {
+                        continue;
+                    }
+                    int64_t offset = static_cast<int64_t>(address - it->value);
+                    
+                    const ImageSegment* segment = moduleMap.find(it->slot);
+                    if (segment) {
+                        PointerPath path;
+                        path.image = segment->image;
+                        path.baseOffset = it->slot - segment->imageBase;
+                        path.offsets.push_back(offset);
+                        for (size_t k = n; k != 0; k = nodes[k].parent) {
+                            path.offsets.push_back(nodes[k].offset);
+                        }
+                        paths.push_back(path);
+                        if (paths.size() >= POINTER_PATH_LIMIT) {
+                            truncated = true;
+                            break;
+                        }
+                    } else if (depth < maxDepth) {
+                        if (nodes.size() >= POINTER_NODE_LIMIT) {
+                            truncated = true;
+                            break;
+                        }
+                        PointerNode node = { it->slot, n, offset };
+                        nodes.push_back(node);
+                    }
+                }
+            }
+            levelStart = levelEnd;
+            levelEnd = nodes.size();
+        }
+        
+        pointerPaths.swap(paths);
+        pointerTarget = target;
+        out() << "Pointer scan complete. Found " << pointerPaths.size() << " paths ("
+                  << nodes.size() - 1 << " slots visited)." << std::endl;
+        if (truncated) {
+            out() << "Note: the scan stopped at its limit; lower the depth or offset to see every path" << std::endl;
+        }
+    }
+    
+    // Follow a path in the current process. Fails if its image isn't loaded or a
+    // pointer along the way can't be read.
+    bool resolvePointerPath(const PointerPath& path, mach_vm_address_t& address) {
+        mach_vm_address_t base = 0;
+        if (!moduleMap.imageBase(path.image, base)) {
+            return false;
+        }
+        address = base + path.baseOffset;
+        for (int64_t offset : path.offsets) {
+            mach_vm_address_t pointer = 0;
+            if (!readMemory(address, pointer)) {
+                return false;
+            }
+            address = pointer + offset;
+        }
+        return true;
+    }
+    
+    // Cheat Engine style notation: [[image+0x10]+0x8]+0x4
+    static std::string formatPointerPath(const PointerPath& path) {
+        std::stringstream ss;
+        ss << std::string(path.offsets.size(), '[') << path.image << "+0x" << std::hex << path.baseOffset << "]";
+        for (size_t i = 0; i < path.offsets.size(); i++) {
+            int64_t offset = path.offsets[i];
+            ss << (offset < 0 ? "-0x" : "+0x") << (offset < 0 ? -static_cast<uint64_t>(offset) : static_cast<uint64_t>(offset));
+            if (i + 1 < path.offsets.size()) {
+                ss << "]";
+            }
+        }
+        return ss.str();
+    }
+    
+    // List pointer paths with the address each resolves to now
+    void displayPointers(size_t limit) {
+        if (pointerPaths.empty()) {
+            out() << "No pointer paths; run pointerscan first" << std::endl;
+            return;
+        }
+        
+        out() << Color::BOLD << "Pointer Paths (" << pointerPaths.size() << " total, target 0x"
+                  << std::hex << pointerTarget << std::dec << "):" << Color::RESET << std::endl;
+        out() << "───────────────────────────────────────────────────────────────" << std::endl;
+        out() << Color::BOLD << std::left << std::setw(5) << "ID"
+                  << std::setw(20) << "Resolves to"
+                  << "Path" << Color::RESET << std::endl;
+        out() << "───────────────────────────────────────────────────────────────" << std::endl;
+        
+        for (size_t i = 0; i < pointerPaths.size() && i < limit; i++) {
+            mach_vm_address_t address = 0;
+            std::stringstream resolved;
+            if (resolvePointerPath(pointerPaths[i], address)) {
+                resolved << "0x" << std::hex << std::setw(16) << std::setfill('0') << address;
+            } else {
+                resolved << "(unreadable)";
+            }
+            out() << std::left << std::setw(5) << i
+                      << std::setw(20) << resolved.str()
+                      << formatPointerPath(pointerPaths[i]) << std::endl;
+        }
+        
+        if (pointerPaths.size() > limit) {
+            out() << "... and " << (pointerPaths.size() - limit) << " more paths" << std::endl;
+        }
+        out() << "───────────────────────────────────────────────────────────────" << std::endl;
+    }
+    
+    // Keep the paths that still resolve, and to target when one is given (such as
+    // the address a fresh scan found after the target restarted)
+    void validatePointers(bool haveTarget, mach_vm_address_t target) {
+        if (pointerPaths.empty()) {
+            err() << "No pointer paths to validate" << std::endl;
+            return;
+        }
+        
+        refreshMemoryRegions();
+        size_t before = pointerPaths.size();
+        std::vector<PointerPath> kept;
+        for (const PointerPath& path : pointerPaths) {
+            mach_vm_address_t address = 0;
+            if (resolvePointerPath(path, address) && (!haveTarget || address == target)) {
+                kept.push_back(path);
+            }
+        }
+        pointerPaths.swap(kept);
+        if (haveTarget) {
+            pointerTarget = target;
+        }
+        
+        out() << pointerPaths.size() << " of " << before << " pointer paths still "
+                  << (haveTarget ? "lead to the target" : "resolve") << std::endl;
+    }
+    
+    // Load a signature file: one pattern per line, "name: 48 8B ?? ?? 89" or just
+    // the bytes. Blank lines and lines starting with # are ignored.
+    void loadPatterns(const std::string& filename) {
+        std::ifstream file(filename);
+        if (!file) {
+            err() << "Failed to open file: " << filename << std::endl;
+            return;
+        }
+        
+        std::vector<BytePattern> patterns;
+        std::string line;
+        size_t lineNumber = 0;
+        size_t skipped = 0;
+        while (std::getline(file, line)) {
+            lineNumber++;
+            size_t first = line.find_first_not_of(" \t\r");
+            if (first == std::string::npos || line[first] == '#') {
+                continue;
+            }
+            
+            BytePattern pattern;
+            std::string bytes = line;
+            size_t colon = line.find(':');
+            if (colon != std::string::npos) {
+                pattern.name = line.substr(first, colon - first);
+                pattern.name.erase(pattern.name.find_last_not_of(" \t") + 1);
+                bytes = line.substr(colon + 1);
+            }
+            if (pattern.name.empty()) {
+                pattern.name = "line " + std::to_string(lineNumber);
+            }
+            
+            if (!parseBytePattern(bytes, pattern)) {
+                out() << filename << ":" << lineNumber << ": invalid pattern, skipped" << std::endl;
+                skipped++;
+                continue;
+            }
+            patterns.push_back(pattern);
+        }
+        
+        loadedPatterns.compile(patterns);
+        out() << "Loaded " << loadedPatterns.size() << " patterns from " << filename;
+        if (skipped > 0) {
+            out() << " (" << skipped << " skipped)";
+        }
+        out() << std::endl;
+    }
+    
+    void listPatterns() {
+        if (loadedPatterns.empty()) {
+            out() << "No patterns loaded; use patterns load <file>" << std::endl;
+            return;
+        }
+        out() << Color::BOLD << "Patterns (" << loadedPatterns.size() << " loaded):" << Color::RESET << std::endl;
+        for (size_t i = 0; i < loadedPatterns.size(); i++) {
+            out() << "  " << std::left << std::setw(24) << loadedPatterns[i].name
+                      << formatBytePattern(loadedPatterns[i]) << std::endl;
+        }
+    }
+    
+    // Match every loaded pattern in one pass. Executable regions are scanned unless
+    // the filter includes tags of its own.
+    void scanPatterns(const RegionFilter& filter = RegionFilter()) {
+        if (loadedPatterns.empty()) {
+            err() << "No patterns loaded; use patterns load <file>" << std::endl;
+            return;
+        }
+        scanPatterns(loadedPatterns, filter);
+    }
+    
+    void scanPatterns(const PatternMatcher& matcher, const RegionFilter& filter) {
+        if (!isAttached) {
+            err() << "Not attached to any process" << std::endl;
+            return;
+        }
+        
+        out() << "Starting pattern scan for " << matcher.size() << (matcher.size() == 1 ? " pattern" : " patterns")
+                  << ", please wait..." << std::endl;
+        prepareMemoryRegions();
+        
+        std::vector<ScanChunk> chunks;
+        uint64_t totalBytes = 0;
+        for (size_t i = 0; i < memoryRegions.size(); i++) {
+            const MemoryRegion& region = memoryRegions[i];
+            if (!region.readable || !filter.matches(region) || (filter.include == 0 && !region.executable)) {
+                continue;
+            }
+            for (mach_vm_size_t offset = 0; offset < region.size; offset += SCAN_CHUNK_SIZE) {
+                ScanChunk chunk;
+                chunk.region = i;
+                chunk.start = region.start + offset;
+                chunk.size = std::min<mach_vm_size_t>(SCAN_CHUNK_SIZE, region.size - offset);
+                chunks.push_back(chunk);
+            }
+            totalBytes += region.size;
+        }
+        
+        struct WorkerHits {
+            std::vector<PatternHit> hits;
+            std::unique_ptr<RegionReader> reader;
+        };
+        std::vector<WorkerHits> workerHits(workerPool->size());
+        std::atomic<uint64_t> bytesScanned(0);
+        size_t overlap = matcher.maxLength() - 1;
+        
+        workerPool->run(chunks.size(), [&](size_t worker, size_t task) {
+            const ScanChunk& chunk = chunks[task];
+            const MemoryRegion& region = memoryRegions[chunk.region];
+            WorkerHits& local = workerHits[worker];
+            if (!local.reader) {
+                local.reader.reset(new RegionReader(targetTask, zeroCopy));
+            }
+            
+            local.reader->stream(chunk.start, chunk.size, region.start + region.size, overlap,
+                [&](const uint8_t* data, size_t length, size_t startLimit, mach_vm_address_t address) {
+                    matcher.search(data, length, startLimit, address, [&](uint32_t pattern, mach_vm_address_t match) {
+                        PatternHit hit = { pattern, match };
+                        local.hits.push_back(hit);
+                    });
+                });
+            
+            bytesScanned.fetch_add(chunk.size, std::memory_order_relaxed);
+        }, [&]() {
+            float progress = totalBytes > 0 ? static_cast<float>(bytesScanned.load()) / static_cast<float>(totalBytes) * 100.0f : 100.0f;
+            out() << "\rScanning... " << std::fixed << std::setprecision(1) << progress << "% complete" << std::flush;
+        });
+        
+        std::vector<PatternHit> hits;
+        for (const WorkerHits& local : workerHits) {
+            hits.insert(hits.end(), local.hits.begin(), local.hits.end());
+        }
+        std::sort(hits.begin(), hits.end());
+        
+        out() << "\rPattern scan complete. Found " << hits.size() << " matches.                " << std::endl;
+        displayPatternHits(matcher, hits);
+    }
+    
+    // Matches grouped by pattern, with image-relative addresses where possible
+    void displayPatternHits(const PatternMatcher& matcher, const std::vector<PatternHit>& hits) {
+        size_t next = 0;
+        for (uint32_t pattern = 0; pattern < matcher.size(); pattern++) {
+            size_t first = next;
+            while (next < hits.size() && hits[next].pattern == pattern) {
+                next++;
+            }
+            
+            out() << Color::BOLD << matcher[pattern].name << Color::RESET << ": " << (next - first)
+                      << (next - first == 1 ? " match" : " matches") << std::endl;
+            for (size_t i = first; i < next && i - first < PATTERN_DISPLAY_LIMIT; i++) {
+                mach_vm_address_t address = hits[i].address;
+                out() << "  0x" << std::hex << std::setw(16) << std::setfill('0') << address << std::dec << std::setfill(' ');
+                const ImageSegment* segment = moduleMap.find(address);
+                if (segment) {
+                    out() << "  " << segment->image << "+0x" << std::hex << (address - segment->imageBase) << std::dec;
+                }
+                out() << std::endl;
+            }
+            if (next - first > PATTERN_DISPLAY_LIMIT) {
+                out() << "  ... and " << (next - first - PATTERN_DISPLAY_LIMIT) << " more" << std::endl;
+            }
+        }
+    }
+    
+    // Save scan results and pointer paths as a binary session file
+    void saveResults(const std::string& filename) {
+        if (pointerPaths.empty() && !checkResultsToSave()) {
+            return;
+        }
+        
+        SessionHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, SESSION_MAGIC, sizeof(header.magic));
+        header.version = SESSION_VERSION;
+        header.headerSize = sizeof(SessionHeader);
+        header.pid = targetPid;
+        header.type = static_cast<uint32_t>(scanResults.type);
+        header.valueSize = scanResults.valueSize;
+        header.count = scanResults.size();
+        header.regionCount = memoryRegions.size();
+        header.timestamp = static_cast<uint64_t>(std::time(nullptr));
+        strncpy(header.processName, targetName.c_str(), sizeof(header.processName) - 1);
+        
+        std::vector<SessionRegion> regions(memoryRegions.size());
+        for (size_t i = 0; i < memoryRegions.size(); i++) {
+            regions[i].start = memoryRegions[i].start;
+            regions[i].size = memoryRegions[i].size;
+            regions[i].protection = memoryRegions[i].protection;
+            regions[i].reserved = 0;
+        }
+        
+        // Pointer paths refer to images by index into a name table
+        std::vector<SessionImage> images;
+        std::vector<SessionPointer> pointers(pointerPaths.size());
+        for (size_t i = 0; i < pointerPaths.size(); i++) {
+            const PointerPath& path = pointerPaths[i];
+            size_t image = 0;
+            while (image < images.size() && path.image != images[image].name) {
+                image++;
+            }
+            if (image == images.size()) {
+                SessionImage entry;
+                memset(&entry, 0, sizeof(entry));
+                strncpy(entry.name, path.image.c_str(), sizeof(entry.name) - 1);
+                mach_vm_address_t base = 0;
+                entry.base = moduleMap.imageBase(path.image, base) ? base : 0;
+                images.push_back(entry);
+            }
+            
+            SessionPointer& record = pointers[i];
+            memset(&record, 0, sizeof(record));
+            record.image = static_cast<uint32_t>(image);
+            record.depth = static_cast<uint32_t>(path.offsets.size());
+            record.baseOffset = path.baseOffset;
+            std::copy(path.offsets.begin(), path.offsets.end(), record.offsets);
+        }
+        header.pointerTarget = pointerTarget;
+        header.imageCount = images.size();
+        header.pointerCount = pointers.size();
+        
+        // Columns start on a page boundary so a loaded session can use them in place
+        size_t tableEnd = sizeof(SessionHeader) + regions.size() * sizeof(SessionRegion);
+        size_t pageSize = vm_page_size;
+        size_t addressOffset = (tableEnd + pageSize - 1) & ~(pageSize - 1);
+        header.addressOffset = addressOffset;
+        header.valueOffset = addressOffset + scanResults.size() * sizeof(mach_vm_address_t);
+        std::vector<uint8_t> padding(addressOffset - tableEnd, 0);
+        
+        size_t valueEnd = header.valueOffset + scanResults.values.size();
+        if (!scanResults.types.empty()) {
+            header.typeOffset = valueEnd;
+            valueEnd += scanResults.types.size();
+        }
+        header.imageOffset = (valueEnd + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1);
+        header.pointerOffset = header.imageOffset + images.size() * sizeof(SessionImage);
+        std::vector<uint8_t> pointerPadding(header.imageOffset - valueEnd, 0);
+        
+        int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            err() << "Failed to open file: " << filename << std::endl;
+            return;
+        }
+        
+        struct iovec parts[9] = {
+            { &header, sizeof(header) },
+            { regions.data(), regions.size() * sizeof(SessionRegion) },
+            { padding.data(), padding.size() },
+            { scanResults.addresses.data(), scanResults.size() * sizeof(mach_vm_address_t) },
+            { scanResults.values.data(), scanResults.values.size() },
+            { scanResults.types.data(), scanResults.types.size() },
+            { pointerPadding.data(), pointerPadding.size() },
+            { images.data(), images.size() * sizeof(SessionImage) },
+            { pointers.data(), pointers.size() * sizeof(SessionPointer) }
+        };
+        bool written = writeFully(fd, parts, 9);
+        if (close(fd) != 0) {
+            written = false;
+        }
+        
+        if (!written) {
+            err() << "Failed to write file: " << filename << std::endl;
+            return;
+        }
+        out() << "Saved " << scanResults.size() << " results";
+        if (!pointerPaths.empty()) {
+            out() << " and " << pointerPaths.size() << " pointer paths";
+        }
+        out() << " to " << filename << std::endl;
+    }
+    
+    // Write all iovecs, continuing after short writes
+    static bool writeFully(int fd, struct iovec* parts, int count) {
+        while (count > 0) {
+            ssize_t written = writev(fd, parts, std::min(count, IOV_MAX));
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            
+            size_t remaining = static_cast<size_t>(written);
+            while (count > 0 && remaining >= parts->iov_len) {
+                remaining -= parts->iov_len;
+                parts++;
+                count--;
+            }
+            if (count > 0) {
+                parts->iov_base = static_cast<uint8_t*>(parts->iov_base) + remaining;
+                parts->iov_len -= remaining;
+            }
+        }
+        return true;
+    }
+    
+    // Export scan results as human-readable CSV
+    void exportResults(const std::string& filename) {
+        if (!checkResultsToSave()) {
+            return;
+        }
+        StatTimer timer(STAT_FORMAT_NANOS);
+        
+        std::ofstream file(filename);
+        if (!file) {
+            err() << "Failed to open file: " << filename << std::endl;
+            return;
+        }
+        
+        file << "# MacMemory Scan Results" << std::endl;
+        file << "# Process: " << targetName << " (PID: " << targetPid << ")" << std::endl;
+        file << "# Timestamp: " << std::time(nullptr) << std::endl;
+        file << "# Results: " << scanResults.size() << std::endl;
+        file << "# Format: ID,Address,Type,Value,Description" << std::endl;
+        
+        for (size_t i = 0; i < scanResults.size(); i++) {
+            const uint8_t* value = scanResults.value(i);
+            ValueType rowType = scanResults.rowType(i);
+            
+            file << std::dec << i << ","
+                 << "0x" << std::hex << scanResults.addresses[i] << std::dec << ","
+                 << static_cast<int>(rowType) << ",";
+            
+            // Save value as hex bytes
+            for (size_t j = 0; j < scanResults.rowSize(i); j++) {
+                file << std::hex << std::setw(2) << std::setfill('0') 
+                     << static_cast<int>(value[j]);
+            }
+            
+            file << std::dec << "," << formatValue(value, resultDisplaySize(i), rowType) << std::endl;
+        }
+        
+        file.close();
+        out() << "Exported " << scanResults.size() << " results to " << filename << std::endl;
+    }
+    
+    bool checkResultsToSave() {
+        if (bitmapScan) {
+            err() << "Too many candidates to save (" << bitmapScan->candidates << "); narrow them down with next first" << std::endl;
+            return false;
+        }
+        if (scanResults.empty()) {
+            err() << "No results to save" << std::endl;
+            return false;
+        }
+        return true;
+    }
+    
+    // Load a binary session file. The file is mapped privately and its columns
+    // are used in place, so even very large sessions load without copying.
+    void loadResults(const std::string& filename) {
+        if (!isAttached) {
+            err() << "Not attached to any process" << std::endl;
+            return;
+        }
+        
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            err() << "Failed to open file: " << filename << std::endl;
+            return;
+        }
+        
+        struct stat info;
+        if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(SessionHeader)) {
+            close(fd);
+            err() << "Not a MacMemory session file: " << filename << std::endl;
+            return;
+        }
+        
+        size_t length = static_cast<size_t>(info.st_size);
+        void* base = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (base == MAP_FAILED) {
+            err() << "Failed to map file: " << filename << std::endl;
+            return;
+        }
+        std::shared_ptr<void> mapping(base, [length](void* address) { munmap(address, length); });
+        
+        // Older headers are shorter; the fields they lack read as zero
+        SessionHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(&header, base, SESSION_V1_HEADER_SIZE);
+        if (memcmp(header.magic, SESSION_MAGIC, sizeof(header.magic)) != 0) {
+            err() << "Not a MacMemory session file: " << filename << std::endl;
+            return;
+        }
+        bool knownVersion = (header.version == 1 && header.headerSize == SESSION_V1_HEADER_SIZE) ||
+                            (header.version == 2 && header.headerSize == SESSION_V2_HEADER_SIZE) ||
+                            (header.version == SESSION_VERSION && header.headerSize == sizeof(SessionHeader));
+        if (!knownVersion || header.headerSize > length) {
+            err() << "Unsupported session file version " << header.version << std::endl;
+            return;
+        }
+        memcpy(&header, base, header.headerSize);
+        
+        // Every column has to lie inside the file
+        uint64_t addressBytes = header.count * sizeof(mach_vm_address_t);
+        uint64_t valueBytes = header.count * header.valueSize;
+        bool typed = header.count > 0 && header.type == static_cast<uint32_t>(ValueType::ANY);
+        uint64_t columnEnd = header.valueOffset + valueBytes + (typed ? header.count : 0);
+        if ((header.count > 0 && (header.type >= static_cast<uint32_t>(ValueType::UNKNOWN) || header.valueSize == 0)) ||
+            header.count > length / sizeof(mach_vm_address_t) ||
+            header.valueSize > length ||
+            header.regionCount > length / sizeof(SessionRegion) ||
+            header.headerSize + header.regionCount * sizeof(SessionRegion) > header.addressOffset ||
+            header.addressOffset % sizeof(mach_vm_address_t) != 0 ||
+            header.addressOffset + addressBytes != header.valueOffset ||
+            header.valueOffset > length || valueBytes > length - header.valueOffset ||
+            (typed && (header.typeOffset != header.valueOffset + valueBytes || header.count > length - header.typeOffset)) ||
+            header.imageCount > length / sizeof(SessionImage) ||
+            header.pointerCount > length / sizeof(SessionPointer) ||
+            (header.pointerCount > 0 && (header.imageOffset < columnEnd ||
+                                         header.imageOffset + header.imageCount * sizeof(SessionImage) != header.pointerOffset ||
+                                         header.pointerOffset > length ||
+                                         header.pointerCount * sizeof(SessionPointer) > length - header.pointerOffset))) {
+            err() << "Session file is damaged: " << filename << std::endl;
+            return;
+        }
+        
+        const uint8_t* bytes = static_cast<const uint8_t*>(base);
+        for (uint64_t i = 0; typed && i < header.count; i++) {
+            size_t width = valueTypeSize(static_cast<ValueType>(bytes[header.typeOffset + i]));
+            if (width == 0 || width > header.valueSize) {
+                err() << "Session file is damaged: " << filename << std::endl;
+                return;
+            }
+        }
+        
+        std::vector<PointerPath> paths(header.pointerCount);
+        if (header.pointerCount > 0) {
+            const SessionImage* images = reinterpret_cast<const SessionImage*>(bytes + header.imageOffset);
+            const SessionPointer* pointers = reinterpret_cast<const SessionPointer*>(bytes + header.pointerOffset);
+            for (size_t i = 0; i < paths.size(); i++) {
+                const SessionPointer& record = pointers[i];
+                if (record.image >= header.imageCount || record.depth == 0 || record.depth > POINTER_MAX_DEPTH) {
+                    err() << "Session file is damaged: " << filename << std::endl;
+                    return;
+                }
+                const SessionImage& image = images[record.image];
+                paths[i].image = std::string(image.name, strnlen(image.name, sizeof(image.name)));
+                paths[i].baseOffset = record.baseOffset;
+                paths[i].offsets.assign(record.offsets, record.offsets + record.depth);
+            }
+        }
+        
+        std::string processName(header.processName, strnlen(header.processName, sizeof(header.processName)));
+        if (processName != targetName) {
+            out() << Color::YELLOW << "Warning: session was saved from " << processName << " (PID: " << header.pid
+                      << "), attached to " << targetName << Color::RESET << std::endl;
+        } else if (header.pid != targetPid) {
+            out() << "Note: session was saved from PID " << header.pid << "; addresses may have moved" << std::endl;
+        }
+        
+        // Compare the saved region table with the current memory map
+        const SessionRegion* regions = reinterpret_cast<const SessionRegion*>(bytes + header.headerSize);
+        size_t missing = 0;
+        for (uint64_t i = 0; i < header.regionCount; i++) {
+            bool found = false;
+            for (const MemoryRegion& region : memoryRegions) {
+                if (region.start == regions[i].start && region.size == regions[i].size) {
+                    found = true;
+                    break;
+                }
+            }
+            if (!found) {
+                missing++;
+            }
+        }
+        if (missing > 0) {
+            out() << "Note: " << missing << " of " << header.regionCount << " saved regions are no longer mapped" << std::endl;
+        }
+        
+        clearResults();
+        uint8_t* columns = static_cast<uint8_t*>(base);
+        scanResults.type = header.count > 0 ? static_cast<ValueType>(header.type) : UNKNOWN;
+        scanResults.valueSize = header.valueSize;
+        scanResults.addresses.adopt(reinterpret_cast<mach_vm_address_t*>(columns + header.addressOffset), header.count, mapping);
+        scanResults.values.adopt(columns + header.valueOffset, valueBytes, mapping);
+        if (typed) {
+            scanResults.types.adopt(columns + header.typeOffset, header.count, mapping);
+        }
+        pointerPaths.swap(paths);
+        pointerTarget = header.pointerTarget;
+        
+        out() << "Loaded " << scanResults.size() << " results";
+        if (!scanResults.empty()) {
+            out() << " (" << valueTypeNames[scanResults.type] << ")";
+        }
+        if (!pointerPaths.empty()) {
+            out() << " and " << pointerPaths.size() << " pointer paths";
+        }
+        out() << " from " << filename << std::endl;
+    }
+    
+    // Refresh and list memory regions, noting what changed since the last refresh
+    void displayRegions() {
+        if (!isAttached) {
+            err() << "Not attached to any process" << std::endl;
+            return;
+        }
+        
+        RegionDiff diff = refreshMemoryRegions();
+        
+        out() << Color::BOLD << "Memory Regions (" << memoryRegions.size() << " total):" << Color::RESET << std::endl;
+        out() << "───────────────────────────────────────────────────────────────" << std::endl;
+        out() << Color::BOLD << std::left << std::setw(20) << "Start" 
+                  << std::setw(20) << "End" 
+                  << std::setw(12) << "Size" 
+                  << std::setw(12) << "Protection" 
+                  << "Tags" << Color::RESET << std::endl;
+        out() << "───────────────────────────────────────────────────────────────" << std::endl;
+        
+        for (const MemoryRegion& region : memoryRegions) {
+            std::stringstream start, end, size;
+            start << "0x" << std::hex << std::setw(16) << std::setfill('0') << region.start;
+            end << "0x" << std::hex << std::setw(16) << std::setfill('0') << (region.start + region.size);
+            if (region.size >= 1024 * 1024) {
+                size << (region.size / (1024 * 1024)) << " MB";
+            } else {
+                size << (region.size / 1024) << " KB";
+            }
+            
+            out() << std::left << std::setw(20) << start.str() 
+                      << std::setw(20) << end.str() 
+                      << std::setw(12) << size.str() 
+                      << std::setw(12) << region.name 
+                      << formatRegionTags(region.tags) << std::endl;
+        }
+        
+        out() << "───────────────────────────────────────────────────────────────" << std::endl;
+        if (!diff.empty()) {
+            out() << "Since the last refresh: " << diff.added << " added, " << diff.removed << " removed, "
+                      << diff.changed << " changed" << std::endl;
+        }
+    }
+    
+    // Get current attached process info
+    void getProcessInfo() {
+        if (!isAttached) {
+            err() << "Not attached to any process" << std::endl;
+            return;
+        }
+        
+        out() << "Process Information:" << std::endl;
+        out() << "  Name: " << targetName << std::endl;
+        out() << "  PID: " << targetPid << std::endl;
+        out() << "  Memory Regions: " << memoryRegions.size() << std::endl;
+        out() << "  Current Scan Results: " << scanResults.size() << std::endl;
+        
+        // Get total memory usage
+        size_t totalMemory = 0;
+        for (const auto& region : memoryRegions) {
+            totalMemory += region.size;
+        }
+        
+        out() << "  Total Memory: " << (totalMemory / (1024 * 1024)) << " MB" << std::endl;
+    }
+    
+    // Scan engine settings
+    void setThreadCount(size_t threadCount) { workerPool->resize(threadCount); }
+    size_t getThreadCount() const { return workerPool->size(); }
+    void setZeroCopy(bool enabled) { zeroCopy = enabled; }
+    bool getZeroCopy() const { return zeroCopy; }
+    void setSimd(bool enabled) { useSimd = enabled; }
+    bool getSimd() const { return useSimd; }
+    // 0 = natural alignment of the scanned type, 1 = unaligned
+    void setAlignment(size_t bytes) { alignment = bytes; }
+    size_t getAlignment() const { return alignment; }
+    
+    void setRescanMode(RescanMode mode) { rescanMode = mode; }
+    RescanMode getRescanMode() const { return rescanMode; }
+    
+    // First scans read ahead on separate reader threads (0 = half the workers)
+    void setPipelined(bool enabled) { pipelined = enabled; }
+    bool getPipelined() const { return pipelined; }
+    void setReaderThreads(size_t count) { readerThreads = count; }
+    size_t getReaderThreads() const { return readerThreads > 0 ? readerThreads : std::max<size_t>(1, workerPool->size() / 2); }
+    
+    // Walk the region map before every scan, or only on attach and regions
+    void setRegionRefresh(bool eachScan) { refreshEachScan = eachScan; }
+    bool getRegionRefresh() const { return refreshEachScan; }
+    // Progress lines of foreground scans
+    void setProgress(bool enabled) { showProgress = enabled; }
+    // Send messages and errors somewhere other than stdout and stderr
+    void setOutput(std::ostream& messages, std::ostream& errors) {
+        output = &messages;
+        errorOutput = &errors;
+        scanJob.setOutput(messages, errors);
+    }
+    // Called with (bytes done, bytes total, hits) while a scan runs
+    void setProgressCallback(const std::function<void(uint64_t, uint64_t, uint64_t)>& callback) { progressCallback = callback; }
+    
+    // Take over the scan settings of another scanner (not its thread count,
+    // which belongs to the worker pool)
+    void copySettings(const MemoryScanner& other) {
+        zeroCopy = other.zeroCopy;
+        useSimd = other.useSimd;
+        alignment = other.alignment;
+        rescanMode = other.rescanMode;
+        pipelined = other.pipelined;
+        readerThreads = other.readerThreads;
+        refreshEachScan = other.refreshEachScan;
+        anyTypes = other.anyTypes;
+    }
+    
+    std::shared_ptr<WorkerPool> getWorkerPool() const { return workerPool; }
+    
+    // Types an any scan looks for, in the order tied hits are listed
+    void setAnyTypes(const std::vector<ValueType>& types) { anyTypes = types; }
+    const std::vector<ValueType>& getAnyTypes() const { return anyTypes; }
+    
+    // Helper methods
+    bool isProcessAttached() const { return isAttached; }
+    std::string getProcessName() const { return targetName; }
+    pid_t getProcessId() const { return targetPid; }
+    size_t getRegionCount() const { return memoryRegions.size(); }
+    size_t getResultCount() const { return bitmapScan ? bitmapScan->candidates : scanResults.size(); }
+    // Results of the last scan; empty while an unknown scan keeps its candidates as a bitmap
+    const ResultStore& getResults() const { return scanResults; }
+    bool hasCandidateBitmap() const { return bitmapScan != nullptr; }
+    // Bytes the last scan went through
+    uint64_t getScanBytes() const { return scanJob.bytesScanned(); }
+};
+
+// Several attached processes scanned together, such as an app and its helper
+// processes. Every member is a MemoryScanner with its own region index and
+// results, and all of them share the worker pool of the host scanner. A scan of
+// the set runs on the host's current job and goes through the members one after
+// the other, each using every worker.
+class ProcessSet {
+private:
+    MemoryScanner& host;
+    std::vector<std::unique_ptr<MemoryScanner>> members;
+    std::ostream* output;
+    std::ostream* errorOutput;
+    std::ostringstream discarded;
+    
+    std::ostream& out() { return *output; }
+    std::ostream& err() { return *errorOutput; }
+    
+    // Between scans members keep quiet, except for errors
+    void quiet(MemoryScanner& member) {
+        discarded.str("");
+        member.setOutput(discarded, *errorOutput);
+    }
+
+public:
+    explicit ProcessSet(MemoryScanner& hostScanner) : host(hostScanner), output(&std::cout), errorOutput(&std::cerr) {}
+    
+    ~ProcessSet() {
+        removeAll();
+    }
+    
+    ProcessSet(const ProcessSet&) = delete;
+    ProcessSet& operator=(const ProcessSet&) = delete;
+    
+    size_t size() const { return members.size(); }
+    bool empty() const { return members.empty(); }
+    
+    MemoryScanner* find(pid_t pid) {
+        for (auto& member : members) {
+            if (member->getProcessId() == pid) {
+                return member.get();
+            }
+        }
+        return nullptr;
+    }
+    
+    // Attach to another process; members stay in PID order
+    bool add(pid_t pid) {
+        if (find(pid)) {
+            err() << "PID " << pid << " is already in the set" << std::endl;
+            return false;
+        }
+        
+        std::unique_ptr<MemoryScanner> member(new MemoryScanner(host.getWorkerPool()));
+        quiet(*member);
+        if (!member->attachProcess(pid)) {
+            return false;
+        }
+        out() << "Added " << member->getProcessName() << " (PID " << pid << ", " << member->getRegionCount() << " regions)" << std::endl;
+        
+        auto position = std::lower_bound(members.begin(), members.end(), pid, [](const std::unique_ptr<MemoryScanner>& a, pid_t b) {
+            return a->getProcessId() < b;
+        });
+        members.insert(position, std::move(member));
+        return true;
+    }
+    
+    bool remove(pid_t pid) {
+        for (auto it = members.begin(); it != members.end(); ++it) {
+            if ((*it)->getProcessId() == pid) {
+                quiet(**it);
+                members.erase(it);
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    size_t removeAll() {
+        size_t count = members.size();
+        for (auto& member : members) {
+            quiet(*member);
+        }
+        members.clear();
+        return count;
+    }
+    
+    // Run scan on every member as part of the host's current job. Each process
+    // reports under its own heading; cancelling the job stops the member being
+    // scanned and skips the rest. Returns the results of all members.
+    size_t scan(const std::string& description, const std::function<void(MemoryScanner&)>& fn) {
+        std::ostream& console = host.jobConsole();
+        uint64_t bytesBefore = 0;
+        size_t scanned = 0;
+        
+        for (auto& member : members) {
+            if (host.jobCancelled()) {
+                break;
+            }
+            MemoryScanner& scanner = *member;
+            scanner.copySettings(host);
+            scanner.setOutput(console, host.jobErrorConsole());
+            scanner.setProgress(!host.jobInBackground());
+            
+            // Forward the member's progress to the host's job
+            uint64_t reported = 0;
+            scanner.setProgressCallback([&](uint64_t done, uint64_t total, uint64_t) {
+                host.addJobProgress(done - reported, bytesBefore + total);
+                reported = done;
+                if (host.jobCancelled()) {
+                    scanner.requestCancel();
+                }
+            });
+            
+            console << Color::BOLD << scanner.getProcessName() << " (PID " << scanner.getProcessId() << "):" << Color::RESET << std::endl;
+            try {
+                scanner.runNestedJob(description, [&]() { fn(scanner); });
+            } catch (...) {
+                scanner.setProgressCallback(nullptr);
+                quiet(scanner);
+                throw;
+            }
+            host.addJobProgress(scanner.getScanBytes() - reported, bytesBefore + scanner.getScanBytes());
+            bytesBefore += scanner.getScanBytes();
+            scanner.setProgressCallback(nullptr);
+            quiet(scanner);
+            scanned++;
+        }
+        
+        size_t results = resultCount();
+        console << (host.jobCancelled() ? "Cancelled after " : "Scanned ") << scanned << " of " << members.size()
+                << " processes: " << results << " results in total" << std::endl;
+        return results;
+    }
+    
+    size_t resultCount() const {
+        size_t count = 0;
+        for (const auto& member : members) {
+            count += member->getResultCount();
+        }
+        return count;
+    }
+    
+    void list() {
+        if (members.empty()) {
+            out() << "No processes in the set (multi add <pid...>)" << std::endl;
+            return;
+        }
+        
+        out() << Color::BOLD << "Process Set (" << members.size() << " processes):" << Color::RESET << std::endl;
+        out() << "───────────────────────────────────────────────────────────────" << std::endl;
+        out() << Color::BOLD << std::left << std::setw(8) << "PID"
+                  << std::setw(28) << "Process Name"
+                  << std::setw(10) << "Regions"
+                  << "Results" << Color::RESET << std::endl;
+        out() << "───────────────────────────────────────────────────────────────" << std::endl;
+        for (const auto& member : members) {
+            out() << std::left << std::setw(8) << member->getProcessId()
+                      << std::setw(28) << member->getProcessName().substr(0, 27)
+                      << std::setw(10) << member->getRegionCount()
+                      << member->getResultCount() << std::endl;
+        }
+        out() << "───────────────────────────────────────────────────────────────" << std::endl;
+    }
+    
+    // The results of every member, tagged with its PID; limit applies per process
+    void displayResults(size_t limit) {
+        size_t total = resultCount();
+        if (total == 0) {
+            out() << "No scan results to display" << std::endl;
+            return;
+        }
+        
+        out() << Color::BOLD << "Scan Results (" << total << " total in " << members.size() << " processes):" << Color::RESET << std::endl;
+        out() << "───────────────────────────────────────────────────────────────" << std::endl;
+        out() << Color::BOLD << std::left << std::setw(8) << "PID"
+                  << std::setw(18) << "Address"
+                  << std::setw(18) << "Type"
+                  << "Value" << Color::RESET << std::endl;
+        out() << "───────────────────────────────────────────────────────────────" << std::endl;
+        
+        for (auto& member : members) {
+            if (member->getResultCount() == 0) {
+                continue;
+            }
+            member->setOutput(out(), *errorOutput);
+            size_t shown = member->displayTaggedResults(limit);
+            if (shown > 0 && member->getResultCount() > shown) {
+                out() << "        ... and " << (member->getResultCount() - shown) << " more in PID " << member->getProcessId() << std::endl;
+            }
+            quiet(*member);
+        }
+        out() << "───────────────────────────────────────────────────────────────" << std::endl;
+    }
+    
+    void clearResults() {
+        for (auto& member : members) {
+            member->clearResults();
+        }
+    }
+};
+
+#endif // MACMEMORY_SCANNER_H
@@ -0,0 +1,172 @@
+// MacMemory scan kernel test
+// Runs the vector kernels and the scalar typed loops they stand in for over the
+// same random buffers and checks that both find exactly the same offsets. Buffers
+// have odd lengths, start at every misalignment and include tails shorter than
+// one vector; float buffers are seeded with NaN, infinities and both zeros.
+
+#include "../scanner.h"
+
+#include <random>
+
+struct KernelType {
+    ValueType type;
+    const char* name;
+    size_t size;
+};
+
+struct KernelComparison {
+    Comparison comparison;
+    const char* name;
+};
+
+const KernelType kernelTypes[] = {
+    { ValueType::BYTE, "byte", 1 },
+    { ValueType::INT16, "short", 2 },
+    { ValueType::INT32, "int", 4 },
+    { ValueType::INT64, "long", 8 },
+    { ValueType::FLOAT, "float", 4 },
+    { ValueType::DOUBLE, "double", 8 }
+};
+
+const KernelComparison kernelComparisons[] = {
+    { COMPARE_EXACT, "exact" },
+    { COMPARE_GREATER, "greater" },
+    { COMPARE_LESS, "less" },
+    { COMPARE_BETWEEN, "between" }
+};
+
+// 0 is the natural alignment of the type
+const size_t kernelAlignments[] = { 0, 1, 2, 4, 8 };
+
+// Every count up to this is tried, to cover tails shorter than one vector
+const size_t SHORT_COUNT_MAX = 80;
+const size_t LONG_COUNT_MAX = 4096;
+const size_t RANDOM_ROUNDS = 40;
+const size_t BASE_SHIFT_MAX = 16;
+
+class KernelTest {
+private:
+    std::mt19937_64 random;
+    size_t checks;
+    size_t failures;
+    
+    template <typename T>
+    static void storeValue(uint8_t* data, T value) {
+        memcpy(data, &value, sizeof(T));
+    }
+    
+    // A value that scans are likely to compare against in interesting ways
+    void specialValue(const KernelType& type, uint8_t* data) {
+        if (type.type == ValueType::FLOAT) {
+            const float values[] = { 0.0f, -0.0f, 1.0f, -1.0f, 2.5f, std::numeric_limits<float>::infinity(),
+                                     -std::numeric_limits<float>::infinity(), std::numeric_limits<float>::quiet_NaN(),
+                                     -std::numeric_limits<float>::quiet_NaN(), std::numeric_limits<float>::denorm_min() };
+            storeValue(data, values[random() % (sizeof(values) / sizeof(values[0]))]);
+        } else if (type.type == ValueType::DOUBLE) {
+            const double values[] = { 0.0, -0.0, 1.0, -1.0, 2.5, std::numeric_limits<double>::infinity(),
+                                      -std::numeric_limits<double>::infinity(), std::numeric_limits<double>::quiet_NaN(),
+                                      -std::numeric_limits<double>::quiet_NaN(), std::numeric_limits<double>::denorm_min() };
+            storeValue(data, values[random() % (sizeof(values) / sizeof(values[0]))]);
+        } else {
+            // Small values and the extremes of the type
+            for (size_t i = 0; i < type.size; i++) {
+                data[i] = random() % 2 == 0 ? 0 : 0xff;
+            }
+            data[random() % type.size] = static_cast<uint8_t>(random() % 3);
+        }
+    }
+    
+    // Mostly a few byte values, so exact matches and equal neighbours are common
+    void fillBuffer(const KernelType& type, uint8_t* data, size_t size) {
+        for (size_t i = 0; i < size; i++) {
+            data[i] = random() % 4 == 0 ? static_cast<uint8_t>(random()) : static_cast<uint8_t>(random() % 3);
+        }
+        for (size_t i = 0; i + type.size <= size; i += 1 + random() % (4 * type.size)) {
+            specialValue(type, data + i);
+        }
+    }
+    
+    // Operands are taken from the buffer half of the time, so they do occur in it
+    void operandValue(const KernelType& type, const uint8_t* data, size_t size, uint8_t* operand) {
+        if (random() % 2 == 0 && size >= type.size) {
+            memcpy(operand, data + random() % (size - type.size + 1), type.size);
+        } else {
+            specialValue(type, operand);
+        }
+    }
+    
+    void check(const KernelType& type, const KernelComparison& comparison, size_t alignment, size_t shift, size_t count) {
+        // Exactly the bytes a kernel may read, so an overread runs off the end
+        std::vector<uint8_t> buffer(shift + count + type.size - 1);
+        uint8_t* data = buffer.data() + shift;
+        fillBuffer(type, data, count + type.size - 1);
+        
+        std::vector<uint8_t> operand(comparisonTakesRange(comparison.comparison) ? 2 * type.size : type.size);
+        operandValue(type, data, count + type.size - 1, operand.data());
+        if (comparisonTakesRange(comparison.comparison)) {
+            operandValue(type, data, count + type.size - 1, operand.data() + type.size);
+        }
+        
+        ScanKernel scalar;
+        ScanKernel vector;
+        if (!makeScanKernel(type.type, comparison.comparison, operand, scalar, false, alignment) ||
+            !makeScanKernel(type.type, comparison.comparison, operand, vector, true, alignment)) {
+            report(type, comparison, alignment, shift, count, "no kernel");
+            return;
+        }
+        
+        std::vector<size_t> expected;
+        std::vector<size_t> found;
+        scalar.scan(scalar, data, count, expected);
+        vector.scan(vector, data, count, found);
+        checks++;
+        if (found != expected) {
+            std::ostringstream detail;
+            detail << found.size() << " offsets, expected " << expected.size();
+            for (size_t i = 0; i < std::min(found.size(), expected.size()); i++) {
+                if (found[i] != expected[i]) {
+                    detail << "; first difference at " << std::min(found[i], expected[i]);
+                    break;
+                }
+            }
+            report(type, comparison, alignment, shift, count, detail.str());
+        }
+    }
+    
+    void report(const KernelType& type, const KernelComparison& comparison, size_t alignment, size_t shift,
+                size_t count, const std::string& detail) {
+        failures++;
+        if (failures <= 20) {
+            std::cerr << "FAIL " << type.name << " " << comparison.name << " align " << alignment
+                      << " shift " << shift << " count " << count << ": " << detail << std::endl;
+        }
+    }
+
+public:
+    KernelTest() : random(0x6d61636d656d), checks(0), failures(0) {}
+    
+    bool run() {
+        for (const KernelType& type : kernelTypes) {
+            for (const KernelComparison& comparison : kernelComparisons) {
+                for (size_t alignment : kernelAlignments) {
+                    for (size_t shift = 0; shift < BASE_SHIFT_MAX; shift++) {
+                        for (size_t count = 1; count <= SHORT_COUNT_MAX; count++) {
+                            check(type, comparison, alignment, shift, count);
+                        }
+                        for (size_t round = 0; round < RANDOM_ROUNDS; round++) {
+                            check(type, comparison, alignment, shift, SHORT_COUNT_MAX + 1 + random() % LONG_COUNT_MAX);
+                        }
+                    }
+                }
+            }
+        }
+        
+        std::cout << simdLevelName(simdLevel()) << " kernels: " << checks << " checks, " << failures << " failures" << std::endl;
+        return failures == 0;
+    }
+};
+
+int main() {
+    KernelTest test;
+    return test.run() ? 0 : 1;
+}